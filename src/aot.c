@@ -0,0 +1,51 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * aot.c: Ahead-of-time translated executive.
+ *  - game.ls and main.ls are translated to C by "linguine --ansic" at
+ *    build time, and each function "f" becomes a cfunc "L_f".
+ *  - aot_table.h is generated by tools/aot_table.awk from the same
+ *    sources and lists the functions to register.
+ */
+
+#include "novelkit.h"
+
+#if defined(USE_AOT)
+
+/* Translated function. */
+struct aot_func {
+	const char *name;
+	int param_count;
+	const char **params;
+	bool (*func)(struct rt_env *);
+};
+
+/* The table of translated functions. */
+#include "aot_table.h"
+
+/*
+ * Register the translated functions of game.ls and main.ls.
+ */
+bool aot_install(struct rt_env *rt)
+{
+	int i;
+
+	/* The table ends with a NULL entry, so that it is never empty. */
+	for (i = 0; aot_funcs[i].name != NULL; i++) {
+		if (!rt_register_cfunc(rt,
+				       aot_funcs[i].name,
+				       aot_funcs[i].param_count,
+				       aot_funcs[i].params,
+				       aot_funcs[i].func))
+			return false;
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,26 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * aot.h: Ahead-of-time translated executive.
+ *  - Enabled by USE_AOT. (the "aot" target of the Makefile)
+ */
+
+#ifndef NOVELKIT_AOT_H
+#define NOVELKIT_AOT_H
+
+#include "compat.h"
+#include "linguine/linguine.h"
+
+#if defined(USE_AOT)
+
+/* Register the translated functions of game.ls and main.ls. */
+bool aot_install(struct rt_env *rt);
+
+#endif
+
+#endif
@@ -11,6 +11,13 @@
 
 #include "novelkit.h"
 
+/* Image cache operations. */
+enum image_op {
+	IMAGE_PIN,
+	IMAGE_UNPIN,
+	IMAGE_PRELOAD,
+};
+
 /* API error message. */
 static char api_error_message[4096];
 
@@ -19,6 +26,17 @@ static void copy_api_error(struct rt_env *rt);
 static bool get_int_param(struct rt_env *rt, const char *name, int *ret);
 static bool get_float_param(struct rt_env *rt, const char *name, float *ret);
 static bool get_string_param(struct rt_env *rt, const char *name, const char **ret);
+static bool get_resume_param(struct rt_env *rt, const char **ret);
+static bool set_return(struct rt_env *rt, struct rt_value *val);
+static bool set_var(struct rt_env *rt, int space, bool add);
+static bool get_var(struct rt_env *rt, int space);
+static bool make_stats_dict(struct rt_env *rt, struct rt_value *dict, const struct mem_stats *stats);
+static bool make_frame_dict(struct rt_env *rt, struct rt_value *dict);
+static bool make_image_dict(struct rt_env *rt, struct rt_value *dict);
+static bool make_gc_dict(struct rt_env *rt, struct rt_value *dict);
+static bool make_dispatch_dict(struct rt_env *rt, struct rt_value *dict);
+static bool image_cache_op(struct rt_env *rt, int op);
+static int clamp_int(uint64_t v);
 
 /*
  * NovelKit.moveToScenario()
@@ -38,8 +56,728 @@ bool NovelKit_moveToScenario(struct rt_env *rt)
 	return true;
 }
 
+/*
+ * NovelKit.overrideTag()
+ *  - param.tag ... native tag to run by the function of the same name.
+ */
+bool NovelKit_overrideTag(struct rt_env *rt)
+{
+	const char *tag;
+
+	if (!get_string_param(rt, "tag", &tag))
+		return false;
+
+	if (!tag_override(tag)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * NovelKit.setLanguage()
+ *  - param.lang ... language name of "lang/<lang>.nkl", or "" for the
+ *                   strings written in scenario files.
+ *  - Loaded scenarios are not reloaded. Tags look up the new table.
+ */
+bool NovelKit_setLanguage(struct rt_env *rt)
+{
+	const char *lang;
+
+	if (!get_string_param(rt, "lang", &lang))
+		return false;
+
+	if (!strtab_set_language(lang)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * NovelKit.waitClick()
+ *  - param.resume ... (optional) function to call when the wait ends.
+ */
+bool NovelKit_waitClick(struct rt_env *rt)
+{
+	const char *resume;
+
+	if (!get_resume_param(rt, &resume))
+		return false;
+
+	if (!wait_click(resume)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * NovelKit.waitTime()
+ *  - param.seconds ... duration.
+ *  - param.resume  ... (optional) function to call when the wait ends.
+ */
+bool NovelKit_waitTime(struct rt_env *rt)
+{
+	const char *resume;
+	float seconds;
+
+	if (!get_float_param(rt, "seconds", &seconds))
+		return false;
+	if (!get_resume_param(rt, &resume))
+		return false;
+
+	if (!wait_time(seconds, resume)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * NovelKit.waitSound()
+ *  - param.track  ... sound track.
+ *  - param.resume ... (optional) function to call when the wait ends.
+ */
+bool NovelKit_waitSound(struct rt_env *rt)
+{
+	const char *resume;
+	int track;
+
+	if (!get_int_param(rt, "track", &track))
+		return false;
+	if (!get_resume_param(rt, &resume))
+		return false;
+
+	if (!wait_sound(track, resume)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * NovelKit.waitMovie()
+ *  - param.resume ... (optional) function to call when the wait ends.
+ */
+bool NovelKit_waitMovie(struct rt_env *rt)
+{
+	const char *resume;
+
+	if (!get_resume_param(rt, &resume))
+		return false;
+
+	if (!wait_movie(resume)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * NovelKit.setIdleFps()
+ *  - param.fps ... frame rate while waiting, or 0 for the full rate.
+ */
+bool NovelKit_setIdleFps(struct rt_env *rt)
+{
+	int fps;
+
+	if (!get_int_param(rt, "fps", &fps))
+		return false;
+
+	idle_set_fps(fps);
+
+	return true;
+}
+
+/*
+ * NovelKit.keepActive()
+ *  - param.seconds ... duration to keep the full frame rate.
+ */
+bool NovelKit_keepActive(struct rt_env *rt)
+{
+	float seconds;
+
+	if (!get_float_param(rt, "seconds", &seconds))
+		return false;
+
+	idle_keep_active(seconds);
+
+	return true;
+}
+
+/*
+ * NovelKit.pinImage()
+ *  - param.file ... image file to keep loaded until unpinned.
+ *  - Pins are counted.
+ */
+bool NovelKit_pinImage(struct rt_env *rt)
+{
+	return image_cache_op(rt, IMAGE_PIN);
+}
+
+/*
+ * NovelKit.unpinImage()
+ */
+bool NovelKit_unpinImage(struct rt_env *rt)
+{
+	return image_cache_op(rt, IMAGE_UNPIN);
+}
+
+/*
+ * NovelKit.preloadImage()
+ *  - Loads an image without pinning, so that it may be evicted.
+ */
+bool NovelKit_preloadImage(struct rt_env *rt)
+{
+	return image_cache_op(rt, IMAGE_PRELOAD);
+}
+
+/*
+ * NovelKit.setImageCacheBudget()
+ *  - param.mbytes ... budget in megabytes.
+ */
+bool NovelKit_setImageCacheBudget(struct rt_env *rt)
+{
+	int mbytes;
+
+	if (!get_int_param(rt, "mbytes", &mbytes))
+		return false;
+	if (mbytes < 0) {
+		rt_error(rt, "Negative budget.");
+		return false;
+	}
+
+	imgcache_set_budget((size_t)mbytes * 1024 * 1024);
+
+	return true;
+}
+
+/* Do an image cache operation for param.file. */
+static bool image_cache_op(struct rt_env *rt, int op)
+{
+	struct image *img;
+	const char *file;
+	bool ret;
+
+#if defined(USE_LOGIC_THREAD)
+	/* Images are HAL objects owned by the main thread. */
+	UNUSED_PARAMETER(op);
+	UNUSED_PARAMETER(img);
+	UNUSED_PARAMETER(ret);
+	if (!get_string_param(rt, "file", &file))
+		return false;
+	rt_error(rt, "The image cache is not available on the logic thread.");
+	return false;
+#else
+	if (!get_string_param(rt, "file", &file))
+		return false;
+
+	switch (op) {
+	case IMAGE_PIN:
+		ret = imgcache_acquire(file, &img);
+		break;
+	case IMAGE_UNPIN:
+		ret = imgcache_release(file);
+		break;
+	case IMAGE_PRELOAD:
+		ret = imgcache_preload(file);
+		break;
+	default:
+		assert(0);
+		ret = false;
+		break;
+	}
+	if (!ret) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+/*
+ * NovelKit.rewind()
+ *  - param.count ... number of tags to rewind, including the running tag.
+ */
+bool NovelKit_rewind(struct rt_env *rt)
+{
+	int count;
+
+	if (!get_int_param(rt, "count", &count))
+		return false;
+
+	if (!scenario_rewind(rt, count)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * NovelKit.getRewindCount()
+ */
+bool NovelKit_getRewindCount(struct rt_env *rt)
+{
+	struct rt_value ret;
+
+	ret.type = RT_VALUE_INT;
+	ret.val.i = rollback_get_count();
+
+	return set_return(rt, &ret);
+}
+
+/*
+ * NovelKit.addFlag()
+ */
+bool NovelKit_addFlag(struct rt_env *rt)
+{
+	const char *name, *value;
+
+	if (!get_string_param(rt, "name", &name))
+		return false;
+	if (!get_string_param(rt, "value", &value))
+		return false;
+
+	if (!var_add(VAR_FLAG, name, value)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * NovelKit.setFlag()
+ */
+bool NovelKit_setFlag(struct rt_env *rt)
+{
+	return set_var(rt, VAR_FLAG, false);
+}
+
+/*
+ * NovelKit.getFlag()
+ */
+bool NovelKit_getFlag(struct rt_env *rt)
+{
+	return get_var(rt, VAR_FLAG);
+}
+
+/*
+ * NovelKit.saveFlagFile()
+ *  - param.file ... file name in the save directory.
+ *  - Returns before the file is written. See getSaveStatus().
+ */
+bool NovelKit_saveFlagFile(struct rt_env *rt)
+{
+	const char *file;
+
+	if (!get_string_param(rt, "file", &file))
+		return false;
+
+	if (!savefile_save_vars(VAR_FLAG, file)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * NovelKit.loadFlagFile()
+ *  - param.file ... file name in the save directory.
+ *  - Returns 1 if loaded, or 0 if the file doesn't exist.
+ */
+bool NovelKit_loadFlagFile(struct rt_env *rt)
+{
+	struct rt_value ret;
+	const char *file;
+	bool loaded;
+
+	if (!get_string_param(rt, "file", &file))
+		return false;
+
+	if (!savefile_load_vars(VAR_FLAG, file, &loaded)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	ret.type = RT_VALUE_INT;
+	ret.val.i = loaded ? 1 : 0;
+
+	return set_return(rt, &ret);
+}
+
+/*
+ * NovelKit.getSaveStatus()
+ *  - Returns {pending, written, coalesced, failed}.
+ */
+bool NovelKit_getSaveStatus(struct rt_env *rt)
+{
+	struct savefile_status status;
+	struct rt_value ret, val;
+
+	savefile_get_status(&status);
+
+	if (!rt_make_empty_dict(rt, &ret))
+		return false;
+
+	val.type = RT_VALUE_INT;
+	val.val.i = status.pending;
+	if (!rt_set_dict_elem(rt, &ret, "pending", &val))
+		return false;
+
+	val.val.i = clamp_int(status.written);
+	if (!rt_set_dict_elem(rt, &ret, "written", &val))
+		return false;
+
+	val.val.i = clamp_int(status.coalesced);
+	if (!rt_set_dict_elem(rt, &ret, "coalesced", &val))
+		return false;
+
+	val.val.i = clamp_int(status.failed);
+	if (!rt_set_dict_elem(rt, &ret, "failed", &val))
+		return false;
+
+	return set_return(rt, &ret);
+}
+
+/*
+ * NovelKit.setStage()
+ *  - Stage variables are added when they are set first.
+ */
+bool NovelKit_setStage(struct rt_env *rt)
+{
+	return set_var(rt, VAR_STAGE, true);
+}
+
+/*
+ * NovelKit.getStage()
+ *  - Returns "" for a stage variable that is not set yet.
+ */
+bool NovelKit_getStage(struct rt_env *rt)
+{
+	return get_var(rt, VAR_STAGE);
+}
+
+/* Set a variable from param.name and param.value. */
+static bool set_var(struct rt_env *rt, int space, bool add)
+{
+	const char *name, *value;
+	int index;
+
+	if (!get_string_param(rt, "name", &name))
+		return false;
+	if (!get_string_param(rt, "value", &value))
+		return false;
+
+	index = var_find(space, name);
+	if (index < 0) {
+		if (!add) {
+			rt_error(rt, "Variable %s is not defined.", name);
+			return false;
+		}
+		if (!var_add(space, name, "")) {
+			copy_api_error(rt);
+			return false;
+		}
+		index = var_find(space, name);
+	}
+
+	if (!var_set(space, index, value)) {
+		copy_api_error(rt);
+		return false;
+	}
+
+	/* A stage change may change the screen. */
+	if (space == VAR_STAGE)
+		idle_notify_activity();
+
+	return true;
+}
+
+/* Return a variable value for param.name. */
+static bool get_var(struct rt_env *rt, int space)
+{
+	struct rt_value ret;
+	const char *name;
+	int index;
+
+	if (!get_string_param(rt, "name", &name))
+		return false;
+
+	index = var_find(space, name);
+	if (index < 0 && space != VAR_STAGE) {
+		rt_error(rt, "Variable %s is not defined.", name);
+		return false;
+	}
+
+	if (!rt_make_string(rt, &ret, index >= 0 ? var_get_value(space, index) : ""))
+		return false;
+
+	return set_return(rt, &ret);
+}
+
+/*
+ * NovelKit.getStats()
+ *  - Returns {subsystem: {current, peak, count}, ...} in bytes.
+ */
+bool NovelKit_getStats(struct rt_env *rt)
+{
+	struct rt_value ret, sub;
+	struct mem_stats stats;
+	int i;
+
+	if (!rt_make_empty_dict(rt, &ret))
+		return false;
+
+	for (i = 0; i < MEM_KIND_COUNT; i++) {
+		mem_get_stats(i, &stats);
+		if (!make_stats_dict(rt, &sub, &stats))
+			return false;
+		if (!rt_set_dict_elem(rt, &ret, mem_get_kind_name(i), &sub))
+			return false;
+	}
+
+	mem_get_other_heap_stats(&stats);
+	if (!make_stats_dict(rt, &sub, &stats))
+		return false;
+	if (!rt_set_dict_elem(rt, &ret, "otherHeap", &sub))
+		return false;
+
+	if (!make_frame_dict(rt, &sub))
+		return false;
+	if (!rt_set_dict_elem(rt, &ret, "frame", &sub))
+		return false;
+
+	if (!make_image_dict(rt, &sub))
+		return false;
+	if (!rt_set_dict_elem(rt, &ret, "image", &sub))
+		return false;
+
+	if (!make_gc_dict(rt, &sub))
+		return false;
+	if (!rt_set_dict_elem(rt, &ret, "gc", &sub))
+		return false;
+
+	if (!make_dispatch_dict(rt, &sub))
+		return false;
+	if (!rt_set_dict_elem(rt, &ret, "dispatch", &sub))
+		return false;
+
+	return set_return(rt, &ret);
+}
+
+/* Make a {current, peak, count} dictionary. */
+static bool make_stats_dict(struct rt_env *rt, struct rt_value *dict, const struct mem_stats *stats)
+{
+	struct rt_value val;
+
+	if (!rt_make_empty_dict(rt, dict))
+		return false;
+
+	val.type = RT_VALUE_INT;
+	val.val.i = clamp_int(stats->current);
+	if (!rt_set_dict_elem(rt, dict, "current", &val))
+		return false;
+
+	val.val.i = clamp_int(stats->peak);
+	if (!rt_set_dict_elem(rt, dict, "peak", &val))
+		return false;
+
+	val.val.i = clamp_int(stats->count);
+	if (!rt_set_dict_elem(rt, dict, "count", &val))
+		return false;
+
+	return true;
+}
+
+/* Make a {frames, idleFrames, sleepMsec, cpuMsec} dictionary. */
+static bool make_frame_dict(struct rt_env *rt, struct rt_value *dict)
+{
+	struct idle_stats stats;
+	struct rt_value val;
+
+	idle_get_stats(&stats);
+
+	if (!rt_make_empty_dict(rt, dict))
+		return false;
+
+	val.type = RT_VALUE_INT;
+	val.val.i = clamp_int(stats.frames);
+	if (!rt_set_dict_elem(rt, dict, "frames", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.idle_frames);
+	if (!rt_set_dict_elem(rt, dict, "idleFrames", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.sleep_usec / 1000);
+	if (!rt_set_dict_elem(rt, dict, "sleepMsec", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.cpu_usec / 1000);
+	if (!rt_set_dict_elem(rt, dict, "cpuMsec", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.idle_usec / 1000);
+	if (!rt_set_dict_elem(rt, dict, "idleMsec", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.idle_cpu_per_minute_usec / 1000);
+	if (!rt_set_dict_elem(rt, dict, "idleCpuMsecPerMin", &val))
+		return false;
+
+	return true;
+}
+
+/* Make a dictionary of the image cache statistics. */
+static bool make_image_dict(struct rt_env *rt, struct rt_value *dict)
+{
+	struct imgcache_stats stats;
+	struct rt_value val;
+
+	imgcache_get_stats(&stats);
+
+	if (!rt_make_empty_dict(rt, dict))
+		return false;
+
+	val.type = RT_VALUE_INT;
+	val.val.i = clamp_int(stats.hits);
+	if (!rt_set_dict_elem(rt, dict, "hits", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.misses);
+	if (!rt_set_dict_elem(rt, dict, "misses", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.evictions);
+	if (!rt_set_dict_elem(rt, dict, "evictions", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.load_usec / 1000);
+	if (!rt_set_dict_elem(rt, dict, "loadMsec", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.bytes);
+	if (!rt_set_dict_elem(rt, dict, "bytes", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.peak_bytes);
+	if (!rt_set_dict_elem(rt, dict, "peak", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.budget);
+	if (!rt_set_dict_elem(rt, dict, "budget", &val))
+		return false;
+
+	return true;
+}
+
+/* Make a dictionary of the collection statistics. */
+static bool make_gc_dict(struct rt_env *rt, struct rt_value *dict)
+{
+	struct gc_stats stats;
+	struct rt_value val;
+
+	gc_get_stats(&stats);
+
+	if (!rt_make_empty_dict(rt, dict))
+		return false;
+
+	val.type = RT_VALUE_INT;
+	val.val.i = clamp_int(stats.shallow_count);
+	if (!rt_set_dict_elem(rt, dict, "shallow", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.deep_count);
+	if (!rt_set_dict_elem(rt, dict, "deep", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.forced_count);
+	if (!rt_set_dict_elem(rt, dict, "forced", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.deferred_count);
+	if (!rt_set_dict_elem(rt, dict, "deferred", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.pause_usec / 1000);
+	if (!rt_set_dict_elem(rt, dict, "pauseMsec", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.max_pause_usec);
+	if (!rt_set_dict_elem(rt, dict, "maxPauseUsec", &val))
+		return false;
+
+	return true;
+}
+
+/* Make a {native, script} dictionary of the tag dispatch counts. */
+static bool make_dispatch_dict(struct rt_env *rt, struct rt_value *dict)
+{
+	struct scenario_stats stats;
+	struct rt_value val;
+
+	scenario_get_stats(&stats);
+
+	if (!rt_make_empty_dict(rt, dict))
+		return false;
+
+	val.type = RT_VALUE_INT;
+	val.val.i = clamp_int(stats.native_count);
+	if (!rt_set_dict_elem(rt, dict, "native", &val))
+		return false;
+
+	val.val.i = clamp_int(stats.script_count);
+	if (!rt_set_dict_elem(rt, dict, "script", &val))
+		return false;
+
+	return true;
+}
+
+/*
+ * NovelKit.setGcLimit()
+ *  - param.mbytes ... size of the other heap that forces a collection in a
+ *                     busy frame, or 0 to disable.
+ */
+bool NovelKit_setGcLimit(struct rt_env *rt)
+{
+	int mbytes;
+
+	if (!get_int_param(rt, "mbytes", &mbytes))
+		return false;
+	if (mbytes < 0) {
+		rt_error(rt, "Negative limit.");
+		return false;
+	}
+
+	gc_set_limit((size_t)mbytes * 1024 * 1024);
+
+	return true;
+}
+
+/* Clamp a counter to the script integer range. */
+static int clamp_int(uint64_t v)
+{
+	return v > INT32_MAX ? INT32_MAX : (int)v;
+}
+
+/* Set a return value. */
+static bool set_return(struct rt_env *rt, struct rt_value *val)
+{
+	return rt_set_local(rt, "$return", val);
+}
+
 /* Get an integer parameter. */
-__attribute__((unused))
 static bool get_int_param(struct rt_env *rt, const char *name, int *ret)
 {
 	struct rt_value param, elem;
@@ -69,7 +807,6 @@ static bool get_int_param(struct rt_env *rt, const char *name, int *ret)
 }
 
 /* Get a float parameter. */
-__attribute__((unused))
 static bool get_float_param(struct rt_env *rt, const char *name, float *ret)
 {
 	struct rt_value param, elem;
@@ -130,6 +867,27 @@ static bool get_string_param(struct rt_env *rt, const char *name, const char **r
 	return true;
 }
 
+/* Get the optional resume function name. (NULL if not given) */
+static bool get_resume_param(struct rt_env *rt, const char **ret)
+{
+	struct rt_value param, elem;
+
+	*ret = NULL;
+
+	if (!rt_get_local(rt, "param", &param))
+		return true;
+	if (!rt_get_dict_elem(rt, &param, "resume", &elem))
+		return true;
+	if (elem.type != RT_VALUE_STRING) {
+		rt_error(rt, "Unexpected parameter value for resume.");
+		return false;
+	}
+
+	*ret = elem.val.str->s;
+
+	return true;
+}
+
 /*
  * Install API functions to a runtime.
  */
@@ -142,6 +900,30 @@ bool install_api(struct rt_env *rt)
 		bool (*func)(struct rt_env *);
 	} funcs[] = {
 		{"NovelKit_moveToScenario", "moveToScenario", NovelKit_moveToScenario},
+		{"NovelKit_overrideTag", "overrideTag", NovelKit_overrideTag},
+		{"NovelKit_setLanguage", "setLanguage", NovelKit_setLanguage},
+		{"NovelKit_waitClick", "waitClick", NovelKit_waitClick},
+		{"NovelKit_waitTime", "waitTime", NovelKit_waitTime},
+		{"NovelKit_waitSound", "waitSound", NovelKit_waitSound},
+		{"NovelKit_waitMovie", "waitMovie", NovelKit_waitMovie},
+		{"NovelKit_setIdleFps", "setIdleFps", NovelKit_setIdleFps},
+		{"NovelKit_keepActive", "keepActive", NovelKit_keepActive},
+		{"NovelKit_pinImage", "pinImage", NovelKit_pinImage},
+		{"NovelKit_unpinImage", "unpinImage", NovelKit_unpinImage},
+		{"NovelKit_preloadImage", "preloadImage", NovelKit_preloadImage},
+		{"NovelKit_setImageCacheBudget", "setImageCacheBudget", NovelKit_setImageCacheBudget},
+		{"NovelKit_rewind", "rewind", NovelKit_rewind},
+		{"NovelKit_getRewindCount", "getRewindCount", NovelKit_getRewindCount},
+		{"NovelKit_addFlag", "addFlag", NovelKit_addFlag},
+		{"NovelKit_setFlag", "setFlag", NovelKit_setFlag},
+		{"NovelKit_getFlag", "getFlag", NovelKit_getFlag},
+		{"NovelKit_saveFlagFile", "saveFlagFile", NovelKit_saveFlagFile},
+		{"NovelKit_loadFlagFile", "loadFlagFile", NovelKit_loadFlagFile},
+		{"NovelKit_getSaveStatus", "getSaveStatus", NovelKit_getSaveStatus},
+		{"NovelKit_setStage", "setStage", NovelKit_setStage},
+		{"NovelKit_getStage", "getStage", NovelKit_getStage},
+		{"NovelKit_getStats", "getStats", NovelKit_getStats},
+		{"NovelKit_setGcLimit", "setGcLimit", NovelKit_setGcLimit},
 	};
 	const int tbl_size = sizeof(funcs) / sizeof(struct func);
 	struct rt_value dict;
@@ -185,6 +967,14 @@ void api_error(const char *format, ...)
 	va_end(ap);
 }
 
+/*
+ * Get the last API error message.
+ */
+const char *api_get_error_message(void)
+{
+	return api_error_message;
+}
+
 /* Put an out-of-memory log. (called from API implementation) */
 void api_out_of_memory(void)
 {
@@ -24,7 +24,46 @@ void api_error(const char *format, ...);
 /* Put an out-of-memory log. (called from API implementation) */
 void api_out_of_memory(void);
 
+/* Get the last API error message. */
+const char *api_get_error_message(void);
+
+/* Save Data Management API */
+bool NovelKit_addFlag(struct rt_env *rt);
+bool NovelKit_setFlag(struct rt_env *rt);
+bool NovelKit_getFlag(struct rt_env *rt);
+bool NovelKit_saveFlagFile(struct rt_env *rt);
+bool NovelKit_loadFlagFile(struct rt_env *rt);
+bool NovelKit_getSaveStatus(struct rt_env *rt);
+
 /* Scenario API */
 bool NovelKit_moveToScenarioFile(struct rt_env *rt);
+bool NovelKit_overrideTag(struct rt_env *rt);
+
+/* Wait API */
+bool NovelKit_waitClick(struct rt_env *rt);
+bool NovelKit_waitTime(struct rt_env *rt);
+bool NovelKit_waitSound(struct rt_env *rt);
+bool NovelKit_waitMovie(struct rt_env *rt);
+bool NovelKit_setIdleFps(struct rt_env *rt);
+bool NovelKit_keepActive(struct rt_env *rt);
+
+/* Image Cache API */
+bool NovelKit_pinImage(struct rt_env *rt);
+bool NovelKit_unpinImage(struct rt_env *rt);
+bool NovelKit_preloadImage(struct rt_env *rt);
+bool NovelKit_setImageCacheBudget(struct rt_env *rt);
+
+/* Localization API */
+bool NovelKit_setLanguage(struct rt_env *rt);
+
+/* Rewind API */
+bool NovelKit_setStage(struct rt_env *rt);
+bool NovelKit_getStage(struct rt_env *rt);
+bool NovelKit_rewind(struct rt_env *rt);
+bool NovelKit_getRewindCount(struct rt_env *rt);
+
+/* Debug API */
+bool NovelKit_getStats(struct rt_env *rt);
+bool NovelKit_setGcLimit(struct rt_env *rt);
 
 #endif
@@ -11,33 +11,172 @@
 
 #include "novelkit.h"
 
+#if defined(TARGET_WINDOWS)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* Forward declaration. */
+static bool load_loose_file(const char *file, char **buf, size_t *size);
+
+/*
+ * Load a file content into a NUL-terminated heap buffer.
+ *  - The buffer must be freed by mem_free().
+ */
 bool common_load_file_content(const char *file, char **buf)
 {
-	struct file *f;
-	size_t file_size, read_size;
+	const struct package_entry *e;
+	size_t size;
 
 	assert(buf != NULL);
 
-	if (!file_open(file, &f)) {
-		return false;
+	/* Search the package first. */
+	e = package_find(file);
+	if (e != NULL)
+		return package_extract(e, buf);
+
+	return load_loose_file(file, buf, &size);
+}
+
+/*
+ * Open a read-only view of a file content.
+ */
+bool common_open_file_view(const char *file, struct file_view *view)
+{
+	const struct package_entry *e;
+
+	assert(view != NULL);
+
+	view->data = NULL;
+	view->size = 0;
+	view->owned = NULL;
+
+	/* Use the mapped bytes if the entry is stored uncompressed. */
+	e = package_find(file);
+	if (e != NULL && !(LETOHOST32(e->flags) & PACKAGE_FLAG_LZ)) {
+		view->data = package_get_data(e);
+		view->size = (size_t)LETOHOST64(e->size);
+		return true;
+	}
+
+	/* Otherwise, make a heap copy. */
+	if (e != NULL) {
+		if (!package_extract(e, &view->owned))
+			return false;
+		view->size = (size_t)LETOHOST64(e->size);
+	} else {
+		if (!load_loose_file(file, &view->owned, &view->size))
+			return false;
 	}
+	view->data = view->owned;
+
+	return true;
+}
+
+/*
+ * Close a file view.
+ */
+void common_close_file_view(struct file_view *view)
+{
+	assert(view != NULL);
+
+	if (view->owned != NULL)
+		mem_free(view->owned);
+
+	view->data = NULL;
+	view->size = 0;
+	view->owned = NULL;
+}
 
-	if (!file_get_size(f, &file_size))
+/*
+ * Hash bytes. (64-bit FNV-1a)
+ */
+uint64_t common_hash64(const void *data, size_t size)
+{
+	const uint8_t *p;
+	uint64_t h;
+	size_t i;
+
+	p = data;
+	h = 14695981039346656037ULL;
+	for (i = 0; i < size; i++)
+		h = (h ^ p[i]) * 1099511628211ULL;
+
+	return h;
+}
+
+/*
+ * Get a monotonic time in microseconds.
+ */
+uint64_t common_get_usec(void)
+{
+#if defined(TARGET_WINDOWS)
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000 +
+	       (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000 / (uint64_t)freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#endif
+}
+
+/* Load a loose file. */
+static bool load_loose_file(const char *file, char **buf, size_t *size)
+{
+	struct file *f;
+	size_t file_size, read_size;
+
+	if (!file_open(file, &f))
 		return false;
 
-	*buf = malloc(file_size);
+	if (!file_get_size(f, &file_size)) {
+		file_close(f);
+		return false;
+	}
+
+	*buf = mem_alloc(MEM_FILE, file_size + 1);
 	if (*buf == NULL) {
 		sys_out_of_memory();
+		file_close(f);
 		return false;
 	}
 
 	if (!file_read(f, *buf, file_size, &read_size)) {
 		sys_error("Could not read file \"%s\".", file);
-		free(buf);
+		mem_free(*buf);
+		*buf = NULL;
+		file_close(f);
 		return false;
 	}
+	(*buf)[read_size] = '\0';
+	*size = read_size;
 
 	file_close(f);
 
 	return true;
 }
+
+/*
+ * Sleep for microseconds.
+ *  - Does nothing on Wasm, where the browser schedules frames.
+ */
+void common_sleep_usec(uint64_t usec)
+{
+#if defined(TARGET_WINDOWS)
+	Sleep((DWORD)(usec / 1000));
+#elif defined(TARGET_WASM)
+	UNUSED_PARAMETER(usec);
+#else
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)(usec / 1000000);
+	ts.tv_nsec = (long)(usec % 1000000) * 1000;
+	nanosleep(&ts, NULL);
+#endif
+}
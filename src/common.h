@@ -14,6 +14,70 @@
 
 #include "compat.h"
 
+/* Read-only view of a file content. */
+struct file_view {
+	/* NUL-terminated content. */
+	const char *data;
+
+	/* Size without the NUL. */
+	size_t size;
+
+	/* Heap copy owned by the view, or NULL for a zero-copy view. */
+	char *owned;
+};
+
+/*
+ * Load a file content into a NUL-terminated heap buffer.
+ *  - The packed archive is searched first, then loose files.
+ *  - The buffer must be freed by mem_free().
+ */
 bool common_load_file_content(const char *file, char **buf);
 
+/*
+ * Open a read-only view of a file content.
+ *  - Uncompressed packed entries are not copied.
+ */
+bool common_open_file_view(const char *file, struct file_view *view);
+
+/* Close a file view. */
+void common_close_file_view(struct file_view *view);
+
+/* Hash bytes. (64-bit FNV-1a) */
+uint64_t common_hash64(const void *data, size_t size);
+
+/* Get a monotonic time in microseconds. */
+uint64_t common_get_usec(void);
+
+/* Sleep for microseconds. */
+void common_sleep_usec(uint64_t usec);
+
+/*
+ * Relaxed atomics for counters that another thread reads.
+ *  - ATOMIC_ADD() and ATOMIC_SUB() return the new value.
+ *  - ATOMIC_MAX() raises a value to v by a compare-exchange loop.
+ */
+#if defined(__GNUC__) || defined(__llvm__)
+#define ATOMIC_ADD(p, v)	__atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#define ATOMIC_SUB(p, v)	__atomic_sub_fetch((p), (v), __ATOMIC_RELAXED)
+#define ATOMIC_LOAD(p)		__atomic_load_n((p), __ATOMIC_RELAXED)
+#define ATOMIC_STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define ATOMIC_MAX(p, v)						\
+	do {								\
+		__typeof__(*(p)) atomic_new_ = (v);			\
+		__typeof__(*(p)) atomic_old_ = ATOMIC_LOAD(p);		\
+		while (atomic_new_ > atomic_old_ &&			\
+		       !__atomic_compare_exchange_n((p), &atomic_old_,	\
+						    atomic_new_, true,	\
+						    __ATOMIC_RELAXED,	\
+						    __ATOMIC_RELAXED))	\
+			;						\
+	} while (0)
+#else
+#define ATOMIC_ADD(p, v)	(*(p) += (v))
+#define ATOMIC_SUB(p, v)	(*(p) -= (v))
+#define ATOMIC_LOAD(p)		(*(p))
+#define ATOMIC_STORE(p, v)	(*(p) = (v))
+#define ATOMIC_MAX(p, v)	do { if ((v) > *(p)) *(p) = (v); } while (0)
+#endif
+
 #endif
@@ -0,0 +1,545 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * compose.c: Software compositor for stage layers.
+ *  - Each path has two kernels: "blend" draws a premultiplied source
+ *    with an opacity, and "mix" interpolates two rows with a weight per
+ *    pixel. A fade is a mix with a constant weight, and a wipe is a mix
+ *    with weights looked up from the rule image.
+ *  - Every kernel uses the same 16-bit integer math and the exact
+ *    rounding division by 255, so that all paths are pixel-exact.
+ *  - SSE2 and NEON are selected at compile time. AVX2 is compiled with
+ *    a target attribute and selected when the CPU has it.
+ */
+
+#include "compose.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(ARCH_X86_64) || (defined(ARCH_X86) && defined(__SSE2__))
+#define USE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define USE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if (defined(ARCH_ARM64) || (defined(ARCH_ARM32) && defined(__ARM_NEON))) && defined(ARCH_LE)
+#define USE_NEON
+#include <arm_neon.h>
+#endif
+
+/* Pixels of a weight row buffer. */
+#define ROW_CHUNK	256
+
+/* Kernels. */
+typedef void (*blend_fn)(uint32_t *RESTRICT dst, const uint32_t *RESTRICT src, int n, uint32_t opacity);
+typedef void (*mix_fn)(uint32_t *dst, const uint32_t *a, const uint32_t *b, const uint8_t *t, int n);
+
+/* Path names. */
+static const char *path_name[COMPOSE_PATH_COUNT] = {
+	"auto",
+	"scalar",
+	"sse2",
+	"avx2",
+	"neon",
+};
+
+/* Selected kernels. */
+static blend_fn blend_kernel;
+static mix_fn mix_kernel;
+static int cur_path;
+
+/* Forward declarations. */
+static INLINE uint32_t div255(uint32_t x);
+static void blend_scalar(uint32_t *RESTRICT dst, const uint32_t *RESTRICT src, int n, uint32_t opacity);
+static void mix_scalar(uint32_t *dst, const uint32_t *a, const uint32_t *b, const uint8_t *t, int n);
+#if defined(USE_SSE2)
+static void blend_sse2(uint32_t *RESTRICT dst, const uint32_t *RESTRICT src, int n, uint32_t opacity);
+static void mix_sse2(uint32_t *dst, const uint32_t *a, const uint32_t *b, const uint8_t *t, int n);
+#endif
+#if defined(USE_AVX2)
+static void blend_avx2(uint32_t *RESTRICT dst, const uint32_t *RESTRICT src, int n, uint32_t opacity);
+static void mix_avx2(uint32_t *dst, const uint32_t *a, const uint32_t *b, const uint8_t *t, int n);
+#endif
+#if defined(USE_NEON)
+static void blend_neon(uint32_t *RESTRICT dst, const uint32_t *RESTRICT src, int n, uint32_t opacity);
+static void mix_neon(uint32_t *dst, const uint32_t *a, const uint32_t *b, const uint8_t *t, int n);
+#endif
+static void make_wipe_table(uint8_t *table, int progress, int vague);
+
+/*
+ * Select the kernels of a path.
+ */
+bool compose_select(int path)
+{
+	assert(path >= 0 && path < COMPOSE_PATH_COUNT);
+
+	/* Try the fastest first. */
+	if (path == COMPOSE_AUTO) {
+		if (compose_select(COMPOSE_AVX2) ||
+		    compose_select(COMPOSE_SSE2) ||
+		    compose_select(COMPOSE_NEON))
+			return true;
+		return compose_select(COMPOSE_SCALAR);
+	}
+
+	switch (path) {
+	case COMPOSE_SCALAR:
+		blend_kernel = blend_scalar;
+		mix_kernel = mix_scalar;
+		break;
+#if defined(USE_SSE2)
+	case COMPOSE_SSE2:
+		blend_kernel = blend_sse2;
+		mix_kernel = mix_sse2;
+		break;
+#endif
+#if defined(USE_AVX2)
+	case COMPOSE_AVX2:
+		if (!__builtin_cpu_supports("avx2"))
+			return false;
+		blend_kernel = blend_avx2;
+		mix_kernel = mix_avx2;
+		break;
+#endif
+#if defined(USE_NEON)
+	case COMPOSE_NEON:
+		blend_kernel = blend_neon;
+		mix_kernel = mix_neon;
+		break;
+#endif
+	default:
+		return false;
+	}
+	cur_path = path;
+
+	return true;
+}
+
+/*
+ * Get the selected path.
+ */
+int compose_get_path(void)
+{
+	if (blend_kernel == NULL)
+		compose_select(COMPOSE_AUTO);
+
+	return cur_path;
+}
+
+/*
+ * Get the name of a path.
+ */
+const char *compose_get_path_name(int path)
+{
+	assert(path >= 0 && path < COMPOSE_PATH_COUNT);
+
+	return path_name[path];
+}
+
+/*
+ * Draw src over dst.
+ */
+void compose_blend(struct compose_image *dst, const struct compose_image *src, int x, int y, int opacity)
+{
+	int sx, sy, w, h, i;
+
+	assert(opacity >= 0 && opacity <= 255);
+
+	if (blend_kernel == NULL)
+		compose_select(COMPOSE_AUTO);
+
+	if (opacity == 0)
+		return;
+
+	/* Clip. */
+	sx = x < 0 ? -x : 0;
+	sy = y < 0 ? -y : 0;
+	w = src->width - sx;
+	h = src->height - sy;
+	if (x + sx + w > dst->width)
+		w = dst->width - (x + sx);
+	if (y + sy + h > dst->height)
+		h = dst->height - (y + sy);
+	if (w <= 0 || h <= 0)
+		return;
+
+	for (i = 0; i < h; i++) {
+		blend_kernel(dst->pixels + (size_t)(y + sy + i) * (size_t)dst->pitch + x + sx,
+			     src->pixels + (size_t)(sy + i) * (size_t)src->pitch + sx,
+			     w,
+			     (uint32_t)opacity);
+	}
+}
+
+/*
+ * Crossfade from a to b.
+ */
+void compose_fade(struct compose_image *dst, const struct compose_image *a, const struct compose_image *b, int t)
+{
+	uint8_t weight[ROW_CHUNK];
+	size_t dofs, aofs, bofs;
+	int x, y, n;
+
+	assert(t >= 0 && t <= 255);
+	assert(a->width == dst->width && a->height == dst->height);
+	assert(b->width == dst->width && b->height == dst->height);
+
+	if (mix_kernel == NULL)
+		compose_select(COMPOSE_AUTO);
+
+	memset(weight, t, sizeof(weight));
+
+	for (y = 0; y < dst->height; y++) {
+		dofs = (size_t)y * (size_t)dst->pitch;
+		aofs = (size_t)y * (size_t)a->pitch;
+		bofs = (size_t)y * (size_t)b->pitch;
+		for (x = 0; x < dst->width; x += n) {
+			n = dst->width - x < ROW_CHUNK ? dst->width - x : ROW_CHUNK;
+			mix_kernel(dst->pixels + dofs + x, a->pixels + aofs + x, b->pixels + bofs + x, weight, n);
+		}
+	}
+}
+
+/*
+ * Wipe from a to b with a rule image.
+ */
+void compose_wipe(struct compose_image *dst, const struct compose_image *a, const struct compose_image *b,
+		  const struct compose_rule *rule, int progress, int vague)
+{
+	uint8_t table[256], weight[ROW_CHUNK];
+	const uint8_t *r;
+	size_t dofs, aofs, bofs;
+	int x, y, n, i;
+
+	assert(progress >= 0 && progress <= 255);
+	assert(vague >= 1 && vague <= 255);
+	assert(a->width == dst->width && a->height == dst->height);
+	assert(b->width == dst->width && b->height == dst->height);
+	assert(rule->width == dst->width && rule->height == dst->height);
+
+	if (mix_kernel == NULL)
+		compose_select(COMPOSE_AUTO);
+
+	make_wipe_table(table, progress, vague);
+
+	for (y = 0; y < dst->height; y++) {
+		dofs = (size_t)y * (size_t)dst->pitch;
+		aofs = (size_t)y * (size_t)a->pitch;
+		bofs = (size_t)y * (size_t)b->pitch;
+		r = rule->pixels + (size_t)y * (size_t)rule->pitch;
+		for (x = 0; x < dst->width; x += n) {
+			n = dst->width - x < ROW_CHUNK ? dst->width - x : ROW_CHUNK;
+			for (i = 0; i < n; i++)
+				weight[i] = table[r[x + i]];
+			mix_kernel(dst->pixels + dofs + x, a->pixels + aofs + x, b->pixels + bofs + x, weight, n);
+		}
+	}
+}
+
+/*
+ * Make the weights of rule values.
+ *  - The threshold moves from 0 to 255 + vague so that both ends show
+ *    only a or only b.
+ */
+static void make_wipe_table(uint8_t *table, int progress, int vague)
+{
+	int threshold, d, i;
+
+	threshold = progress * (255 + vague) / 255;
+	for (i = 0; i < 256; i++) {
+		d = threshold - i;
+		if (d <= 0)
+			table[i] = 0;
+		else if (d >= vague)
+			table[i] = 255;
+		else
+			table[i] = (uint8_t)(d * 255 / vague);
+	}
+}
+
+/*
+ * Scalar
+ */
+
+/* Divide by 255 with rounding. (exact for 0-65025) */
+static INLINE uint32_t div255(uint32_t x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+/* Blend a row. */
+static void blend_scalar(uint32_t *RESTRICT dst, const uint32_t *RESTRICT src, int n, uint32_t opacity)
+{
+	uint32_t s, d, sa, ia, sr, sg, sb;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		s = src[i];
+		sa = s >> 24;
+		sr = (s >> 16) & 0xff;
+		sg = (s >> 8) & 0xff;
+		sb = s & 0xff;
+		if (opacity != 255) {
+			sa = div255(sa * opacity);
+			sr = div255(sr * opacity);
+			sg = div255(sg * opacity);
+			sb = div255(sb * opacity);
+		}
+
+		/* Both are exact shortcuts of the formula below. */
+		if (sa == 0)
+			continue;
+		if (sa == 255) {
+			dst[i] = (sa << 24) | (sr << 16) | (sg << 8) | sb;
+			continue;
+		}
+
+		d = dst[i];
+		ia = 255 - sa;
+		dst[i] = ((sa + div255((d >> 24) * ia)) << 24) |
+			 ((sr + div255(((d >> 16) & 0xff) * ia)) << 16) |
+			 ((sg + div255(((d >> 8) & 0xff) * ia)) << 8) |
+			 (sb + div255((d & 0xff) * ia));
+	}
+}
+
+/* Mix two rows. */
+static void mix_scalar(uint32_t *dst, const uint32_t *a, const uint32_t *b, const uint8_t *t, int n)
+{
+	uint32_t x, y, w, iw, c, r;
+	int i, shift;
+
+	for (i = 0; i < n; i++) {
+		x = a[i];
+		y = b[i];
+		w = t[i];
+		iw = 255 - w;
+		r = 0;
+		for (shift = 0; shift < 32; shift += 8) {
+			c = div255(((x >> shift) & 0xff) * iw + ((y >> shift) & 0xff) * w);
+			r |= c << shift;
+		}
+		dst[i] = r;
+	}
+}
+
+/*
+ * SSE2
+ */
+
+#if defined(USE_SSE2)
+
+/* Divide 16-bit lanes by 255 with rounding. */
+static INLINE __m128i div255_sse2(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/* Blend 2 pixels in 16-bit lanes. */
+static INLINE __m128i blend2_sse2(__m128i s, __m128i d, __m128i op, bool scale)
+{
+	__m128i ia;
+
+	if (scale)
+		s = div255_sse2(_mm_mullo_epi16(s, op));
+	ia = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	ia = _mm_sub_epi16(_mm_set1_epi16(255), ia);
+	return _mm_add_epi16(s, div255_sse2(_mm_mullo_epi16(d, ia)));
+}
+
+/* Blend a row, 4 pixels at a time. */
+static void blend_sse2(uint32_t *RESTRICT dst, const uint32_t *RESTRICT src, int n, uint32_t opacity)
+{
+	__m128i zero, op, s, d, lo, hi;
+	bool scale;
+	int i;
+
+	zero = _mm_setzero_si128();
+	op = _mm_set1_epi16((short)opacity);
+	scale = opacity != 255;
+	for (i = 0; i + 4 <= n; i += 4) {
+		s = _mm_loadu_si128((const __m128i *)(src + i));
+		d = _mm_loadu_si128((const __m128i *)(dst + i));
+		lo = blend2_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), op, scale);
+		hi = blend2_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), op, scale);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+	blend_scalar(dst + i, src + i, n - i, opacity);
+}
+
+/* Mix a row, 4 pixels at a time. */
+static void mix_sse2(uint32_t *dst, const uint32_t *a, const uint32_t *b, const uint8_t *t, int n)
+{
+	__m128i zero, v255, x, y, w, wl, wh, lo, hi;
+	int32_t w4;
+	int i;
+
+	zero = _mm_setzero_si128();
+	v255 = _mm_set1_epi16(255);
+	for (i = 0; i + 4 <= n; i += 4) {
+		/* Repeat each weight for the 4 channels. */
+		memcpy(&w4, t + i, 4);
+		w = _mm_cvtsi32_si128(w4);
+		w = _mm_unpacklo_epi8(w, w);
+		w = _mm_unpacklo_epi16(w, w);
+		wl = _mm_unpacklo_epi8(w, zero);
+		wh = _mm_unpackhi_epi8(w, zero);
+
+		x = _mm_loadu_si128((const __m128i *)(a + i));
+		y = _mm_loadu_si128((const __m128i *)(b + i));
+		lo = div255_sse2(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), _mm_sub_epi16(v255, wl)),
+					       _mm_mullo_epi16(_mm_unpacklo_epi8(y, zero), wl)));
+		hi = div255_sse2(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), _mm_sub_epi16(v255, wh)),
+					       _mm_mullo_epi16(_mm_unpackhi_epi8(y, zero), wh)));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+	mix_scalar(dst + i, a + i, b + i, t + i, n - i);
+}
+
+#endif /* USE_SSE2 */
+
+/*
+ * AVX2
+ *  - The unpack, shuffle and pack instructions work in each 128-bit
+ *    lane, so the pixel order is kept as in SSE2.
+ */
+
+#if defined(USE_AVX2)
+
+#define AVX2_FUNC	__attribute__((target("avx2")))
+
+/* Divide 16-bit lanes by 255 with rounding. */
+static INLINE AVX2_FUNC __m256i div255_avx2(__m256i x)
+{
+	x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+/* Blend 4 pixels in 16-bit lanes. */
+static INLINE AVX2_FUNC __m256i blend4_avx2(__m256i s, __m256i d, __m256i op, bool scale)
+{
+	__m256i ia;
+
+	if (scale)
+		s = div255_avx2(_mm256_mullo_epi16(s, op));
+	ia = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	ia = _mm256_sub_epi16(_mm256_set1_epi16(255), ia);
+	return _mm256_add_epi16(s, div255_avx2(_mm256_mullo_epi16(d, ia)));
+}
+
+/* Blend a row, 8 pixels at a time. */
+static AVX2_FUNC void blend_avx2(uint32_t *RESTRICT dst, const uint32_t *RESTRICT src, int n, uint32_t opacity)
+{
+	__m256i zero, op, s, d, lo, hi;
+	bool scale;
+	int i;
+
+	zero = _mm256_setzero_si256();
+	op = _mm256_set1_epi16((short)opacity);
+	scale = opacity != 255;
+	for (i = 0; i + 8 <= n; i += 8) {
+		s = _mm256_loadu_si256((const __m256i *)(src + i));
+		d = _mm256_loadu_si256((const __m256i *)(dst + i));
+		lo = blend4_avx2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero), op, scale);
+		hi = blend4_avx2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero), op, scale);
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+	}
+	blend_scalar(dst + i, src + i, n - i, opacity);
+}
+
+/* Mix a row, 8 pixels at a time. */
+static AVX2_FUNC void mix_avx2(uint32_t *dst, const uint32_t *a, const uint32_t *b, const uint8_t *t, int n)
+{
+	__m256i zero, v255, x, y, w, wl, wh, lo, hi;
+	int i;
+
+	zero = _mm256_setzero_si256();
+	v255 = _mm256_set1_epi16(255);
+	for (i = 0; i + 8 <= n; i += 8) {
+		/* Repeat each weight for the 4 channels. */
+		w = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(t + i)));
+		w = _mm256_mullo_epi32(w, _mm256_set1_epi32(0x01010101));
+		wl = _mm256_unpacklo_epi8(w, zero);
+		wh = _mm256_unpackhi_epi8(w, zero);
+
+		x = _mm256_loadu_si256((const __m256i *)(a + i));
+		y = _mm256_loadu_si256((const __m256i *)(b + i));
+		lo = div255_avx2(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), _mm256_sub_epi16(v255, wl)),
+						  _mm256_mullo_epi16(_mm256_unpacklo_epi8(y, zero), wl)));
+		hi = div255_avx2(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), _mm256_sub_epi16(v255, wh)),
+						  _mm256_mullo_epi16(_mm256_unpackhi_epi8(y, zero), wh)));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+	}
+	mix_scalar(dst + i, a + i, b + i, t + i, n - i);
+}
+
+#endif /* USE_AVX2 */
+
+/*
+ * NEON
+ *  - The channels are deinterleaved by vld4, so the alpha is val[3] on
+ *    little endian.
+ */
+
+#if defined(USE_NEON)
+
+/* Divide 16-bit lanes by 255 with rounding, and narrow them. */
+static INLINE uint8x8_t div255_neon(uint16x8_t x)
+{
+	return vrshrn_n_u16(vrsraq_n_u16(x, x, 8), 8);
+}
+
+/* Blend a row, 8 pixels at a time. */
+static void blend_neon(uint32_t *RESTRICT dst, const uint32_t *RESTRICT src, int n, uint32_t opacity)
+{
+	uint8x8x4_t s, d;
+	uint8x8_t op, ia;
+	int i, c;
+
+	op = vdup_n_u8((uint8_t)opacity);
+	for (i = 0; i + 8 <= n; i += 8) {
+		s = vld4_u8((const uint8_t *)(src + i));
+		d = vld4_u8((const uint8_t *)(dst + i));
+		if (opacity != 255) {
+			for (c = 0; c < 4; c++)
+				s.val[c] = div255_neon(vmull_u8(s.val[c], op));
+		}
+		ia = vmvn_u8(s.val[3]);
+		for (c = 0; c < 4; c++)
+			d.val[c] = vadd_u8(s.val[c], div255_neon(vmull_u8(d.val[c], ia)));
+		vst4_u8((uint8_t *)(dst + i), d);
+	}
+	blend_scalar(dst + i, src + i, n - i, opacity);
+}
+
+/* Mix a row, 8 pixels at a time. */
+static void mix_neon(uint32_t *dst, const uint32_t *a, const uint32_t *b, const uint8_t *t, int n)
+{
+	uint8x8x4_t x, y;
+	uint8x8_t w, iw;
+	int i, c;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		w = vld1_u8(t + i);
+		iw = vmvn_u8(w);
+		x = vld4_u8((const uint8_t *)(a + i));
+		y = vld4_u8((const uint8_t *)(b + i));
+		for (c = 0; c < 4; c++)
+			x.val[c] = div255_neon(vmlal_u8(vmull_u8(x.val[c], iw), y.val[c], w));
+		vst4_u8((uint8_t *)(dst + i), x);
+	}
+	mix_scalar(dst + i, a + i, b + i, t + i, n - i);
+}
+
+#endif /* USE_NEON */
@@ -0,0 +1,78 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * compose.h: Software compositor for stage layers.
+ *  - Pixels are premultiplied-alpha 0xAARRGGBB words.
+ *  - This module doesn't depend on Linguine or MediaKit so that tools
+ *    can share it.
+ */
+
+#ifndef NOVELKIT_COMPOSE_H
+#define NOVELKIT_COMPOSE_H
+
+#include "compat.h"
+
+/* 32-bit image. */
+struct compose_image {
+	uint32_t *pixels;
+	int width;
+	int height;
+	int pitch;	/* in pixels */
+};
+
+/* 8-bit rule image. (0 is wiped first) */
+struct compose_rule {
+	const uint8_t *pixels;
+	int width;
+	int height;
+	int pitch;	/* in bytes */
+};
+
+/* Kernel paths. */
+enum compose_path {
+	COMPOSE_AUTO,	/* The fastest available path */
+	COMPOSE_SCALAR,
+	COMPOSE_SSE2,
+	COMPOSE_AVX2,
+	COMPOSE_NEON,
+	COMPOSE_PATH_COUNT
+};
+
+/*
+ * Select the kernels of a path.
+ *  - Returns false if the path is not compiled in or the CPU lacks it.
+ */
+bool compose_select(int path);
+
+/* Get the selected path. (COMPOSE_AUTO is resolved) */
+int compose_get_path(void);
+
+/* Get the name of a path. */
+const char *compose_get_path_name(int path);
+
+/*
+ * Draw src over dst at (x, y) with an opacity. (0-255)
+ *  - src is clipped by dst.
+ */
+void compose_blend(struct compose_image *dst, const struct compose_image *src, int x, int y, int opacity);
+
+/*
+ * Crossfade from a to b. (t is 0-255)
+ *  - The three images are the same size. dst may be a or b.
+ */
+void compose_fade(struct compose_image *dst, const struct compose_image *a, const struct compose_image *b, int t);
+
+/*
+ * Wipe from a to b with a rule image.
+ *  - progress is 0-255 and vague is the soft edge width. (1-255)
+ *  - The four images are the same size. dst may be a or b.
+ */
+void compose_wipe(struct compose_image *dst, const struct compose_image *a, const struct compose_image *b,
+		  const struct compose_rule *rule, int progress, int vague);
+
+#endif
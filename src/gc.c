@@ -0,0 +1,163 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * gc.c: Garbage collection scheduler.
+ *  - Garbage is only made by running tags and wait handlers, so a
+ *    collection is skipped if no tag ran since the last one.
+ *  - A full collection of a large heap takes tens of milliseconds. It
+ *    runs in the first idle frame of a wait, after the full frame rate
+ *    kept for an activity has ended, so that the frames right after a
+ *    line of text are not delayed by it. Idle frames sleep anyway, and
+ *    the pause is hidden in the sleep. Active frames of a wait take
+ *    the young collection path.
+ *  - A young collection runs only if the frame work and the average
+ *    young pause fit in the frame time.
+ *  - In a frame that ran many tags (e.g., a scene change) the runtime
+ *    heap is checked and a full collection is forced over the limit.
+ *    Otherwise the collection is deferred to a quiet frame.
+ */
+
+#include "novelkit.h"
+
+/* Frame time budget. (60 fps) */
+#define FRAME_USEC		16667
+
+/* Number of tags that makes a frame busy. */
+#define BUSY_TAGS		8
+
+/* Default heap limit. */
+#define LIMIT_DEFAULT		(64 * 1024 * 1024)
+
+/* Initial estimate of a young collection. */
+#define SHALLOW_ESTIMATE_USEC	1000
+
+/* Heap limit. */
+static size_t limit = LIMIT_DEFAULT;
+
+/* Tags in this frame, and since the last collections. */
+static int frame_tags;
+static int tags_since_shallow;
+static int tags_since_deep;
+
+/* Moving average of young pauses. */
+static uint64_t shallow_estimate = SHALLOW_ESTIMATE_USEC;
+
+/* Statistics. (atomic) */
+static struct gc_stats stats;
+
+/* Forward declarations. */
+static bool is_over_limit(void);
+static bool collect(struct rt_env *rt, bool deep);
+static void add_stat(uint64_t *counter, uint64_t n);
+
+/*
+ * Set the heap limit.
+ */
+void gc_set_limit(size_t bytes)
+{
+	limit = bytes;
+}
+
+/*
+ * Notify a tag dispatch.
+ */
+void gc_notify_tag(void)
+{
+	frame_tags++;
+}
+
+/*
+ * End a frame.
+ */
+bool gc_end_frame(struct rt_env *rt, uint64_t start_usec, bool can_idle)
+{
+	uint64_t work;
+	int tags;
+
+	tags = frame_tags;
+	frame_tags = 0;
+	tags_since_shallow += tags;
+	tags_since_deep += tags;
+
+	if (tags < BUSY_TAGS) {
+		/* Idle: collect the whole heap. */
+		if (can_idle && tags_since_deep > 0)
+			return collect(rt, true);
+
+		/* Time left: collect the young objects. */
+		work = common_get_usec() - start_usec;
+		if (tags_since_shallow > 0 && work + shallow_estimate <= FRAME_USEC)
+			return collect(rt, false);
+	}
+
+	/* No time left. Collect only over the limit. */
+	if (tags_since_deep > 0 && is_over_limit()) {
+		add_stat(&stats.forced_count, 1);
+		return collect(rt, true);
+	}
+	if (tags >= BUSY_TAGS)
+		add_stat(&stats.deferred_count, 1);
+
+	return true;
+}
+
+/* Check if the heap outside the subsystems is over the limit. */
+static bool is_over_limit(void)
+{
+	struct mem_stats heap;
+
+	if (limit == 0)
+		return false;
+
+	mem_get_other_heap_stats(&heap);
+	return heap.current > limit;
+}
+
+/* Run a collection and record the pause. */
+static bool collect(struct rt_env *rt, bool deep)
+{
+	uint64_t start, pause;
+	bool ret;
+
+	start = common_get_usec();
+	ret = deep ? rt_deep_gc(rt) : rt_shallow_gc(rt);
+	pause = common_get_usec() - start;
+
+	if (deep) {
+		tags_since_deep = 0;
+		add_stat(&stats.deep_count, 1);
+	} else {
+		shallow_estimate = (shallow_estimate * 3 + pause) / 4;
+		add_stat(&stats.shallow_count, 1);
+	}
+	tags_since_shallow = 0;
+
+	add_stat(&stats.pause_usec, pause);
+	ATOMIC_MAX(&stats.max_pause_usec, pause);
+
+	return ret;
+}
+
+/* Add to a counter that the other thread may read. */
+static void add_stat(uint64_t *counter, uint64_t n)
+{
+	ATOMIC_ADD(counter, n);
+}
+
+/*
+ * Get the collection statistics.
+ */
+void gc_get_stats(struct gc_stats *ret)
+{
+	ret->shallow_count = ATOMIC_LOAD(&stats.shallow_count);
+	ret->deep_count = ATOMIC_LOAD(&stats.deep_count);
+	ret->forced_count = ATOMIC_LOAD(&stats.forced_count);
+	ret->deferred_count = ATOMIC_LOAD(&stats.deferred_count);
+	ret->pause_usec = ATOMIC_LOAD(&stats.pause_usec);
+	ret->max_pause_usec = ATOMIC_LOAD(&stats.max_pause_usec);
+}
@@ -0,0 +1,55 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * gc.h: Garbage collection scheduler.
+ *  - The runtime collects at the end of a frame of the thread that owns
+ *    it, when the frame has time left: a full collection while the
+ *    scenario waits, and a young collection when the frame work ended
+ *    early.
+ *  - Frames that ran many tags don't collect unless the runtime heap
+ *    is over the limit.
+ */
+
+#ifndef NOVELKIT_GC_H
+#define NOVELKIT_GC_H
+
+#include "compat.h"
+
+struct rt_env;
+
+/* Collection statistics. */
+struct gc_stats {
+	uint64_t shallow_count;
+	uint64_t deep_count;
+	uint64_t forced_count;
+	uint64_t deferred_count;
+	uint64_t pause_usec;
+	uint64_t max_pause_usec;
+};
+
+/*
+ * Set the runtime heap size that forces a collection. (0 to disable)
+ * The limit has no effect without glibc, that reports no heap size.
+ */
+void gc_set_limit(size_t bytes);
+
+/* Notify a tag dispatch. */
+void gc_notify_tag(void);
+
+/*
+ * End a frame and collect if it has time left.
+ *  - start_usec ... time the frame work started.
+ *  - can_idle   ... the scenario waits for an event and the full frame
+ *                   rate after the last activity has ended.
+ */
+bool gc_end_frame(struct rt_env *rt, uint64_t start_usec, bool can_idle);
+
+/* Get the collection statistics. (safe from both threads) */
+void gc_get_stats(struct gc_stats *stats);
+
+#endif
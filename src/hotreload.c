@@ -0,0 +1,170 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * hotreload.c: Scenario file watcher for development builds.
+ *  - We watch the directory that contains the file, not the file
+ *    itself, because many editors save a file by renaming a new one.
+ */
+
+#include "novelkit.h"
+
+#if defined(USE_HOT_RELOAD)
+
+#if defined(TARGET_LINUX)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+/* Size of the event buffer. */
+#define EVENT_BUF_SIZE	4096
+
+/* inotify descriptor. */
+static int fd = -1;
+
+/* Watch descriptor of the directory. */
+static int wd = -1;
+
+/* File name part of the watched file. */
+static char *watch_name;
+
+/* Whether the watched file was modified. */
+static bool is_modified;
+
+#if defined(TARGET_LINUX)
+/* Forward declaration. */
+static void read_events(void);
+#endif
+
+/*
+ * Initialize the watcher.
+ */
+bool hotreload_init(void)
+{
+#if defined(TARGET_LINUX)
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd == -1) {
+		/* Not fatal: the game just runs without hot reloading. */
+		sys_error("Hot reload is disabled: inotify is not available.\n");
+	}
+#endif
+
+	return true;
+}
+
+/*
+ * Cleanup the watcher.
+ */
+void hotreload_cleanup(void)
+{
+#if defined(TARGET_LINUX)
+	if (fd != -1) {
+		close(fd);
+		fd = -1;
+	}
+#endif
+	wd = -1;
+	free(watch_name);
+	watch_name = NULL;
+	is_modified = false;
+}
+
+/*
+ * Start watching a file.
+ */
+void hotreload_watch(const char *file)
+{
+#if defined(TARGET_LINUX)
+	const char *slash;
+	char *dir;
+
+	if (fd == -1)
+		return;
+
+	/* Unwatch the previous directory. */
+	if (wd != -1) {
+		inotify_rm_watch(fd, wd);
+		wd = -1;
+	}
+	free(watch_name);
+	watch_name = NULL;
+	is_modified = false;
+
+	/* Split the directory and the file name. */
+	slash = strrchr(file, '/');
+	if (slash != NULL) {
+		dir = strdup(file);
+		if (dir == NULL)
+			return;
+		dir[slash - file] = '\0';
+		watch_name = strdup(slash + 1);
+	} else {
+		dir = strdup(".");
+		if (dir == NULL)
+			return;
+		watch_name = strdup(file);
+	}
+	if (watch_name == NULL) {
+		free(dir);
+		return;
+	}
+
+	wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	free(dir);
+#else
+	UNUSED_PARAMETER(file);
+#endif
+}
+
+/*
+ * Check if the watched file was modified since the last call.
+ */
+bool hotreload_is_modified(const char *file)
+{
+	UNUSED_PARAMETER(file);
+
+#if defined(TARGET_LINUX)
+	if (fd == -1 || wd == -1)
+		return false;
+
+	/* Several events for a save are merged into one. */
+	read_events();
+	if (!is_modified)
+		return false;
+
+	is_modified = false;
+	return true;
+#else
+	return false;
+#endif
+}
+
+#if defined(TARGET_LINUX)
+/* Drain the inotify events without blocking. */
+static void read_events(void)
+{
+	char buf[EVENT_BUF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	ssize_t len;
+	char *p;
+
+	for (;;) {
+		len = read(fd, buf, sizeof(buf));
+		if (len <= 0)
+			break;
+
+		for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len) {
+			ev = (const struct inotify_event *)p;
+			if (ev->wd == wd && ev->len > 0 && strcmp(ev->name, watch_name) == 0)
+				is_modified = true;
+		}
+	}
+}
+#endif
+
+#endif /* defined(USE_HOT_RELOAD) */
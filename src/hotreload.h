@@ -0,0 +1,35 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * hotreload.h: Scenario file watcher for development builds.
+ *  - Enabled by USE_HOT_RELOAD.
+ *  - Uses inotify on Linux, and does nothing on other platforms.
+ */
+
+#ifndef NOVELKIT_HOTRELOAD_H
+#define NOVELKIT_HOTRELOAD_H
+
+#include "compat.h"
+
+#if defined(USE_HOT_RELOAD)
+
+/* Initialize the watcher. */
+bool hotreload_init(void);
+
+/* Cleanup the watcher. */
+void hotreload_cleanup(void);
+
+/* Start watching a file. (the previous file is unwatched) */
+void hotreload_watch(const char *file);
+
+/* Check if the watched file was modified since the last call. */
+bool hotreload_is_modified(const char *file);
+
+#endif
+
+#endif
@@ -0,0 +1,237 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * idle.c: Frame rate control while waiting.
+ *  - The frame handler runs on the platform's frame loop, so the only
+ *    way to skip frames is to wait in it. An idle frame waits until
+ *    the next idle frame time or the end of a timed wait, whichever
+ *    comes first.
+ *  - The wait is a condition variable with the frame time as the
+ *    timeout. An activity (a tag, a stage change by the logic thread)
+ *    and the HAL input callbacks signal it, so the frame ends early.
+ *    Signaling is skipped while no frame waits, since tags notify an
+ *    activity at every dispatch.
+ *  - The HAL presents a frame after the frame handler returns, and
+ *    has no call to skip it, so the wait is the only way to pace it.
+ *  - Platforms without POSIX threads sleep for the whole time.
+ *  - The CPU time of the process in idle frames is measured against
+ *    their wall time to give the CPU cost of an idle minute.
+ */
+
+#include "novelkit.h"
+
+#include <time.h>
+
+#if defined(TARGET_LINUX) || defined(TARGET_MACOS) || defined(TARGET_IOS) || defined(TARGET_ANDROID)
+#define USE_WAKE_COND
+#include <pthread.h>
+#include <errno.h>
+#endif
+
+/* Default idle frame rate. */
+#define IDLE_FPS_DEFAULT	10
+
+/* Time to keep the full frame rate after an activity. */
+#define ACTIVE_USEC		500000
+
+/* Idle frame interval, or 0 if disabled. */
+static uint64_t idle_interval = 1000000 / IDLE_FPS_DEFAULT;
+
+/* Time until which the full frame rate is kept. (atomic for the logic thread) */
+static uint64_t active_until;
+
+/* Time of the last frame end. */
+static uint64_t last_frame;
+
+/* Statistics. */
+static struct idle_stats stats;
+
+/* Clocks at the last frame end. */
+static uint64_t last_wall_usec;
+static uint64_t last_cpu_usec;
+
+#if defined(USE_WAKE_COND)
+/* Wake-up signal. (guarded by the mutex) */
+static pthread_mutex_t wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+static bool is_woken;
+
+/* Whether a frame waits. (atomic, for the signalers) */
+static bool is_waiting;
+#endif
+
+/* Forward declarations. */
+static void extend_active(uint64_t until);
+static void wake_up(void);
+static uint64_t wait_activity(uint64_t usec);
+static uint64_t get_cpu_usec(void);
+
+/*
+ * Set the idle frame rate.
+ */
+void idle_set_fps(int fps)
+{
+	idle_interval = fps > 0 ? 1000000 / (uint64_t)fps : 0;
+}
+
+/*
+ * Keep the full frame rate for a duration.
+ */
+void idle_keep_active(float seconds)
+{
+	uint64_t until;
+
+	if (seconds <= 0)
+		return;
+
+	until = replay_get_usec() + (uint64_t)(seconds * 1000000.0f);
+	extend_active(until);
+	wake_up();
+}
+
+/*
+ * Notify an activity that may change the screen.
+ */
+void idle_notify_activity(void)
+{
+	uint64_t until;
+
+	until = replay_get_usec() + ACTIVE_USEC;
+	extend_active(until);
+	wake_up();
+}
+
+/*
+ * Check if the full frame rate is kept after an activity.
+ */
+bool idle_is_active(void)
+{
+	return replay_get_usec() < ATOMIC_LOAD(&active_until);
+}
+
+/* Extend the full frame rate time. */
+static void extend_active(uint64_t until)
+{
+	ATOMIC_MAX(&active_until, until);
+}
+
+/*
+ * End the wait of an idle frame. (for the HAL input callbacks)
+ */
+void idle_wake(void)
+{
+	wake_up();
+}
+
+/* End the wait of an idle frame if a frame waits. */
+static void wake_up(void)
+{
+#if defined(USE_WAKE_COND)
+	/* Order the activity before the check. Pairs with wait_activity(). */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!ATOMIC_LOAD(&is_waiting))
+		return;
+
+	pthread_mutex_lock(&wake_mutex);
+	is_woken = true;
+	pthread_cond_signal(&wake_cond);
+	pthread_mutex_unlock(&wake_mutex);
+#endif
+}
+
+/* Wait for an activity or a timeout, and return the time waited. */
+static uint64_t wait_activity(uint64_t usec)
+{
+#if defined(USE_WAKE_COND)
+	struct timespec ts;
+	uint64_t start, ns;
+
+	start = common_get_usec();
+
+	/* The default clock of a condition variable is the real time. */
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ns = (uint64_t)ts.tv_nsec + (usec % 1000000) * 1000;
+	ts.tv_sec += (time_t)(usec / 1000000 + ns / 1000000000);
+	ts.tv_nsec = (long)(ns % 1000000000);
+
+	pthread_mutex_lock(&wake_mutex);
+	is_woken = false;
+	ATOMIC_STORE(&is_waiting, true);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	/* An activity that didn't see the flag has extended the active time. */
+	while (!is_woken && !idle_is_active()) {
+		if (pthread_cond_timedwait(&wake_cond, &wake_mutex, &ts) == ETIMEDOUT)
+			break;
+	}
+	ATOMIC_STORE(&is_waiting, false);
+	pthread_mutex_unlock(&wake_mutex);
+
+	return common_get_usec() - start;
+#else
+	common_sleep_usec(usec);
+	return usec;
+#endif
+}
+
+/*
+ * End a frame.
+ */
+void idle_end_frame(bool can_idle, uint64_t deadline)
+{
+	uint64_t now, wake, slept, wall, cpu;
+	bool is_idle;
+
+	stats.frames++;
+
+	now = replay_get_usec();
+	is_idle = can_idle && idle_interval > 0 &&
+		  now >= ATOMIC_LOAD(&active_until);
+	if (is_idle) {
+		/* Wait until the next idle frame, the end of the wait or an activity. */
+		wake = last_frame + idle_interval;
+		if (deadline != 0 && deadline < wake)
+			wake = deadline;
+		if (wake > now && replay_can_sleep()) {
+			slept = wait_activity(wake - now);
+			stats.sleep_usec += slept;
+
+			/* The game clock stays at the frame start while recording. */
+			now = slept < wake - now ? now + slept : wake;
+		}
+		stats.idle_frames++;
+	}
+	last_frame = now;
+
+	/* Measure the CPU time of idle frames. */
+	wall = common_get_usec();
+	cpu = get_cpu_usec();
+	if (is_idle && last_wall_usec != 0) {
+		stats.idle_usec += wall - last_wall_usec;
+		stats.idle_cpu_usec += cpu - last_cpu_usec;
+	}
+	last_wall_usec = wall;
+	last_cpu_usec = cpu;
+}
+
+/*
+ * Get the frame statistics.
+ */
+void idle_get_stats(struct idle_stats *ret)
+{
+	*ret = stats;
+	ret->cpu_usec = get_cpu_usec();
+	ret->idle_cpu_per_minute_usec = stats.idle_usec > 0 ?
+		(uint64_t)((double)stats.idle_cpu_usec * 60000000.0 / (double)stats.idle_usec) : 0;
+}
+
+/* Get the CPU time of the process. */
+static uint64_t get_cpu_usec(void)
+{
+	return (uint64_t)clock() * 1000000 / CLOCKS_PER_SEC;
+}
@@ -0,0 +1,58 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * idle.h: Frame rate control while waiting.
+ *  - When the scenario waits and nothing happened for a while, the
+ *    frame handler sleeps to run at the idle frame rate.
+ *  - Input, tags, stage changes and NovelKit.keepActive() bring the
+ *    full frame rate back.
+ */
+
+#ifndef NOVELKIT_IDLE_H
+#define NOVELKIT_IDLE_H
+
+#include "compat.h"
+
+/* Frame statistics. */
+struct idle_stats {
+	uint64_t frames;
+	uint64_t idle_frames;
+	uint64_t sleep_usec;
+	uint64_t cpu_usec;
+	uint64_t idle_usec;			/* wall time of idle frames */
+	uint64_t idle_cpu_usec;			/* CPU time of idle frames */
+	uint64_t idle_cpu_per_minute_usec;	/* CPU time per idle minute */
+};
+
+/* Set the idle frame rate. (0 to disable idling) */
+void idle_set_fps(int fps);
+
+/* Keep the full frame rate for a duration. (e.g., for an animation) */
+void idle_keep_active(float seconds);
+
+/* Notify an activity that may change the screen. */
+void idle_notify_activity(void);
+
+/* Check if the full frame rate is kept after an activity. (any thread) */
+bool idle_is_active(void);
+
+/* End the wait of an idle frame. (any thread, e.g., HAL input) */
+void idle_wake(void);
+
+/*
+ * End a frame.
+ *  - can_idle ... the scenario waits for an event that does not need
+ *                 every frame.
+ *  - deadline ... time the wait ends, or 0.
+ */
+void idle_end_frame(bool can_idle, uint64_t deadline);
+
+/* Get the frame statistics. */
+void idle_get_stats(struct idle_stats *stats);
+
+#endif
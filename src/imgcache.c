@@ -0,0 +1,292 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * imgcache.c: Decoded image cache.
+ *  - Entries are found by a hash table of file names.
+ *  - Entries without references are in a doubly linked LRU list. An
+ *    entry leaves the list while it has references, so eviction never
+ *    touches an image on the screen.
+ *  - If referenced images alone exceed the budget, the cache goes over
+ *    the budget rather than failing.
+ */
+
+#include "novelkit.h"
+
+/* Default budget. */
+#define BUDGET_DEFAULT	((size_t)256 * 1024 * 1024)
+
+/* Hash table size. (power of two) */
+#define BUCKET_COUNT	256
+
+/* Cache entry. */
+struct entry {
+	char *file;
+	uint64_t hash;
+	struct image *img;
+	size_t bytes;
+	int ref;
+
+	/* Hash chain. */
+	struct entry *chain;
+
+	/* LRU list. (only while ref is zero) */
+	struct entry *prev;
+	struct entry *next;
+};
+
+/* Hash table. */
+static struct entry *bucket[BUCKET_COUNT];
+
+/* LRU list. (head is the oldest) */
+static struct entry *lru_head;
+static struct entry *lru_tail;
+
+/* Budget and statistics. */
+static size_t budget = BUDGET_DEFAULT;
+static struct imgcache_stats stats;
+
+/* Forward declarations. */
+static struct entry *find_entry(const char *file, uint64_t hash);
+static struct entry *load_entry(const char *file, uint64_t hash);
+static void evict(void);
+static void destroy_entry(struct entry *e);
+static void lru_push(struct entry *e);
+static void lru_remove(struct entry *e);
+
+/*
+ * Set the byte budget.
+ */
+void imgcache_set_budget(size_t bytes)
+{
+	budget = bytes;
+	evict();
+}
+
+/*
+ * Get an image and add a reference.
+ */
+bool imgcache_acquire(const char *file, struct image **img)
+{
+	struct entry *e;
+	uint64_t hash;
+
+	hash = common_hash64(file, strlen(file));
+	e = find_entry(file, hash);
+	if (e != NULL) {
+		stats.hits++;
+		if (e->ref == 0)
+			lru_remove(e);
+	} else {
+		stats.misses++;
+		e = load_entry(file, hash);
+		if (e == NULL)
+			return false;
+	}
+	e->ref++;
+
+	/* Make room for the new image if it is over the budget. */
+	evict();
+
+	*img = e->img;
+	return true;
+}
+
+/*
+ * Remove a reference.
+ */
+bool imgcache_release(const char *file)
+{
+	struct entry *e;
+
+	e = find_entry(file, common_hash64(file, strlen(file)));
+	if (e == NULL || e->ref == 0) {
+		api_error("Image %s is not referenced.", file);
+		return false;
+	}
+
+	if (--e->ref == 0) {
+		lru_push(e);
+		evict();
+	}
+
+	return true;
+}
+
+/*
+ * Load an image without a reference.
+ */
+bool imgcache_preload(const char *file)
+{
+	struct entry *e;
+	uint64_t hash;
+
+	hash = common_hash64(file, strlen(file));
+	e = find_entry(file, hash);
+	if (e != NULL) {
+		/* Refresh the LRU position. */
+		if (e->ref == 0) {
+			lru_remove(e);
+			lru_push(e);
+		}
+		return true;
+	}
+
+	e = load_entry(file, hash);
+	if (e == NULL)
+		return false;
+	lru_push(e);
+	evict();
+
+	return true;
+}
+
+/* Find an entry. */
+static struct entry *find_entry(const char *file, uint64_t hash)
+{
+	struct entry *e;
+
+	for (e = bucket[hash & (BUCKET_COUNT - 1)]; e != NULL; e = e->chain) {
+		if (e->hash == hash && strcmp(e->file, file) == 0)
+			return e;
+	}
+
+	return NULL;
+}
+
+/* Load an image into a new entry without a reference. */
+static struct entry *load_entry(const char *file, uint64_t hash)
+{
+	struct entry *e;
+	uint64_t start;
+
+	e = mem_calloc(MEM_ASSET, 1, sizeof(struct entry));
+	if (e == NULL) {
+		api_out_of_memory();
+		return NULL;
+	}
+	e->file = mem_strdup(MEM_ASSET, file);
+	if (e->file == NULL) {
+		mem_free(e);
+		api_out_of_memory();
+		return NULL;
+	}
+
+	start = common_get_usec();
+	if (!create_image_from_file(file, &e->img)) {
+		api_error("Cannot load image %s.", file);
+		mem_free(e->file);
+		mem_free(e);
+		return NULL;
+	}
+	stats.load_usec += common_get_usec() - start;
+
+	e->hash = hash;
+	e->bytes = (size_t)get_image_width(e->img) * (size_t)get_image_height(e->img) * 4;
+	mem_account(MEM_ASSET, e->bytes);
+
+	e->chain = bucket[hash & (BUCKET_COUNT - 1)];
+	bucket[hash & (BUCKET_COUNT - 1)] = e;
+
+	stats.count++;
+	stats.bytes += e->bytes;
+	if (stats.bytes > stats.peak_bytes)
+		stats.peak_bytes = stats.bytes;
+
+	return e;
+}
+
+/* Evict images without references until the cache fits the budget. */
+static void evict(void)
+{
+	struct entry *e;
+
+	while (stats.bytes > budget && lru_head != NULL) {
+		e = lru_head;
+		lru_remove(e);
+		destroy_entry(e);
+		stats.evictions++;
+	}
+}
+
+/* Remove an entry from the hash table and destroy it. */
+static void destroy_entry(struct entry *e)
+{
+	struct entry **p;
+
+	for (p = &bucket[e->hash & (BUCKET_COUNT - 1)]; *p != e; p = &(*p)->chain)
+		;
+	*p = e->chain;
+
+	destroy_image(e->img);
+	mem_unaccount(MEM_ASSET, e->bytes);
+	stats.count--;
+	stats.bytes -= e->bytes;
+
+	mem_free(e->file);
+	mem_free(e);
+}
+
+/* Add an entry to the newest end of the LRU list. */
+static void lru_push(struct entry *e)
+{
+	e->prev = lru_tail;
+	e->next = NULL;
+	if (lru_tail != NULL)
+		lru_tail->next = e;
+	else
+		lru_head = e;
+	lru_tail = e;
+}
+
+/* Remove an entry from the LRU list. */
+static void lru_remove(struct entry *e)
+{
+	if (e->prev != NULL)
+		e->prev->next = e->next;
+	else
+		lru_head = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	else
+		lru_tail = e->prev;
+	e->prev = NULL;
+	e->next = NULL;
+}
+
+/*
+ * Get the statistics.
+ */
+void imgcache_get_stats(struct imgcache_stats *ret)
+{
+	*ret = stats;
+	ret->budget = budget;
+}
+
+/*
+ * Destroy all images.
+ */
+void imgcache_cleanup(void)
+{
+	struct entry *e, *next;
+	int i;
+
+	for (i = 0; i < BUCKET_COUNT; i++) {
+		for (e = bucket[i]; e != NULL; e = next) {
+			next = e->chain;
+			destroy_image(e->img);
+			mem_unaccount(MEM_ASSET, e->bytes);
+			mem_free(e->file);
+			mem_free(e);
+		}
+		bucket[i] = NULL;
+	}
+	lru_head = NULL;
+	lru_tail = NULL;
+	stats.count = 0;
+	stats.bytes = 0;
+}
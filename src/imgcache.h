@@ -0,0 +1,56 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * imgcache.h: Decoded image cache.
+ *  - Images are shared by file name and counted by references.
+ *  - Images without references are kept in LRU order and evicted when
+ *    the total size exceeds the budget.
+ *  - Images are HAL objects, so this module is used on the main thread.
+ */
+
+#ifndef NOVELKIT_IMGCACHE_H
+#define NOVELKIT_IMGCACHE_H
+
+#include "compat.h"
+
+struct image;
+
+/* Statistics. */
+struct imgcache_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t load_usec;
+	size_t bytes;
+	size_t peak_bytes;
+	size_t budget;
+	int count;
+};
+
+/* Set the byte budget. */
+void imgcache_set_budget(size_t bytes);
+
+/*
+ * Get an image and add a reference.
+ *  - The image is loaded if it is not cached.
+ */
+bool imgcache_acquire(const char *file, struct image **img);
+
+/* Remove a reference. */
+bool imgcache_release(const char *file);
+
+/* Load an image without a reference, for a later acquire. */
+bool imgcache_preload(const char *file);
+
+/* Get the statistics. */
+void imgcache_get_stats(struct imgcache_stats *stats);
+
+/* Destroy all images. */
+void imgcache_cleanup(void);
+
+#endif
@@ -0,0 +1,272 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * interp.c: Variable interpolation in property values.
+ *  - A string is split into literal spans and variable references when
+ *    a scenario is loaded. Literal spans point into the source string.
+ *  - A compiled string, its segments and the variable names are in a
+ *    single allocation.
+ *  - Rendering sums up the segment sizes first, then copies the
+ *    segments into a reusable buffer. Variable indices are resolved at
+ *    the first render and cached because they are stable.
+ */
+
+#include "novelkit.h"
+
+/* Unresolved variable index. */
+#define VAR_UNRESOLVED	(-1)
+
+/* Segment. */
+struct interp_seg {
+	/* Literal span, or NULL for a variable. */
+	const char *text;
+
+	/* Length of the literal span, or the value length while rendering. */
+	size_t len;
+
+	/* Variable name and index. */
+	const char *name;
+	int var;
+};
+
+/* Compiled string. */
+struct interp {
+	const char *source;
+	bool has_var;
+	bool has_escape;
+	int seg_count;
+	size_t literal_len;
+	struct interp_seg seg[];
+};
+
+/* Render buffer. */
+static char *buf;
+static size_t buf_size;
+
+/* Forward declarations. */
+static int scan(const char *s, struct interp *ip, char *names, size_t *names_len);
+static bool reserve_buf(size_t size);
+
+/*
+ * Check if a string has variable references.
+ */
+bool interp_has_vars(const char *s)
+{
+	return strstr(s, "${") != NULL;
+}
+
+/*
+ * Compile a string into segments.
+ */
+struct interp *interp_compile(const char *s)
+{
+	struct interp *ip;
+	size_t names_len;
+	int seg_count;
+
+	assert(s != NULL);
+
+	/* Count the segments and the name bytes. */
+	seg_count = scan(s, NULL, NULL, &names_len);
+	if (seg_count < 0) {
+		api_error("Unterminated variable reference in \"%s\".", s);
+		return NULL;
+	}
+
+	ip = mem_alloc(MEM_SCENARIO, sizeof(struct interp) + (size_t)seg_count * sizeof(struct interp_seg) + names_len);
+	if (ip == NULL) {
+		api_out_of_memory();
+		return NULL;
+	}
+
+	/* Fill the segments. */
+	ip->source = s;
+	ip->seg_count = seg_count;
+	scan(s, ip, (char *)&ip->seg[seg_count], &names_len);
+
+	return ip;
+}
+
+/*
+ * Scan a string.
+ *  - Without ip, only counts the segments and the name bytes.
+ *  - Returns the segment count, or -1 for an unterminated reference.
+ */
+static int scan(const char *s, struct interp *ip, char *names, size_t *names_len)
+{
+	const char *p, *lit, *end;
+	int n;
+
+	n = 0;
+	*names_len = 0;
+	if (ip != NULL) {
+		ip->has_var = false;
+		ip->has_escape = false;
+		ip->literal_len = 0;
+	}
+
+	lit = s;
+	p = s;
+	while (*p != '\0') {
+		/* "$${" is a literal "${". Keep the first '$' in the span. */
+		if (p[0] == '$' && p[1] == '$' && p[2] == '{') {
+			if (ip != NULL) {
+				ip->seg[n].text = lit;
+				ip->seg[n].len = (size_t)(p + 1 - lit);
+				ip->seg[n].name = NULL;
+				ip->literal_len += ip->seg[n].len;
+				ip->has_escape = true;
+			}
+			n++;
+			lit = p + 2;
+			p += 3;
+			continue;
+		}
+
+		if (p[0] != '$' || p[1] != '{') {
+			p++;
+			continue;
+		}
+
+		end = strchr(p + 2, '}');
+		if (end == NULL || end == p + 2)
+			return -1;
+
+		/* Put the literal before the reference. */
+		if (p > lit) {
+			if (ip != NULL) {
+				ip->seg[n].text = lit;
+				ip->seg[n].len = (size_t)(p - lit);
+				ip->seg[n].name = NULL;
+				ip->literal_len += ip->seg[n].len;
+			}
+			n++;
+		}
+
+		/* Put the reference. */
+		if (ip != NULL) {
+			memcpy(names, p + 2, (size_t)(end - p - 2));
+			names[end - p - 2] = '\0';
+			ip->seg[n].text = NULL;
+			ip->seg[n].len = 0;
+			ip->seg[n].name = names;
+			ip->seg[n].var = VAR_UNRESOLVED;
+			ip->has_var = true;
+			names += end - p - 1;
+		}
+		*names_len += (size_t)(end - p - 1);
+		n++;
+
+		p = end + 1;
+		lit = p;
+	}
+
+	/* Put the last literal. */
+	if (p > lit) {
+		if (ip != NULL) {
+			ip->seg[n].text = lit;
+			ip->seg[n].len = (size_t)(p - lit);
+			ip->seg[n].name = NULL;
+			ip->literal_len += ip->seg[n].len;
+		}
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Render a compiled string.
+ */
+const char *interp_render(struct interp *ip)
+{
+	struct interp_seg *seg;
+	size_t size;
+	char *p;
+	int i;
+
+	assert(ip != NULL);
+
+	/* A single literal is the source itself. */
+	if (!ip->has_var && !ip->has_escape)
+		return ip->source;
+
+	/* Resolve the variables and sum up the sizes. */
+	size = ip->literal_len;
+	for (i = 0; i < ip->seg_count; i++) {
+		seg = &ip->seg[i];
+		if (seg->text != NULL)
+			continue;
+		if (seg->var == VAR_UNRESOLVED) {
+			seg->var = var_find(VAR_FLAG, seg->name);
+			if (seg->var < 0) {
+				seg->var = VAR_UNRESOLVED;
+				api_error("Variable %s is not defined.", seg->name);
+				return NULL;
+			}
+		}
+		seg->len = strlen(var_get_value(VAR_FLAG, seg->var));
+		size += seg->len;
+	}
+
+	if (!reserve_buf(size + 1))
+		return NULL;
+
+	/* Copy the segments. */
+	p = buf;
+	for (i = 0; i < ip->seg_count; i++) {
+		seg = &ip->seg[i];
+		memcpy(p, seg->text != NULL ? seg->text : var_get_value(VAR_FLAG, seg->var), seg->len);
+		p += seg->len;
+	}
+	*p = '\0';
+
+	return buf;
+}
+
+/* Grow the render buffer. */
+static bool reserve_buf(size_t size)
+{
+	char *new_buf;
+	size_t new_size;
+
+	if (size <= buf_size)
+		return true;
+
+	new_size = buf_size == 0 ? 256 : buf_size;
+	while (new_size < size)
+		new_size *= 2;
+
+	new_buf = mem_realloc(MEM_SCENARIO, buf, new_size);
+	if (new_buf == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+	buf = new_buf;
+	buf_size = new_size;
+
+	return true;
+}
+
+/*
+ * Free a compiled string.
+ */
+void interp_free(struct interp *ip)
+{
+	mem_free(ip);
+}
+
+/*
+ * Free the render buffer.
+ */
+void interp_cleanup(void)
+{
+	mem_free(buf);
+	buf = NULL;
+	buf_size = 0;
+}
@@ -0,0 +1,44 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * interp.h: Variable interpolation in property values.
+ *  - "${name}" is replaced by the value of the flag variable "name".
+ *  - "$${" is a literal "${".
+ */
+
+#ifndef NOVELKIT_INTERP_H
+#define NOVELKIT_INTERP_H
+
+#include "compat.h"
+
+/* Compiled string. */
+struct interp;
+
+/* Check if a string has variable references. */
+bool interp_has_vars(const char *s);
+
+/*
+ * Compile a string into segments.
+ *  - The string must live longer than the compiled one.
+ */
+struct interp *interp_compile(const char *s);
+
+/*
+ * Render a compiled string.
+ *  - The result is valid until the next render.
+ *  - Returns NULL if a variable is not defined.
+ */
+const char *interp_render(struct interp *ip);
+
+/* Free a compiled string. */
+void interp_free(struct interp *ip);
+
+/* Free the render buffer. */
+void interp_cleanup(void);
+
+#endif
@@ -0,0 +1,303 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * logic.c: Logic thread. (USE_LOGIC_THREAD)
+ *  - Stage states are passed by a triple buffer: the logic thread
+ *    writes the back slot and swaps it with the middle slot, and the
+ *    main thread swaps the middle slot with the front slot when the
+ *    middle slot has a new state. Neither side waits for the other.
+ *  - The logic thread builds a new state only when the stage
+ *    variables changed.
+ */
+
+#include "novelkit.h"
+
+#if defined(USE_LOGIC_THREAD)
+
+#include <pthread.h>
+
+/* Logic tick. (60Hz) */
+#define TICK_USEC	16667
+
+/* Number of sound tracks reported to the logic thread. */
+#define TRACK_MAX	32
+
+/* Flag of the middle slot index for a new state. */
+#define SLOT_NEW	4
+
+/* Stage state. */
+struct stage_slot {
+	/* "name\0value\0" pairs. */
+	char *data;
+	size_t size;
+	size_t alloc;
+
+	/* Offsets of names. */
+	size_t *name_ofs;
+	int count;
+	int count_alloc;
+};
+
+/* Triple buffer. */
+static struct stage_slot slot[3];
+static int back_slot = 0;
+static int middle_slot = 1;	/* Atomic, with SLOT_NEW. */
+static int front_slot = 2;
+
+/* Logic thread. */
+static pthread_t thread;
+static bool (*step_func)(void);
+static bool is_failed;		/* Atomic. */
+
+/* Input and the HAL status. (atomic) */
+static int click_count;
+static uint32_t sound_finished_bits;
+static bool is_video_playing_flag;
+
+/* Idle status of the logic thread. (atomic) */
+static bool can_idle;
+static uint64_t idle_deadline;
+
+/* Last committed generation of the stage variables. (logic thread) */
+static uint32_t committed_gen;
+
+/* Forward declarations. */
+static void *logic_main(void *p);
+static bool commit_stage(void);
+static bool append(struct stage_slot *s, const char *str);
+
+/*
+ * Start the logic thread.
+ */
+bool logic_start(bool (*step)(void))
+{
+	/* Commit the stage made by first(). */
+	committed_gen = var_get_generation(VAR_STAGE) - 1;
+	if (!commit_stage())
+		return false;
+
+	step_func = step;
+	if (pthread_create(&thread, NULL, logic_main, NULL) != 0) {
+		sys_error("Cannot start the logic thread.\n");
+		return false;
+	}
+	pthread_detach(thread);
+
+	return true;
+}
+
+/* Logic thread main. */
+static void *logic_main(void *p)
+{
+	uint64_t next, now, deadline;
+	bool idle;
+
+	UNUSED_PARAMETER(p);
+
+	next = common_get_usec();
+	for (;;) {
+		/* Apply input. */
+		if (__atomic_exchange_n(&click_count, 0, __ATOMIC_ACQ_REL) > 0)
+			wait_notify_click();
+
+		/* Run the scenario. */
+		if (!step_func() || !commit_stage()) {
+			__atomic_store_n(&is_failed, true, __ATOMIC_RELEASE);
+			break;
+		}
+
+		/* Publish the idle status. */
+		idle = scenario_can_idle(&deadline);
+		__atomic_store_n(&idle_deadline, deadline, __ATOMIC_RELAXED);
+		__atomic_store_n(&can_idle, idle, __ATOMIC_RELAXED);
+
+		/* Wait for the next tick. Skip ticks if behind. */
+		next += TICK_USEC;
+		now = common_get_usec();
+		if (now < next)
+			common_sleep_usec(next - now);
+		else
+			next = now;
+	}
+
+	return NULL;
+}
+
+/* Commit the stage variables if changed. (logic thread) */
+static bool commit_stage(void)
+{
+	struct stage_slot *s;
+	uint32_t gen;
+	int i, count;
+
+	gen = var_get_generation(VAR_STAGE);
+	if (gen == committed_gen)
+		return true;
+
+	/* Build the back slot. */
+	s = &slot[back_slot];
+	count = var_get_count(VAR_STAGE);
+	if (count > s->count_alloc) {
+		mem_free(s->name_ofs);
+		s->name_ofs = mem_alloc(MEM_SCENARIO, (size_t)count * sizeof(size_t));
+		if (s->name_ofs == NULL) {
+			s->count_alloc = 0;
+			sys_out_of_memory();
+			return false;
+		}
+		s->count_alloc = count;
+	}
+	s->size = 0;
+	for (i = 0; i < count; i++) {
+		s->name_ofs[i] = s->size;
+		if (!append(s, var_get_name(VAR_STAGE, i)) ||
+		    !append(s, var_get_value(VAR_STAGE, i)))
+			return false;
+	}
+	s->count = count;
+
+	/* Swap the back slot and the middle slot. */
+	back_slot = __atomic_exchange_n(&middle_slot, back_slot | SLOT_NEW, __ATOMIC_ACQ_REL) & ~SLOT_NEW;
+	committed_gen = gen;
+
+	return true;
+}
+
+/* Append a NUL-terminated string to a slot. */
+static bool append(struct stage_slot *s, const char *str)
+{
+	char *new_data;
+	size_t len, new_alloc;
+
+	len = strlen(str) + 1;
+	if (s->size + len > s->alloc) {
+		new_alloc = s->alloc == 0 ? 1024 : s->alloc;
+		while (new_alloc < s->size + len)
+			new_alloc *= 2;
+		new_data = mem_realloc(MEM_SCENARIO, s->data, new_alloc);
+		if (new_data == NULL) {
+			sys_out_of_memory();
+			return false;
+		}
+		s->data = new_data;
+		s->alloc = new_alloc;
+	}
+
+	memcpy(s->data + s->size, str, len);
+	s->size += len;
+
+	return true;
+}
+
+/*
+ * Check if the logic thread stopped by an error.
+ */
+bool logic_is_failed(void)
+{
+	return __atomic_load_n(&is_failed, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Post a click.
+ */
+void logic_post_click(void)
+{
+	__atomic_add_fetch(&click_count, 1, __ATOMIC_ACQ_REL);
+}
+
+/*
+ * Publish the sound and movie status.
+ */
+void logic_publish_hal_status(void)
+{
+	uint32_t bits;
+	int i;
+
+	bits = 0;
+	for (i = 0; i < TRACK_MAX; i++) {
+		if (is_sound_finished(i))
+			bits |= 1U << i;
+	}
+
+	__atomic_store_n(&sound_finished_bits, bits, __ATOMIC_RELAXED);
+	__atomic_store_n(&is_video_playing_flag, is_video_playing(), __ATOMIC_RELAXED);
+}
+
+/*
+ * Check if a sound track finished.
+ */
+bool logic_is_sound_finished(int track)
+{
+	if (track < 0 || track >= TRACK_MAX)
+		return true;
+
+	return (__atomic_load_n(&sound_finished_bits, __ATOMIC_RELAXED) & (1U << track)) != 0;
+}
+
+/*
+ * Check if the movie is playing.
+ */
+bool logic_is_video_playing(void)
+{
+	return __atomic_load_n(&is_video_playing_flag, __ATOMIC_RELAXED);
+}
+
+/*
+ * Get the latest committed stage.
+ */
+bool logic_update_stage(void)
+{
+	if ((__atomic_load_n(&middle_slot, __ATOMIC_ACQUIRE) & SLOT_NEW) == 0)
+		return false;
+
+	front_slot = __atomic_exchange_n(&middle_slot, front_slot, __ATOMIC_ACQ_REL) & ~SLOT_NEW;
+
+	return true;
+}
+
+/*
+ * Get the number of stage variables.
+ */
+int logic_get_stage_count(void)
+{
+	return slot[front_slot].count;
+}
+
+/*
+ * Get a stage variable name.
+ */
+const char *logic_get_stage_name(int index)
+{
+	assert(index >= 0 && index < slot[front_slot].count);
+
+	return slot[front_slot].data + slot[front_slot].name_ofs[index];
+}
+
+/*
+ * Get a stage variable value.
+ */
+const char *logic_get_stage_value(int index)
+{
+	const char *name;
+
+	name = logic_get_stage_name(index);
+
+	return name + strlen(name) + 1;
+}
+
+/*
+ * Check if the scenario can run at the idle frame rate.
+ */
+bool logic_can_idle(uint64_t *deadline)
+{
+	*deadline = __atomic_load_n(&idle_deadline, __ATOMIC_RELAXED);
+
+	return __atomic_load_n(&can_idle, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -0,0 +1,68 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * logic.h: Logic thread. (USE_LOGIC_THREAD)
+ *  - The logic thread owns the runtime and runs the scenario. The main
+ *    thread only renders and talks to the logic thread through the
+ *    functions here.
+ *  - Committed stage states go to the main thread through a lock-free
+ *    triple buffer, and the main thread always reads the latest one.
+ *  - Input and the HAL status go to the logic thread through atomics.
+ */
+
+#ifndef NOVELKIT_LOGIC_H
+#define NOVELKIT_LOGIC_H
+
+#include "compat.h"
+
+#if defined(USE_LOGIC_THREAD)
+
+/*
+ * Start the logic thread. (main thread)
+ *  - step is called every logic tick on the logic thread.
+ *  - The runtime must not be used by the main thread after this.
+ */
+bool logic_start(bool (*step)(void));
+
+/* Check if the logic thread stopped by an error. (main thread) */
+bool logic_is_failed(void);
+
+/* Post a click. (main thread) */
+void logic_post_click(void);
+
+/* Publish the sound and movie status. (main thread) */
+void logic_publish_hal_status(void);
+
+/* Check if a sound track finished. (logic thread) */
+bool logic_is_sound_finished(int track);
+
+/* Check if the movie is playing. (logic thread) */
+bool logic_is_video_playing(void);
+
+/*
+ * Get the latest committed stage. (main thread)
+ *  - Returns true if it changed since the last call.
+ *  - The stage is valid until the next call.
+ */
+bool logic_update_stage(void);
+
+/* Get the number of stage variables. (main thread) */
+int logic_get_stage_count(void);
+
+/* Get a stage variable name. (main thread) */
+const char *logic_get_stage_name(int index);
+
+/* Get a stage variable value. (main thread) */
+const char *logic_get_stage_value(int index);
+
+/* Check if the scenario can run at the idle frame rate. (main thread) */
+bool logic_can_idle(uint64_t *deadline);
+
+#endif
+
+#endif
@@ -0,0 +1,222 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * lz.c: LZ4 block format codec.
+ *  - The compressor is a simple greedy one with a single hash table.
+ *    It keeps the hash table on the stack so that it is reentrant.
+ *  - The decompressor validates every length and offset because it
+ *    reads data from files.
+ */
+
+#include "lz.h"
+
+#include <string.h>
+
+/* Format constants. */
+#define MIN_MATCH	4
+#define LAST_LITERALS	5
+#define MF_LIMIT	12
+#define MAX_OFFSET	65535
+
+/* Hash table size. */
+#define HASH_BITS	14
+
+/* Forward declarations. */
+static uint32_t read32(const uint8_t *p);
+static uint32_t hash4(uint32_t v);
+static uint8_t *put_length(uint8_t *op, size_t len);
+
+/*
+ * Get the maximum compressed size for an input size.
+ */
+size_t lz_compress_bound(size_t src_size)
+{
+	return src_size + src_size / 255 + 16;
+}
+
+/*
+ * Compress a buffer into the LZ4 block format.
+ */
+size_t lz_compress(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+	uint32_t table[1 << HASH_BITS];
+	const uint8_t *in, *ip, *anchor, *end, *mflimit, *ref, *mstart;
+	uint8_t *op, *oend;
+	size_t lit_len, match_len, offset;
+	uint32_t seq, h;
+
+	/* We store positions in 32-bit. */
+	if (src_size > UINT32_MAX)
+		return 0;
+
+	in = src;
+	ip = in;
+	anchor = in;
+	end = in + src_size;
+	op = dst;
+	oend = op + dst_size;
+
+	memset(table, 0, sizeof(table));
+
+	if (src_size > MF_LIMIT) {
+		mflimit = end - MF_LIMIT;
+		while (ip < mflimit) {
+			/* Lookup a previous occurrence of the 4 bytes. */
+			seq = read32(ip);
+			h = hash4(seq);
+			ref = in + table[h];
+			table[h] = (uint32_t)(ip - in);
+			if (ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != seq) {
+				ip++;
+				continue;
+			}
+
+			/* Extend the match. */
+			mstart = ip;
+			offset = (size_t)(ip - ref);
+			ip += MIN_MATCH;
+			ref += MIN_MATCH;
+			while (ip < end - LAST_LITERALS && *ip == *ref) {
+				ip++;
+				ref++;
+			}
+			match_len = (size_t)(ip - mstart);
+			lit_len = (size_t)(mstart - anchor);
+
+			/* Check the output space. */
+			if ((size_t)(oend - op) < 1 + lit_len + lit_len / 255 + 1 + 2 + match_len / 255 + 1)
+				return 0;
+
+			/* Put a token and literals. */
+			*op++ = (uint8_t)(((lit_len >= 15 ? 15 : lit_len) << 4) |
+					  (match_len - MIN_MATCH >= 15 ? 15 : match_len - MIN_MATCH));
+			if (lit_len >= 15)
+				op = put_length(op, lit_len - 15);
+			memcpy(op, anchor, lit_len);
+			op += lit_len;
+
+			/* Put an offset and a match length. */
+			*op++ = (uint8_t)(offset & 0xff);
+			*op++ = (uint8_t)(offset >> 8);
+			if (match_len - MIN_MATCH >= 15)
+				op = put_length(op, match_len - MIN_MATCH - 15);
+
+			anchor = ip;
+		}
+	}
+
+	/* Put the last literals. */
+	lit_len = (size_t)(end - anchor);
+	if ((size_t)(oend - op) < 1 + lit_len + lit_len / 255 + 1)
+		return 0;
+	*op++ = (uint8_t)((lit_len >= 15 ? 15 : lit_len) << 4);
+	if (lit_len >= 15)
+		op = put_length(op, lit_len - 15);
+	memcpy(op, anchor, lit_len);
+	op += lit_len;
+
+	return (size_t)(op - (uint8_t *)dst);
+}
+
+/* Read a 32-bit value from an unaligned address. */
+static uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/* Hash 4 bytes. */
+static uint32_t hash4(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/* Put an extended length. */
+static uint8_t *put_length(uint8_t *op, size_t len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+/*
+ * Decompress an LZ4 block.
+ */
+bool lz_decompress(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+	const uint8_t *ip, *iend, *ref;
+	uint8_t *op, *ostart, *oend;
+	size_t lit_len, match_len, offset;
+	uint8_t token, b;
+
+	ip = src;
+	iend = ip + src_size;
+	ostart = dst;
+	op = ostart;
+	oend = op + dst_size;
+
+	for (;;) {
+		if (ip >= iend)
+			return false;
+		token = *ip++;
+
+		/* Copy literals. */
+		lit_len = (size_t)(token >> 4);
+		if (lit_len == 15) {
+			do {
+				if (ip >= iend)
+					return false;
+				b = *ip++;
+				lit_len += b;
+			} while (b == 255);
+		}
+		if (lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op))
+			return false;
+		memcpy(op, ip, lit_len);
+		op += lit_len;
+		ip += lit_len;
+
+		/* The last sequence has no match. */
+		if (ip == iend)
+			break;
+
+		/* Get an offset. */
+		if (iend - ip < 2)
+			return false;
+		offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - ostart))
+			return false;
+
+		/* Get a match length. */
+		match_len = (size_t)(token & 15);
+		if (match_len == 15) {
+			do {
+				if (ip >= iend)
+					return false;
+				b = *ip++;
+				match_len += b;
+			} while (b == 255);
+		}
+		match_len += MIN_MATCH;
+		if (match_len > (size_t)(oend - op))
+			return false;
+
+		/* Copy a match byte by byte since it may overlap. */
+		ref = op - offset;
+		while (match_len-- > 0)
+			*op++ = *ref++;
+	}
+
+	return op == oend;
+}
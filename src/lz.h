@@ -0,0 +1,34 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * lz.h: LZ4 block format codec.
+ *  - This module doesn't depend on Linguine or MediaKit so that tools
+ *    can share it.
+ */
+
+#ifndef NOVELKIT_LZ_H
+#define NOVELKIT_LZ_H
+
+#include "compat.h"
+
+/* Get the maximum compressed size for an input size. */
+size_t lz_compress_bound(size_t src_size);
+
+/*
+ * Compress a buffer into the LZ4 block format.
+ *  - Returns the compressed size, or 0 if dst is too small.
+ */
+size_t lz_compress(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+/*
+ * Decompress an LZ4 block.
+ *  - Returns false if the block is broken or doesn't fit dst_size exactly.
+ */
+bool lz_decompress(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+#endif
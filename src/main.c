@@ -8,13 +8,34 @@
 #include "novelkit.h"
 
 /* The runtime. */
-struct rt_env *rt;
+static struct rt_env *rt;
+
+#if defined(USE_STARTUP_TIMING)
+/* Time of the startup and the last startup phase. */
+static uint64_t start_usec;
+static uint64_t phase_usec;
+static bool is_first_frame;
+#endif
 
 /* Forward declaration. */
+#if !defined(USE_AOT)
 static bool load_novelkit_file(void);
 static bool load_main_file(void);
+static void log_script_cache(void);
+#endif
 static bool call_setup(char **title, int *width, int *height);
+static void start_prefetch(struct rt_value *setup);
+static bool run_logic(void);
+static bool run_scenario(void);
+static void handle_key(int key);
+static void handle_mouse(int button, int x, int y);
+static void post_click(void);
 static void print_error(struct rt_env *rt);
+static void log_phase(const char *name);
+static void log_prefetch(void);
+#if defined(USE_STATS_KEY)
+static void print_stats(void);
+#endif
 
 /*
  * App initialization
@@ -22,30 +43,66 @@ static void print_error(struct rt_env *rt);
  */
 bool on_hal_init_render(char **title, int *width, int *height)
 {
+	log_phase(NULL);
+
+	/* Open the package file if exists. */
+	if (!package_init())
+		return false;
+
+#if defined(USE_REPLAY)
+	/* Start recording or replaying if requested. (development builds only) */
+	if (!replay_init())
+		return false;
+#endif
+
+#if defined(USE_HOT_RELOAD)
+	/* Start the scenario file watcher. (development builds only) */
+	if (!hotreload_init())
+		return false;
+#endif
+
 	/* Create a language runtime. */
 	if (!rt_create(&rt))
 		return false;
+	log_phase("init");
 
 	/* Install the NovelKit API to the runtime. */
 	if (!install_api(rt))
 		return false;
 
+#if defined(USE_AOT)
+	/* Register the executive compiled into the binary. */
+	if (!aot_install(rt)) {
+		print_error(rt);
+		return false;
+	}
+	log_phase("aot");
+#else
 	/* Load the "novelkit.ls" file. */
 	if (!load_novelkit_file())
 		return false;
+	log_phase("game.ls");
 
 	/* Load the "main.ls" file. */
 	if (!load_main_file())
 		return false;
+	log_phase("main.ls");
+	log_script_cache();
+#endif
+
+	/* Let the functions of tag names take the native tags. */
+	tag_bind_scripts(rt);
 
 	/* Call "setup()" and get a title and window size. */
 	if (!call_setup(title, width, height))
 		return false;
+	log_phase("setup()");
 
 	/* Return a title, width, and height. */
 	return true;
 }
 
+#if !defined(USE_AOT)
 /* Load "novelkit.ls". */
 static bool load_novelkit_file(void)
 {
@@ -56,12 +113,12 @@ static bool load_novelkit_file(void)
 		return false;
 
 	/* Register the script text to the language runtime. */
-	if (!rt_register_source(rt, "game.ls", buf)) {
+	if (!scriptcache_register(rt, "game.ls", buf)) {
 		print_error(rt);
 		return false;
 	}
 
-	free(buf);
+	mem_free(buf);
 
 	return true;
 }
@@ -76,16 +133,32 @@ static bool load_main_file(void)
 		return false;
 
 	/* Register the script text to the language runtime. */
-	if (!rt_register_source(rt, "main.ls", buf)) {
+	if (!scriptcache_register(rt, "main.ls", buf)) {
 		print_error(rt);
 		return false;
 	}
 
-	free(buf);
+	mem_free(buf);
 
 	return true;
 }
 
+/* Log the script loads. */
+static void log_script_cache(void)
+{
+#if defined(USE_STARTUP_TIMING)
+	struct scriptcache_stats stats;
+
+	scriptcache_get_stats(&stats);
+	printf("startup: scripts %d cached %.3f ms, %d compiled %.3f ms\n",
+	       stats.hits,
+	       (double)stats.load_usec / 1000.0,
+	       stats.misses,
+	       (double)stats.compile_usec / 1000.0);
+#endif
+}
+#endif
+
 /* Call "setup()" function to determin a title, width, and height. */
 static bool call_setup(char **title, int *width, int *height)
 {
@@ -114,9 +187,29 @@ static bool call_setup(char **title, int *width, int *height)
 	if (!rt_get_int(rt, &height_val, height))
 		return false;
 
+	/* Read the first scenario and files while the window is created. */
+	start_prefetch(&ret);
+
 	return true;
 }
 
+/* Start the prefetch of "scenario" and "preload" returned by setup(). */
+static void start_prefetch(struct rt_value *setup)
+{
+	struct rt_value val;
+	const char *scenario, *preload;
+
+	scenario = NULL;
+	if (rt_get_dict_elem(rt, setup, "scenario", &val) && val.type == RT_VALUE_STRING)
+		scenario = val.val.str->s;
+
+	preload = NULL;
+	if (rt_get_dict_elem(rt, setup, "preload", &val) && val.type == RT_VALUE_STRING)
+		preload = val.val.str->s;
+
+	startup_begin(scenario, preload);
+}
+
 /*
  * Rendering initialization.
  *  - This function is called right before the game loop.
@@ -125,11 +218,24 @@ bool on_hal_ready(void)
 {
 	struct rt_value ret;
 
+	/* The HAL created the window. Wait for the prefetch. */
+	log_phase("window");
+	startup_end();
+	log_phase("prefetch");
+	log_prefetch();
+
 	/* Call the "first()" function to setup a game system. */
 	if (!rt_call_with_name(rt, "first", NULL, 0, NULL, &ret)) {
 		print_error(rt);
 		return false;
 	}
+	log_phase("first()");
+
+#if defined(USE_LOGIC_THREAD)
+	/* Hand over the runtime to the logic thread. */
+	if (!logic_start(run_logic))
+		return false;
+#endif
 
 	return true;
 }
@@ -140,8 +246,63 @@ bool on_hal_ready(void)
  */
 bool on_hal_frame(void)
 {
-	/* Run a tag. */
-	if (!scenario_run_tag(rt)) {
+	struct replay_input input;
+	uint64_t deadline;
+
+	/* Feed the recorded input, then start a frame on the game clock. */
+	while (replay_get_input(&input)) {
+		if (input.type == REPLAY_KEY)
+			handle_key(input.key);
+		else
+			handle_mouse(input.button, input.x, input.y);
+	}
+	if (!replay_begin_frame())
+		return false;
+
+#if defined(USE_LOGIC_THREAD)
+	/* Pass the HAL status and take the latest committed stage. */
+	logic_publish_hal_status();
+	if (logic_is_failed())
+		return false;
+	logic_update_stage();
+
+	/* Slow down while the scenario waits for an event. */
+	idle_end_frame(logic_can_idle(&deadline), deadline);
+#else
+	/* Run the scenario on this thread. */
+	if (!run_logic())
+		return false;
+
+	/* Slow down while the scenario waits for an event. */
+	idle_end_frame(scenario_can_idle(&deadline), deadline);
+#endif
+
+#if defined(USE_STARTUP_TIMING)
+	/* Time to the first frame. */
+	if (!is_first_frame) {
+		log_phase("frame");
+		is_first_frame = true;
+	}
+#endif
+
+	return true;
+}
+
+/*
+ * Run the scenario for a frame.
+ *  - Called on the thread that owns the runtime.
+ */
+static bool run_logic(void)
+{
+	uint64_t start_usec, deadline;
+
+	start_usec = common_get_usec();
+
+	if (!run_scenario())
+		return false;
+
+	/* Collect garbage if the frame has time left. A full collection waits for idle frames. */
+	if (!gc_end_frame(rt, start_usec, scenario_can_idle(&deadline) && !idle_is_active())) {
 		print_error(rt);
 		return false;
 	}
@@ -149,10 +310,95 @@ bool on_hal_frame(void)
 	return true;
 }
 
+/* Run tags and wait handlers. */
+static bool run_scenario(void)
+{
+	struct rt_value ret;
+	const char *resume;
+
+#if defined(USE_HOT_RELOAD)
+	/* Reload the scenario if it was edited. Errors are not fatal here. */
+	if (!scenario_reload_if_modified(rt))
+		sys_error("%s\n", api_get_error_message());
+#endif
+
+	/* Check the wait natively without entering the executive. */
+	if (wait_update(&resume))
+		return true;
+
+	/* Resume the handler that set the finished wait. */
+	if (resume != NULL) {
+		idle_notify_activity();
+		gc_notify_tag();
+		if (!rt_call_with_name(rt, resume, NULL, 0, NULL, &ret)) {
+			print_error(rt);
+			return false;
+		}
+	}
+
+	/* Run tags until a tag sets a wait. The scenario prints its errors. */
+	if (!scenario_run(rt))
+		return false;
+
+	return true;
+}
+
+/*
+ * Key press handler.
+ */
+void on_hal_key_press(int key)
+{
+	/* End an idle frame wait of a HAL that delivers input on another thread. */
+	idle_wake();
+
+	/* Record, or ignore while replaying. */
+	if (replay_filter_key(key))
+		handle_key(key);
+}
+
+/*
+ * Mouse press handler.
+ */
+void on_hal_mouse_press(int button, int x, int y)
+{
+	idle_wake();
+
+	if (replay_filter_mouse(button, x, y))
+		handle_mouse(button, x, y);
+}
+
 /*
  * Helpers
  */
 
+/* Handle a key press. */
+static void handle_key(int key)
+{
+	idle_notify_activity();
+
+#if defined(USE_STATS_KEY)
+	/* Debug key: print the memory statistics. (development builds only) */
+	if (key == HAL_KEY_F12)
+		print_stats();
+#endif
+
+	/* Keys to proceed. */
+	if (key == HAL_KEY_RETURN || key == HAL_KEY_SPACE)
+		post_click();
+}
+
+/* Handle a mouse press. */
+static void handle_mouse(int button, int x, int y)
+{
+	UNUSED_PARAMETER(x);
+	UNUSED_PARAMETER(y);
+
+	idle_notify_activity();
+
+	if (button == HAL_MOUSE_LEFT)
+		post_click();
+}
+
 /* Print an error message. */
 static void print_error(struct rt_env *rt)
 {
@@ -161,3 +407,109 @@ static void print_error(struct rt_env *rt)
 		  rt_get_error_line(rt),
 		  rt_get_error_message(rt));
 }
+
+/* Pass a click to the thread that runs the scenario. */
+static void post_click(void)
+{
+#if defined(USE_LOGIC_THREAD)
+	logic_post_click();
+#else
+	wait_notify_click();
+#endif
+}
+
+/* Log the time of a startup phase and the total. (NULL to start) */
+static void log_phase(const char *name)
+{
+#if defined(USE_STARTUP_TIMING)
+	uint64_t now;
+
+	now = common_get_usec();
+	if (name != NULL) {
+		printf("startup: %-10s %8.3f ms %9.3f ms\n", name,
+		       (double)(now - phase_usec) / 1000.0,
+		       (double)(now - start_usec) / 1000.0);
+	} else {
+		start_usec = now;
+	}
+	phase_usec = now;
+#else
+	UNUSED_PARAMETER(name);
+#endif
+}
+
+/* Log the work of the prefetch workers. */
+static void log_prefetch(void)
+{
+#if defined(USE_STARTUP_TIMING) && defined(USE_STARTUP_PREFETCH)
+	struct startup_stats stats;
+
+	startup_get_stats(&stats);
+	printf("startup: parse %s %.3f ms, preload %d files %llu bytes %.3f ms, wait %.3f ms\n",
+	       stats.is_parsed ? "done" : "none",
+	       (double)stats.parse_usec / 1000.0,
+	       stats.preload_files,
+	       (unsigned long long)stats.preload_bytes,
+	       (double)stats.preload_usec / 1000.0,
+	       (double)stats.wait_usec / 1000.0);
+#endif
+}
+
+#if defined(USE_STATS_KEY)
+/* Print the memory statistics. */
+static void print_stats(void)
+{
+	struct mem_stats stats;
+	struct idle_stats frame;
+	struct imgcache_stats image;
+	struct gc_stats gc;
+	struct scenario_stats dispatch;
+	int i;
+
+	printf("%-10s %12s %12s %10s\n", "memory", "current", "peak", "count");
+	for (i = 0; i <= MEM_KIND_COUNT; i++) {
+		if (i < MEM_KIND_COUNT)
+			mem_get_stats(i, &stats);
+		else
+			mem_get_other_heap_stats(&stats);
+		printf("%-10s %12zu %12zu %10llu\n",
+		       i < MEM_KIND_COUNT ? mem_get_kind_name(i) : "other heap",
+		       stats.current,
+		       stats.peak,
+		       (unsigned long long)stats.count);
+	}
+
+	idle_get_stats(&frame);
+	printf("frames %llu, idle %llu, sleep %.1f s, cpu %.1f s, idle %.1f s at %.1f ms cpu/min\n",
+	       (unsigned long long)frame.frames,
+	       (unsigned long long)frame.idle_frames,
+	       (double)frame.sleep_usec / 1000000.0,
+	       (double)frame.cpu_usec / 1000000.0,
+	       (double)frame.idle_usec / 1000000.0,
+	       (double)frame.idle_cpu_per_minute_usec / 1000.0);
+
+	imgcache_get_stats(&image);
+	printf("images %d, hits %llu, misses %llu, evictions %llu, load %.1f ms, %zu / %zu bytes\n",
+	       image.count,
+	       (unsigned long long)image.hits,
+	       (unsigned long long)image.misses,
+	       (unsigned long long)image.evictions,
+	       (double)image.load_usec / 1000.0,
+	       image.bytes,
+	       image.budget);
+
+	gc_get_stats(&gc);
+	printf("gc %llu shallow, %llu deep, %llu forced, %llu deferred, pause %.1f ms, max %.3f ms\n",
+	       (unsigned long long)gc.shallow_count,
+	       (unsigned long long)gc.deep_count,
+	       (unsigned long long)gc.forced_count,
+	       (unsigned long long)gc.deferred_count,
+	       (double)gc.pause_usec / 1000.0,
+	       (double)gc.max_pause_usec / 1000.0);
+
+	scenario_get_stats(&dispatch);
+	printf("tags %llu native, %llu script\n",
+	       (unsigned long long)dispatch.native_count,
+	       (unsigned long long)dispatch.script_count);
+}
+#endif
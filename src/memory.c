@@ -0,0 +1,281 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * memory.c: Memory allocation with per-subsystem accounting.
+ *  - With USE_STATS_KEY, each block has a small header that remembers
+ *    its size and kind, and the counters are updated with relaxed
+ *    atomics since loader threads allocate too. It costs a few
+ *    instructions per call.
+ *  - Without it, the functions go straight to malloc() and the
+ *    subsystem counters stay zero.
+ */
+
+#include "novelkit.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if defined(USE_STATS_KEY)
+/* Block header. (keeps 16-byte alignment of the payload) */
+struct mem_header {
+	size_t size;
+	size_t kind;
+};
+#define HEADER_SIZE	((sizeof(struct mem_header) + 15) & ~(size_t)15)
+#endif
+
+#if defined(USE_STATS_KEY)
+/* Counters. */
+static size_t cur_size[MEM_KIND_COUNT];
+static size_t peak_size[MEM_KIND_COUNT];
+static uint64_t alloc_count[MEM_KIND_COUNT];
+#endif
+
+/* Peak of the other heap seen by mem_get_other_heap_stats(). */
+static size_t runtime_peak;
+
+/* Subsystem names. */
+static const char *kind_name[MEM_KIND_COUNT] = {
+	"scenario",
+	"parser",
+	"file",
+	"asset",
+	"rollback",
+};
+
+/* Forward declarations. */
+#if defined(USE_STATS_KEY)
+static void add_size(int kind, size_t size);
+#endif
+
+/*
+ * Allocate memory for a subsystem.
+ */
+void *mem_alloc(int kind, size_t size)
+{
+#if defined(USE_STATS_KEY)
+	struct mem_header *h;
+
+	assert(kind >= 0 && kind < MEM_KIND_COUNT);
+
+	h = malloc(HEADER_SIZE + size);
+	if (h == NULL)
+		return NULL;
+	h->size = size;
+	h->kind = (size_t)kind;
+
+	add_size(kind, size);
+	ATOMIC_ADD(&alloc_count[kind], 1);
+
+	return (char *)h + HEADER_SIZE;
+#else
+	assert(kind >= 0 && kind < MEM_KIND_COUNT);
+	UNUSED_PARAMETER(kind);
+
+	return malloc(size);
+#endif
+}
+
+/*
+ * Allocate zero-filled memory for a subsystem.
+ */
+void *mem_calloc(int kind, size_t count, size_t size)
+{
+	void *p;
+
+	if (size != 0 && count > SIZE_MAX / size)
+		return NULL;
+
+	p = mem_alloc(kind, count * size);
+	if (p == NULL)
+		return NULL;
+	memset(p, 0, count * size);
+
+	return p;
+}
+
+/*
+ * Resize memory.
+ */
+void *mem_realloc(int kind, void *ptr, size_t size)
+{
+#if defined(USE_STATS_KEY)
+	struct mem_header *h, *new_h;
+	size_t old_size;
+
+	if (ptr == NULL)
+		return mem_alloc(kind, size);
+
+	h = (struct mem_header *)((char *)ptr - HEADER_SIZE);
+	assert((int)h->kind == kind);
+	old_size = h->size;
+
+	new_h = realloc(h, HEADER_SIZE + size);
+	if (new_h == NULL)
+		return NULL;
+	new_h->size = size;
+
+	ATOMIC_SUB(&cur_size[kind], old_size);
+	add_size(kind, size);
+
+	return (char *)new_h + HEADER_SIZE;
+#else
+	assert(kind >= 0 && kind < MEM_KIND_COUNT);
+	UNUSED_PARAMETER(kind);
+
+	return realloc(ptr, size);
+#endif
+}
+
+/*
+ * Duplicate a string for a subsystem.
+ */
+char *mem_strdup(int kind, const char *s)
+{
+	size_t len;
+	char *p;
+
+	len = strlen(s);
+	p = mem_alloc(kind, len + 1);
+	if (p == NULL)
+		return NULL;
+	memcpy(p, s, len + 1);
+
+	return p;
+}
+
+/*
+ * Free memory.
+ */
+void mem_free(void *ptr)
+{
+#if defined(USE_STATS_KEY)
+	struct mem_header *h;
+
+	if (ptr == NULL)
+		return;
+
+	h = (struct mem_header *)((char *)ptr - HEADER_SIZE);
+	ATOMIC_SUB(&cur_size[h->kind], h->size);
+	free(h);
+#else
+	free(ptr);
+#endif
+}
+
+/*
+ * Account memory allocated outside.
+ */
+void mem_account(int kind, size_t size)
+{
+	assert(kind >= 0 && kind < MEM_KIND_COUNT);
+
+#if defined(USE_STATS_KEY)
+	add_size(kind, size);
+	ATOMIC_ADD(&alloc_count[kind], 1);
+#else
+	UNUSED_PARAMETER(kind);
+	UNUSED_PARAMETER(size);
+#endif
+}
+
+/*
+ * Unaccount memory allocated outside.
+ */
+void mem_unaccount(int kind, size_t size)
+{
+	assert(kind >= 0 && kind < MEM_KIND_COUNT);
+
+#if defined(USE_STATS_KEY)
+	ATOMIC_SUB(&cur_size[kind], size);
+#else
+	UNUSED_PARAMETER(kind);
+	UNUSED_PARAMETER(size);
+#endif
+}
+
+#if defined(USE_STATS_KEY)
+/* Add to the current size and update the peak. */
+static void add_size(int kind, size_t size)
+{
+	ATOMIC_MAX(&peak_size[kind], ATOMIC_ADD(&cur_size[kind], size));
+}
+#endif
+
+/*
+ * Get the statistics of a subsystem.
+ */
+void mem_get_stats(int kind, struct mem_stats *stats)
+{
+	assert(kind >= 0 && kind < MEM_KIND_COUNT);
+
+#if defined(USE_STATS_KEY)
+	stats->current = ATOMIC_LOAD(&cur_size[kind]);
+	stats->peak = ATOMIC_LOAD(&peak_size[kind]);
+	stats->count = ATOMIC_LOAD(&alloc_count[kind]);
+#else
+	UNUSED_PARAMETER(kind);
+	stats->current = 0;
+	stats->peak = 0;
+	stats->count = 0;
+#endif
+}
+
+/*
+ * Get the name of a subsystem.
+ */
+const char *mem_get_kind_name(int kind)
+{
+	assert(kind >= 0 && kind < MEM_KIND_COUNT);
+
+	return kind_name[kind];
+}
+
+/*
+ * Get the statistics of the heap outside the subsystems.
+ *  - The heap is the malloc arena and the mmapped chunks of glibc minus
+ *    the tracked subsystems that use malloc. (Assets are HAL images.)
+ *    Without USE_STATS_KEY, nothing is tracked and the subsystems count.
+ *  - Other C libraries return zero, that disables the GC limit.
+ */
+void mem_get_other_heap_stats(struct mem_stats *stats)
+{
+	size_t heap, tracked;
+#if defined(USE_STATS_KEY)
+	int i;
+#endif
+
+	stats->current = 0;
+	stats->peak = 0;
+	stats->count = 0;
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	{
+		struct mallinfo2 mi = mallinfo2();
+		heap = mi.uordblks + mi.hblkhd;
+	}
+#else
+	heap = 0;
+#endif
+	if (heap == 0)
+		return;
+
+	tracked = 0;
+#if defined(USE_STATS_KEY)
+	for (i = 0; i < MEM_KIND_COUNT; i++) {
+		if (i == MEM_ASSET)
+			continue;
+		tracked += ATOMIC_LOAD(&cur_size[i]);
+	}
+#endif
+
+	stats->current = heap > tracked ? heap - tracked : 0;
+	ATOMIC_MAX(&runtime_peak, stats->current);
+	stats->peak = ATOMIC_LOAD(&runtime_peak);
+}
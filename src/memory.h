@@ -0,0 +1,70 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * memory.h: Memory allocation with per-subsystem accounting.
+ *  - The accounting is built with USE_STATS_KEY. Without it, the
+ *    statistics of the subsystems are zero.
+ */
+
+#ifndef NOVELKIT_MEMORY_H
+#define NOVELKIT_MEMORY_H
+
+#include "compat.h"
+
+/* Subsystems. */
+enum mem_kind {
+	MEM_SCENARIO,	/* Scenario command store */
+	MEM_PARSER,	/* Parser scratch space */
+	MEM_FILE,	/* File buffers */
+	MEM_ASSET,	/* Asset caches */
+	MEM_ROLLBACK,	/* Rollback log */
+	MEM_KIND_COUNT
+};
+
+/* Statistics of a subsystem. */
+struct mem_stats {
+	size_t current;
+	size_t peak;
+	uint64_t count;
+};
+
+/* Allocate memory for a subsystem. */
+void *mem_alloc(int kind, size_t size);
+
+/* Allocate zero-filled memory for a subsystem. */
+void *mem_calloc(int kind, size_t count, size_t size);
+
+/* Resize memory. (ptr can be NULL) */
+void *mem_realloc(int kind, void *ptr, size_t size);
+
+/* Duplicate a string for a subsystem. */
+char *mem_strdup(int kind, const char *s);
+
+/* Free memory. (ptr can be NULL) */
+void mem_free(void *ptr);
+
+/* Account memory allocated outside. (e.g., HAL images) */
+void mem_account(int kind, size_t size);
+
+/* Unaccount memory allocated outside. */
+void mem_unaccount(int kind, size_t size);
+
+/* Get the statistics of a subsystem. */
+void mem_get_stats(int kind, struct mem_stats *stats);
+
+/* Get the name of a subsystem. */
+const char *mem_get_kind_name(int kind);
+
+/*
+ * Get the statistics of the heap outside the subsystems.
+ *  - This is mostly the Linguine runtime, but libraries and the HAL
+ *    count too. It is zero where the process heap size is unavailable.
+ */
+void mem_get_other_heap_stats(struct mem_stats *stats);
+
+#endif
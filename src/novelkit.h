@@ -22,9 +22,28 @@
 #include "mediakit/mediakit.h"
 
 /* Internals */
+#include "aot.h"
 #include "api.h"
 #include "common.h"
+#include "gc.h"
+#include "hotreload.h"
+#include "idle.h"
+#include "imgcache.h"
+#include "interp.h"
+#include "logic.h"
+#include "memory.h"
+#include "package.h"
+#include "replay.h"
+#include "rollback.h"
+#include "savefile.h"
 #include "scenario.h"
+#include "scriptcache.h"
+#include "startup.h"
+#include "strtab.h"
+#include "tag.h"
+#include "textstore.h"
+#include "variable.h"
+#include "wait.h"
 
 /* Standard C */
 #include <stdio.h>
@@ -32,7 +51,17 @@
 #include <string.h>
 #include <assert.h>
 
-/* Linguine runtime. */
-extern struct rt_env *rt;
+/*
+ * Threads.
+ *  - The Linguine runtime is private to main.c and is passed to the
+ *    modules that need it.
+ *  - The runtime and the modules that the executive calls (scenario,
+ *    variable, rollback, wait, strtab, interp) are owned by one thread
+ *    and are not thread-safe.
+ *  - The owner is the main thread, or the logic thread from
+ *    on_hal_ready() on with USE_LOGIC_THREAD. Then the main thread
+ *    must use logic.h only, and must not touch the runtime.
+ *  - The memory statistics and idle.h are safe to use from both.
+ */
 
 #endif
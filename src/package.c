@@ -0,0 +1,313 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * package.c: Packed asset archive.
+ *  - The whole archive is memory-mapped where the platform allows it,
+ *    so that uncompressed entries can be used without copies.
+ *  - On other platforms, the archive is read into memory at once.
+ */
+
+#include "novelkit.h"
+#include "lz.h"
+
+#if defined(TARGET_LINUX) || defined(TARGET_MACOS) || defined(TARGET_IOS)
+#define USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* Archive image. */
+static const char *pkg_base;
+static size_t pkg_size;
+static bool pkg_mapped;
+
+/* Directory. */
+static const struct package_entry *pkg_dir;
+static uint32_t pkg_count;
+static const char *pkg_names;
+static size_t pkg_names_size;
+
+/* Forward declarations. */
+#if defined(USE_MMAP)
+static bool map_package(bool *exists);
+#endif
+static bool read_package(bool *exists);
+static bool validate_package(void);
+static const char *get_entry_name(const struct package_entry *e);
+
+/*
+ * Open the package file if it exists.
+ */
+bool package_init(void)
+{
+	bool exists;
+
+	package_cleanup();
+
+#if defined(USE_MMAP)
+	if (!map_package(&exists))
+		return false;
+#else
+	if (!read_package(&exists))
+		return false;
+#endif
+
+	/* It's not an error to run with loose files. */
+	if (!exists)
+		return true;
+
+	if (!validate_package()) {
+		sys_error("Broken package file \"%s\".", PACKAGE_FILE_NAME);
+		package_cleanup();
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Close the package file.
+ */
+void package_cleanup(void)
+{
+	if (pkg_base != NULL) {
+#if defined(USE_MMAP)
+		if (pkg_mapped)
+			munmap((void *)pkg_base, pkg_size);
+		else
+			mem_free((void *)pkg_base);
+#else
+		mem_free((void *)pkg_base);
+#endif
+	}
+
+	pkg_base = NULL;
+	pkg_size = 0;
+	pkg_mapped = false;
+	pkg_dir = NULL;
+	pkg_count = 0;
+	pkg_names = NULL;
+	pkg_names_size = 0;
+}
+
+#if defined(USE_MMAP)
+/* Map the package file. */
+static bool map_package(bool *exists)
+{
+	struct stat st;
+	void *p;
+	int fd;
+
+	*exists = false;
+
+	fd = open(PACKAGE_FILE_NAME, O_RDONLY);
+	if (fd == -1)
+		return true;
+
+	if (fstat(fd, &st) == -1 || st.st_size <= 0) {
+		close(fd);
+		return true;
+	}
+
+	p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		/* Fallback to reading. (e.g., on a filesystem without mmap) */
+		return read_package(exists);
+	}
+
+	pkg_base = p;
+	pkg_size = (size_t)st.st_size;
+	pkg_mapped = true;
+	*exists = true;
+
+	return true;
+}
+#endif
+
+/* Read the whole package file into memory. */
+static bool read_package(bool *exists)
+{
+	struct file *f;
+	size_t file_size, read_size;
+	char *buf;
+
+	*exists = false;
+
+	if (!file_open(PACKAGE_FILE_NAME, &f))
+		return true;
+
+	if (!file_get_size(f, &file_size)) {
+		file_close(f);
+		return false;
+	}
+
+	buf = mem_alloc(MEM_FILE, file_size);
+	if (buf == NULL) {
+		sys_out_of_memory();
+		file_close(f);
+		return false;
+	}
+
+	if (!file_read(f, buf, file_size, &read_size) || read_size != file_size) {
+		sys_error("Could not read file \"%s\".", PACKAGE_FILE_NAME);
+		mem_free(buf);
+		file_close(f);
+		return false;
+	}
+
+	file_close(f);
+
+	pkg_base = buf;
+	pkg_size = file_size;
+	pkg_mapped = false;
+	*exists = true;
+
+	return true;
+}
+
+/* Check the header and the directory not to read out of the image. */
+static bool validate_package(void)
+{
+	const struct package_header *h;
+	const struct package_entry *e;
+	uint64_t dir_offset, name_offset, offset, stored_size;
+	uint32_t i;
+
+	if (pkg_size < sizeof(struct package_header))
+		return false;
+
+	h = (const struct package_header *)pkg_base;
+	if (memcmp(h->magic, PACKAGE_MAGIC, 4) != 0)
+		return false;
+	if (LETOHOST32(h->version) != PACKAGE_VERSION)
+		return false;
+
+	pkg_count = LETOHOST32(h->entry_count);
+	dir_offset = LETOHOST64(h->dir_offset);
+	name_offset = LETOHOST64(h->name_offset);
+
+	/* Check the directory and the name block. */
+	if (dir_offset % 8 != 0 ||
+	    dir_offset > pkg_size ||
+	    (pkg_size - dir_offset) / sizeof(struct package_entry) < pkg_count ||
+	    name_offset < dir_offset + (uint64_t)pkg_count * sizeof(struct package_entry) ||
+	    name_offset > pkg_size)
+		return false;
+	pkg_dir = (const struct package_entry *)(pkg_base + dir_offset);
+	pkg_names = pkg_base + name_offset;
+	pkg_names_size = pkg_size - (size_t)name_offset;
+
+	/* Check each entry. */
+	for (i = 0; i < pkg_count; i++) {
+		e = &pkg_dir[i];
+		offset = LETOHOST64(e->offset);
+		stored_size = LETOHOST64(e->stored_size);
+		if (get_entry_name(e) == NULL)
+			return false;
+		if (offset > pkg_size || stored_size >= pkg_size - offset)
+			return false;
+		if (!(LETOHOST32(e->flags) & PACKAGE_FLAG_LZ) &&
+		    (stored_size != LETOHOST64(e->size) || pkg_base[offset + stored_size] != '\0'))
+			return false;
+	}
+
+	return true;
+}
+
+/* Get an entry name, or NULL if it is out of the name block. */
+static const char *get_entry_name(const struct package_entry *e)
+{
+	uint32_t ofs;
+
+	ofs = LETOHOST32(e->name_offset);
+	if (ofs >= pkg_names_size)
+		return NULL;
+	if (memchr(pkg_names + ofs, '\0', pkg_names_size - ofs) == NULL)
+		return NULL;
+
+	return pkg_names + ofs;
+}
+
+/*
+ * Find an entry. Returns NULL if the file is not packed.
+ */
+const struct package_entry *package_find(const char *file)
+{
+	uint32_t lo, hi, mid;
+	int cmp;
+
+	assert(file != NULL);
+
+	if (pkg_base == NULL)
+		return NULL;
+
+	/* Binary search on the sorted directory. */
+	lo = 0;
+	hi = pkg_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cmp = strcmp(file, get_entry_name(&pkg_dir[mid]));
+		if (cmp == 0)
+			return &pkg_dir[mid];
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+/*
+ * Get the stored bytes of an entry without copying.
+ *  - For an uncompressed entry, this is the NUL-terminated content.
+ */
+const char *package_get_data(const struct package_entry *e)
+{
+	assert(e != NULL);
+	assert(pkg_base != NULL);
+
+	return pkg_base + LETOHOST64(e->offset);
+}
+
+/*
+ * Extract an entry to a NUL-terminated heap buffer.
+ */
+bool package_extract(const struct package_entry *e, char **buf)
+{
+	size_t size, stored_size;
+
+	assert(e != NULL);
+	assert(buf != NULL);
+
+	size = (size_t)LETOHOST64(e->size);
+	stored_size = (size_t)LETOHOST64(e->stored_size);
+
+	*buf = mem_alloc(MEM_FILE, size + 1);
+	if (*buf == NULL) {
+		sys_out_of_memory();
+		return false;
+	}
+
+	if (LETOHOST32(e->flags) & PACKAGE_FLAG_LZ) {
+		if (!lz_decompress(package_get_data(e), stored_size, *buf, size)) {
+			sys_error("Broken package entry \"%s\".", get_entry_name(e));
+			mem_free(*buf);
+			*buf = NULL;
+			return false;
+		}
+	} else {
+		memcpy(*buf, package_get_data(e), size);
+	}
+	(*buf)[size] = '\0';
+
+	return true;
+}
@@ -0,0 +1,75 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * package.h: Packed asset archive.
+ *
+ * Layout (all integers are little endian):
+ *
+ * +----------------------------+ 0
+ * |struct package_header       |
+ * +----------------------------+ dir_offset
+ * |struct package_entry[count] | (sorted by name, byte order)
+ * +----------------------------+ name_offset
+ * |NUL-terminated names        |
+ * +----------------------------+
+ * |Entry data                  | (each aligned to "align" bytes and
+ * |                            |  followed by a NUL byte)
+ * +----------------------------+
+ */
+
+#ifndef NOVELKIT_PACKAGE_H
+#define NOVELKIT_PACKAGE_H
+
+#include "compat.h"
+
+/* Package file name. */
+#define PACKAGE_FILE_NAME	"data.pak"
+
+/* Header values. */
+#define PACKAGE_MAGIC		"NKPK"
+#define PACKAGE_VERSION		1
+#define PACKAGE_DEFAULT_ALIGN	16
+
+/* Entry flags. */
+#define PACKAGE_FLAG_LZ		0x1
+
+/* File header. (32 bytes) */
+struct package_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t align;
+	uint64_t dir_offset;
+	uint64_t name_offset;
+};
+
+/* Directory entry. (32 bytes) */
+struct package_entry {
+	uint64_t offset;
+	uint64_t size;
+	uint64_t stored_size;
+	uint32_t name_offset;
+	uint32_t flags;
+};
+
+/* Open the package file if it exists. */
+bool package_init(void);
+
+/* Close the package file. */
+void package_cleanup(void);
+
+/* Find an entry. Returns NULL if the file is not packed. */
+const struct package_entry *package_find(const char *file);
+
+/* Get the stored bytes of an entry without copying. */
+const char *package_get_data(const struct package_entry *e);
+
+/* Extract an entry to a NUL-terminated heap buffer. (freed by mem_free()) */
+bool package_extract(const struct package_entry *e, char **buf);
+
+#endif
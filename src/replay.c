@@ -0,0 +1,415 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * replay.c: Input recording and replay.
+ *  - A log is a text file of the following lines in the order of
+ *    events. <frame> is the number of frames started when the event
+ *    happened, so input is tagged with the frame before the one that
+ *    handles it.
+ *      K <frame> <key> <index> <file>                 ... key press
+ *      P <frame> <button> <x> <y> <index> <file>      ... mouse press
+ *      F <frame> <usec>                               ... frame start
+ *      W <frame>                                      ... sound/movie wait end
+ *    <index> and <file> are the scenario position when the input
+ *    arrived, and are compared on a replay to find a divergence.
+ *  - The game clock is the time from the start of the session to the
+ *    start of the frame.
+ *  - A replay does not sleep in idle frames, so it runs as fast as the
+ *    frame loop allows.
+ */
+
+#include "novelkit.h"
+
+/* Log header. */
+#define LOG_HEADER	"NKREPLAY 1"
+
+/* Maximum length of a log line. */
+#define LINE_MAX_LEN	1024
+
+/* Session modes. */
+enum replay_mode {
+	MODE_OFF,
+	MODE_RECORD,
+	MODE_REPLAY,
+};
+
+/* Logged event. */
+struct event {
+	char type;
+	uint64_t frame;
+	uint64_t usec;
+	struct replay_input input;
+	int index;
+	char *file;
+};
+
+/* Session. */
+static int mode;
+static uint64_t frame;
+static uint64_t frame_usec;
+
+/* Recording. */
+static FILE *log_fp;
+static uint64_t base_usec;
+
+/* Replay. */
+static struct event *events;
+static size_t event_count;
+static size_t event_pos;
+static int wait_ends;
+static bool is_diverged;
+static uint64_t start_usec;
+
+/* Forward declarations. */
+#if defined(USE_REPLAY) && !defined(USE_LOGIC_THREAD)
+static bool start_record(const char *file);
+static bool load_log(const char *file);
+static bool parse_line(const char *line, struct event *e);
+static void free_events(void);
+#endif
+static void write_position(void);
+static void check_position(struct event *e);
+
+#if defined(USE_REPLAY)
+/*
+ * Start a session from the environment variables.
+ */
+bool replay_init(void)
+{
+	const char *record, *replay;
+
+	record = getenv("NOVELKIT_RECORD");
+	replay = getenv("NOVELKIT_REPLAY");
+	if (record == NULL && replay == NULL)
+		return true;
+
+#if defined(USE_LOGIC_THREAD)
+	sys_error("Replay is not available with the logic thread.\n");
+	return false;
+#else
+	if (record != NULL && replay != NULL) {
+		sys_error("NOVELKIT_RECORD and NOVELKIT_REPLAY are exclusive.\n");
+		return false;
+	}
+
+	if (record != NULL)
+		return start_record(record);
+
+	if (!load_log(replay))
+		return false;
+	mode = MODE_REPLAY;
+	start_usec = common_get_usec();
+
+	return true;
+#endif
+}
+#endif /* USE_REPLAY */
+
+#if defined(USE_REPLAY) && !defined(USE_LOGIC_THREAD)
+/* Open a log to record. */
+static bool start_record(const char *file)
+{
+	log_fp = fopen(file, "w");
+	if (log_fp == NULL) {
+		sys_error("Cannot open \"%s\".\n", file);
+		return false;
+	}
+	fprintf(log_fp, "%s\n", LOG_HEADER);
+
+	mode = MODE_RECORD;
+	base_usec = common_get_usec();
+
+	return true;
+}
+
+/* Load a log to replay. */
+static bool load_log(const char *file)
+{
+	struct event *new_events;
+	size_t alloc;
+	char line[LINE_MAX_LEN];
+	FILE *fp;
+	int lineno;
+
+	fp = fopen(file, "r");
+	if (fp == NULL) {
+		sys_error("Cannot open \"%s\".\n", file);
+		return false;
+	}
+
+	if (fgets(line, sizeof(line), fp) == NULL ||
+	    strncmp(line, LOG_HEADER, strlen(LOG_HEADER)) != 0) {
+		sys_error("\"%s\" is not a replay log.\n", file);
+		fclose(fp);
+		return false;
+	}
+
+	alloc = 0;
+	lineno = 1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		lineno++;
+		if (event_count == alloc) {
+			alloc = alloc == 0 ? 4096 : alloc * 2;
+			new_events = mem_realloc(MEM_FILE, events, alloc * sizeof(struct event));
+			if (new_events == NULL) {
+				sys_out_of_memory();
+				goto error;
+			}
+			events = new_events;
+		}
+		if (!parse_line(line, &events[event_count])) {
+			sys_error("%s:%d: Broken replay log.\n", file, lineno);
+			goto error;
+		}
+		event_count++;
+	}
+
+	fclose(fp);
+	return true;
+
+error:
+	fclose(fp);
+	free_events();
+	return false;
+}
+
+/* Parse a log line. */
+static bool parse_line(const char *line, struct event *e)
+{
+	unsigned long long f, u;
+	size_t len;
+	int pos;
+
+	memset(e, 0, sizeof(*e));
+	e->type = line[0];
+
+	pos = 0;
+	switch (e->type) {
+	case 'K':
+		e->input.type = REPLAY_KEY;
+		if (sscanf(line, "K %llu %d %d %n", &f, &e->input.key, &e->index, &pos) != 3 || pos == 0)
+			return false;
+		break;
+	case 'P':
+		e->input.type = REPLAY_MOUSE;
+		if (sscanf(line, "P %llu %d %d %d %d %n", &f, &e->input.button, &e->input.x, &e->input.y,
+			   &e->index, &pos) != 5 || pos == 0)
+			return false;
+		break;
+	case 'F':
+		if (sscanf(line, "F %llu %llu", &f, &u) != 2)
+			return false;
+		e->usec = u;
+		break;
+	case 'W':
+		if (sscanf(line, "W %llu", &f) != 1)
+			return false;
+		break;
+	default:
+		return false;
+	}
+	e->frame = f;
+
+	/* Copy the scenario file name of an input. */
+	if (e->type == 'K' || e->type == 'P') {
+		len = strcspn(line + pos, "\r\n");
+		e->file = mem_alloc(MEM_FILE, len + 1);
+		if (e->file == NULL)
+			return false;
+		memcpy(e->file, line + pos, len);
+		e->file[len] = '\0';
+	}
+
+	return true;
+}
+
+/* Free the replay events. */
+static void free_events(void)
+{
+	size_t i;
+
+	for (i = 0; i < event_count; i++)
+		mem_free(events[i].file);
+	mem_free(events);
+	events = NULL;
+	event_count = 0;
+	event_pos = 0;
+}
+#endif /* USE_REPLAY && !USE_LOGIC_THREAD */
+
+/*
+ * Get the game clock in microseconds.
+ */
+uint64_t replay_get_usec(void)
+{
+	if (mode == MODE_OFF)
+		return common_get_usec();
+
+	return frame_usec;
+}
+
+/*
+ * Check if idle frames may wait.
+ */
+bool replay_can_sleep(void)
+{
+	return mode != MODE_REPLAY;
+}
+
+/*
+ * Pass a key press.
+ */
+bool replay_filter_key(int key)
+{
+	if (mode == MODE_REPLAY)
+		return false;
+	if (mode == MODE_RECORD) {
+		fprintf(log_fp, "K %llu %d", (unsigned long long)frame, key);
+		write_position();
+	}
+
+	return true;
+}
+
+/*
+ * Pass a mouse press.
+ */
+bool replay_filter_mouse(int button, int x, int y)
+{
+	if (mode == MODE_REPLAY)
+		return false;
+	if (mode == MODE_RECORD) {
+		fprintf(log_fp, "P %llu %d %d %d", (unsigned long long)frame, button, x, y);
+		write_position();
+	}
+
+	return true;
+}
+
+/* End an input line with the scenario position. */
+static void write_position(void)
+{
+	const char *file;
+
+	file = scenario_get_file();
+	fprintf(log_fp, " %d %s\n", scenario_get_index(), file != NULL ? file : "-");
+}
+
+/*
+ * Get a recorded input that arrived before the next frame.
+ */
+bool replay_get_input(struct replay_input *input)
+{
+	struct event *e;
+
+	if (mode != MODE_REPLAY || event_pos == event_count)
+		return false;
+
+	e = &events[event_pos];
+	if ((e->type != 'K' && e->type != 'P') || e->frame != frame)
+		return false;
+	event_pos++;
+
+	check_position(e);
+	*input = e->input;
+
+	return true;
+}
+
+/* Report the first input that arrived at a different scenario position. */
+static void check_position(struct event *e)
+{
+	const char *file;
+
+	if (is_diverged)
+		return;
+
+	file = scenario_get_file();
+	if (file == NULL)
+		file = "-";
+	if (e->index == scenario_get_index() && strcmp(e->file, file) == 0)
+		return;
+
+	printf("replay: diverged at frame %llu: %s:%d, recorded %s:%d\n",
+	       (unsigned long long)frame, file, scenario_get_index(), e->file, e->index);
+	is_diverged = true;
+}
+
+/*
+ * Start a frame.
+ */
+bool replay_begin_frame(void)
+{
+	struct event *e;
+
+	switch (mode) {
+	case MODE_OFF:
+		return true;
+	case MODE_RECORD:
+		frame++;
+		frame_usec = common_get_usec() - base_usec;
+		fprintf(log_fp, "F %llu %llu\n", (unsigned long long)frame, (unsigned long long)frame_usec);
+
+		/* Keep the log up to a crash. */
+		fflush(log_fp);
+		return true;
+	default:
+		break;
+	}
+
+	/* Replay: the next event must be the frame start. */
+	frame++;
+	if (event_pos == event_count) {
+		printf("replay: finished %llu frames in %.3f s%s\n",
+		       (unsigned long long)(frame - 1),
+		       (double)(common_get_usec() - start_usec) / 1000000.0,
+		       is_diverged ? " (diverged)" : "");
+		return false;
+	}
+	e = &events[event_pos];
+	if (e->type != 'F' || e->frame != frame) {
+		sys_error("Replay log is out of order at frame %llu.\n", (unsigned long long)frame);
+		return false;
+	}
+	frame_usec = e->usec;
+	event_pos++;
+
+	/* Take the wait ends of this frame. */
+	wait_ends = 0;
+	while (event_pos < event_count && events[event_pos].type == 'W' && events[event_pos].frame == frame) {
+		wait_ends++;
+		event_pos++;
+	}
+
+	return true;
+}
+
+/*
+ * Pass whether a sound or movie wait ended.
+ */
+bool replay_filter_wait(bool done)
+{
+	switch (mode) {
+	case MODE_OFF:
+		return done;
+	case MODE_RECORD:
+		if (done)
+			fprintf(log_fp, "W %llu\n", (unsigned long long)frame);
+		return done;
+	default:
+		break;
+	}
+
+	/* Replay: the HAL status is ignored. */
+	if (wait_ends > 0) {
+		wait_ends--;
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,70 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * replay.h: Input recording and replay.
+ *  - Enabled by USE_REPLAY. NOVELKIT_RECORD=file records a session and
+ *    NOVELKIT_REPLAY=file replays it.
+ *  - While recording or replaying, the game clock is fixed in a frame
+ *    and the waits for sounds and movies end at the recorded frames,
+ *    so that a replay runs the same tags in the same frames.
+ *  - Without a session, the game clock is the monotonic clock.
+ */
+
+#ifndef NOVELKIT_REPLAY_H
+#define NOVELKIT_REPLAY_H
+
+#include "compat.h"
+
+/* Input types. */
+enum replay_input_type {
+	REPLAY_KEY,
+	REPLAY_MOUSE,
+};
+
+/* Recorded input. */
+struct replay_input {
+	int type;
+	int key;
+	int button;
+	int x;
+	int y;
+};
+
+#if defined(USE_REPLAY)
+/* Start a session from the environment variables. */
+bool replay_init(void);
+#endif
+
+/* Get the game clock in microseconds. */
+uint64_t replay_get_usec(void);
+
+/* Check if idle frames may wait. (false while replaying) */
+bool replay_can_sleep(void);
+
+/*
+ * Pass a key press.
+ *  - Returns false while replaying, so that real input is ignored.
+ */
+bool replay_filter_key(int key);
+
+/* Pass a mouse press. */
+bool replay_filter_mouse(int button, int x, int y);
+
+/* Get a recorded input that arrived before the next frame. */
+bool replay_get_input(struct replay_input *input);
+
+/*
+ * Start a frame.
+ *  - Returns false at the end of a replay.
+ */
+bool replay_begin_frame(void);
+
+/* Pass whether a sound or movie wait ended. */
+bool replay_filter_wait(bool done);
+
+#endif
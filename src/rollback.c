@@ -0,0 +1,374 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * rollback.c: Rollback log for rewinding.
+ *  - Each executed tag makes an entry with its position, and variable
+ *    changes made while the tag runs are recorded as old values.
+ *  - Entries and deltas are kept in bounded rings. Sequence numbers
+ *    grow forever and "seq % MAX" is the slot.
+ *  - Every SNAPSHOT_INTERVAL entries, all variables are copied. To
+ *    rewind to an entry, the first snapshot after it is restored and
+ *    then fewer than SNAPSHOT_INTERVAL entries are undone, so that the
+ *    cost doesn't grow with the rewind distance.
+ */
+
+#include "novelkit.h"
+
+/* Sizes. */
+#define ENTRY_MAX		1024
+#define DELTA_MAX		8192
+#define SNAPSHOT_INTERVAL	32
+#define SNAPSHOT_MAX		(ENTRY_MAX / SNAPSHOT_INTERVAL + 1)
+
+/* Invalid sequence number. */
+#define SEQ_NONE		UINT64_MAX
+
+/* Entry for an executed tag. */
+struct entry {
+	const char *file;
+	int index;
+	uint64_t delta_begin;
+};
+
+/* Old value of a variable. */
+struct delta {
+	int space;
+	int var;
+	char *old_value;
+};
+
+/* Copy of all variables before an entry. */
+struct snapshot {
+	uint64_t seq;
+	int count[VAR_SPACE_COUNT];
+	char **value[VAR_SPACE_COUNT];
+};
+
+/* Entry ring. */
+static struct entry entry[ENTRY_MAX];
+static uint64_t entry_head, entry_tail;
+
+/* Delta ring. */
+static struct delta delta[DELTA_MAX];
+static uint64_t delta_head, delta_tail;
+
+/* Snapshots. */
+static struct snapshot snapshot[SNAPSHOT_MAX];
+static bool snapshot_initialized;
+
+/* Interned file names. */
+static char **file_name;
+static int file_count;
+
+/* Forward declarations. */
+static const char *intern_file(const char *file);
+static void drop_oldest_entry(void);
+static void free_deltas(uint64_t from, uint64_t to);
+static bool take_snapshot(uint64_t seq);
+static void free_snapshot(struct snapshot *s);
+static bool restore_snapshot(const struct snapshot *s);
+static bool undo_entry(uint64_t seq);
+
+/*
+ * Start recording a tag.
+ */
+bool rollback_begin_tag(const char *file, int index)
+{
+	struct entry *e;
+	const char *f;
+	int i;
+
+	if (!snapshot_initialized) {
+		for (i = 0; i < SNAPSHOT_MAX; i++)
+			snapshot[i].seq = SEQ_NONE;
+		snapshot_initialized = true;
+	}
+
+	f = intern_file(file != NULL ? file : "");
+	if (f == NULL)
+		return false;
+
+	if (entry_head - entry_tail == ENTRY_MAX)
+		drop_oldest_entry();
+
+	if (entry_head % SNAPSHOT_INTERVAL == 0) {
+		if (!take_snapshot(entry_head))
+			return false;
+	}
+
+	e = &entry[entry_head % ENTRY_MAX];
+	e->file = f;
+	e->index = index;
+	e->delta_begin = delta_head;
+	entry_head++;
+
+	return true;
+}
+
+/* Intern a file name. */
+static const char *intern_file(const char *file)
+{
+	char **new_tbl;
+	int i;
+
+	for (i = file_count - 1; i >= 0; i--) {
+		if (strcmp(file_name[i], file) == 0)
+			return file_name[i];
+	}
+
+	new_tbl = mem_realloc(MEM_ROLLBACK, file_name, (size_t)(file_count + 1) * sizeof(char *));
+	if (new_tbl == NULL) {
+		api_out_of_memory();
+		return NULL;
+	}
+	file_name = new_tbl;
+
+	file_name[file_count] = mem_strdup(MEM_ROLLBACK, file);
+	if (file_name[file_count] == NULL) {
+		api_out_of_memory();
+		return NULL;
+	}
+
+	return file_name[file_count++];
+}
+
+/* Drop the oldest entry and its deltas. */
+static void drop_oldest_entry(void)
+{
+	uint64_t end;
+
+	assert(entry_head > entry_tail);
+
+	entry_tail++;
+	end = entry_head > entry_tail ? entry[entry_tail % ENTRY_MAX].delta_begin : delta_head;
+	free_deltas(delta_tail, end);
+	delta_tail = end;
+}
+
+/* Free old values in a delta range. */
+static void free_deltas(uint64_t from, uint64_t to)
+{
+	uint64_t i;
+
+	for (i = from; i < to; i++) {
+		mem_free(delta[i % DELTA_MAX].old_value);
+		delta[i % DELTA_MAX].old_value = NULL;
+	}
+}
+
+/*
+ * Record the old value of a variable.
+ */
+bool rollback_record(int space, int var, const char *old_value)
+{
+	struct delta *d;
+	char *s;
+
+	/* Changes before the first tag (e.g., in setup()) are not recorded. */
+	if (entry_head == entry_tail)
+		return true;
+
+	/* Make room by dropping old entries. */
+	while (delta_head - delta_tail == DELTA_MAX && entry_head - entry_tail > 1)
+		drop_oldest_entry();
+
+	/* If the current tag alone fills the ring, it can't be rewound. */
+	if (delta_head - delta_tail == DELTA_MAX) {
+		rollback_clear();
+		return true;
+	}
+
+	s = mem_strdup(MEM_ROLLBACK, old_value);
+	if (s == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+
+	d = &delta[delta_head % DELTA_MAX];
+	d->space = space;
+	d->var = var;
+	d->old_value = s;
+	delta_head++;
+
+	return true;
+}
+
+/*
+ * Get the number of tags that can be rewound.
+ */
+int rollback_get_count(void)
+{
+	return (int)(entry_head - entry_tail);
+}
+
+/*
+ * Rewind tags.
+ */
+bool rollback_rewind(int count, const char **file, int *index)
+{
+	const struct snapshot *s;
+	uint64_t target, snap_seq, seq;
+
+	if (count <= 0 || (uint64_t)count > entry_head - entry_tail) {
+		api_error("Cannot rewind %d tags.", count);
+		return false;
+	}
+
+	target = entry_head - (uint64_t)count;
+
+	/* Restore the first snapshot after the target if we have it. */
+	snap_seq = (target + SNAPSHOT_INTERVAL - 1) / SNAPSHOT_INTERVAL * SNAPSHOT_INTERVAL;
+	s = &snapshot[(snap_seq / SNAPSHOT_INTERVAL) % SNAPSHOT_MAX];
+	if (snap_seq < entry_head && s->seq == snap_seq) {
+		if (!restore_snapshot(s))
+			return false;
+		seq = snap_seq;
+	} else {
+		seq = entry_head;
+	}
+
+	/* Undo the remaining entries. */
+	while (seq > target) {
+		seq--;
+		if (!undo_entry(seq))
+			return false;
+	}
+
+	*file = entry[target % ENTRY_MAX].file;
+	*index = entry[target % ENTRY_MAX].index;
+
+	/* Forget the rewound entries. The target tag will record itself again. */
+	free_deltas(entry[target % ENTRY_MAX].delta_begin, delta_head);
+	delta_head = entry[target % ENTRY_MAX].delta_begin;
+	entry_head = target;
+
+	return true;
+}
+
+/* Undo the variable changes of an entry. */
+static bool undo_entry(uint64_t seq)
+{
+	const struct delta *d;
+	uint64_t begin, end, i;
+
+	begin = entry[seq % ENTRY_MAX].delta_begin;
+	end = seq + 1 < entry_head ? entry[(seq + 1) % ENTRY_MAX].delta_begin : delta_head;
+
+	for (i = end; i > begin; i--) {
+		d = &delta[(i - 1) % DELTA_MAX];
+		if (!var_restore(d->space, d->var, d->old_value))
+			return false;
+	}
+
+	return true;
+}
+
+/* Copy all variables. */
+static bool take_snapshot(uint64_t seq)
+{
+	struct snapshot *s;
+	int space, i;
+
+	s = &snapshot[(seq / SNAPSHOT_INTERVAL) % SNAPSHOT_MAX];
+	free_snapshot(s);
+
+	for (space = 0; space < VAR_SPACE_COUNT; space++) {
+		s->count[space] = var_get_count(space);
+		if (s->count[space] == 0)
+			continue;
+
+		s->value[space] = mem_calloc(MEM_ROLLBACK, (size_t)s->count[space], sizeof(char *));
+		if (s->value[space] == NULL) {
+			free_snapshot(s);
+			api_out_of_memory();
+			return false;
+		}
+		for (i = 0; i < s->count[space]; i++) {
+			s->value[space][i] = mem_strdup(MEM_ROLLBACK, var_get_value(space, i));
+			if (s->value[space][i] == NULL) {
+				free_snapshot(s);
+				api_out_of_memory();
+				return false;
+			}
+		}
+	}
+	s->seq = seq;
+
+	return true;
+}
+
+/* Free a snapshot. */
+static void free_snapshot(struct snapshot *s)
+{
+	int space, i;
+
+	for (space = 0; space < VAR_SPACE_COUNT; space++) {
+		if (s->value[space] != NULL) {
+			for (i = 0; i < s->count[space]; i++)
+				mem_free(s->value[space][i]);
+			mem_free(s->value[space]);
+		}
+		s->value[space] = NULL;
+		s->count[space] = 0;
+	}
+	s->seq = SEQ_NONE;
+}
+
+/*
+ * Restore all variables from a snapshot. Variables added after the
+ * snapshot are cleared because they can't be removed.
+ */
+static bool restore_snapshot(const struct snapshot *s)
+{
+	const char *value;
+	int space, i;
+
+	for (space = 0; space < VAR_SPACE_COUNT; space++) {
+		for (i = 0; i < var_get_count(space); i++) {
+			value = i < s->count[space] ? s->value[space][i] : "";
+			if (strcmp(var_get_value(space, i), value) == 0)
+				continue;
+			if (!var_restore(space, i, value))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Discard the log.
+ */
+void rollback_clear(void)
+{
+	int i;
+
+	free_deltas(delta_tail, delta_head);
+	delta_head = delta_tail = 0;
+	entry_head = entry_tail = 0;
+
+	for (i = 0; i < SNAPSHOT_MAX; i++)
+		free_snapshot(&snapshot[i]);
+	snapshot_initialized = true;
+}
+
+/*
+ * Cleanup the rollback module.
+ */
+void rollback_cleanup(void)
+{
+	int i;
+
+	rollback_clear();
+
+	for (i = 0; i < file_count; i++)
+		mem_free(file_name[i]);
+	mem_free(file_name);
+	file_name = NULL;
+	file_count = 0;
+}
@@ -0,0 +1,40 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * rollback.h: Rollback log for rewinding.
+ */
+
+#ifndef NOVELKIT_ROLLBACK_H
+#define NOVELKIT_ROLLBACK_H
+
+#include "compat.h"
+
+/* Start recording a tag. (called before a tag is run) */
+bool rollback_begin_tag(const char *file, int index);
+
+/* Record the old value of a variable. (called from var_set()) */
+bool rollback_record(int space, int var, const char *old_value);
+
+/* Get the number of tags that can be rewound. */
+int rollback_get_count(void);
+
+/*
+ * Rewind tags.
+ *  - Variables are restored to the state before the target tag ran.
+ *  - The file and the index of the target tag are returned.
+ *  - The returned file name is valid until rollback_cleanup().
+ */
+bool rollback_rewind(int count, const char **file, int *index);
+
+/* Discard the log. */
+void rollback_clear(void);
+
+/* Cleanup the rollback module. */
+void rollback_cleanup(void);
+
+#endif
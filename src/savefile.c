@@ -0,0 +1,610 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * savefile.c: Save file writer.
+ *  - A snapshot is "name\0value\0" pairs, made by copying the variable
+ *    table on the calling thread. Formatting and the file I/O, which
+ *    may block on slow storage, are done by the writer.
+ *  - A file is text of the following lines. Backslashes, tabs and
+ *    newlines in names and values are escaped by a backslash.
+ *      NKVAR 1
+ *      <name>\t<value>
+ *      NKEND
+ *  - A file is replaced by moving a synced temporary file over it. If
+ *    the file is missing, a finished temporary file (that ends with
+ *    NKEND) is recovered.
+ *  - The writer doesn't call the HAL. Failures are counted in the
+ *    status for the executive.
+ */
+
+#include "novelkit.h"
+
+#if defined(TARGET_WINDOWS)
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(USE_SAVE_THREAD)
+#include <pthread.h>
+#endif
+
+/* Save directory. */
+#define SAVE_DIR	"save"
+
+/* File header and footer. */
+#define FILE_HEADER	"NKVAR 1"
+#define FILE_FOOTER	"NKEND"
+
+/* Maximum number of queued files. */
+#define JOB_MAX		16
+
+/* Maximum length of a path. */
+#define PATH_MAX_LEN	1024
+
+/* Write job. */
+struct job {
+	char *file;
+	char *snapshot;
+	size_t size;
+};
+
+/* Status. (guarded by the mutex) */
+static struct savefile_status status;
+
+#if defined(USE_SAVE_THREAD)
+/* Queue. (guarded by the mutex) */
+static struct job queue[JOB_MAX];
+static int queue_count;
+static bool is_writing;
+
+/* Writer thread. */
+static pthread_t thread;
+static bool is_started;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
+/* Forward declarations. */
+static bool check_file_name(const char *file);
+static bool make_snapshot(int space, char **snapshot, size_t *size);
+static bool queue_job(char *file, char *snapshot, size_t size);
+#if defined(USE_SAVE_THREAD)
+static bool start_writer(void);
+static void *writer_main(void *p);
+#endif
+static void finish_job(struct job *j, bool ok);
+static bool write_job(struct job *j);
+static char *serialize(const struct job *j, size_t *size);
+static bool write_file(const char *file, const char *data, size_t size);
+static bool replace_file(const char *from, const char *to);
+static bool recover_file(const char *path, const char *tmp_path, char **buf, bool *exists);
+static bool load_file(const char *path, char **buf, bool *exists);
+static bool parse_vars(int space, char *buf, const char *file);
+static void unescape(char *s);
+
+/*
+ * Queue a snapshot of a variable space.
+ */
+bool savefile_save_vars(int space, const char *file)
+{
+	char *file_copy, *snapshot;
+	size_t size;
+
+	if (!check_file_name(file))
+		return false;
+
+	file_copy = mem_strdup(MEM_FILE, file);
+	if (file_copy == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+	if (!make_snapshot(space, &snapshot, &size)) {
+		mem_free(file_copy);
+		return false;
+	}
+
+	return queue_job(file_copy, snapshot, size);
+}
+
+/* Accept a plain file name only. */
+static bool check_file_name(const char *file)
+{
+	if (file[0] == '\0' || file[0] == '.' ||
+	    strchr(file, '/') != NULL || strchr(file, '\\') != NULL ||
+	    strlen(file) > PATH_MAX_LEN - sizeof(SAVE_DIR "/.tmp")) {
+		api_error("Invalid save file name \"%s\".", file);
+		return false;
+	}
+
+	return true;
+}
+
+/* Copy the variables to a snapshot. */
+static bool make_snapshot(int space, char **snapshot, size_t *size)
+{
+	const char *name, *value;
+	size_t name_len, value_len, pos;
+	int count, i;
+
+	count = var_get_count(space);
+
+	*size = 0;
+	for (i = 0; i < count; i++)
+		*size += strlen(var_get_name(space, i)) + strlen(var_get_value(space, i)) + 2;
+
+	*snapshot = mem_alloc(MEM_FILE, *size + 1);
+	if (*snapshot == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+
+	pos = 0;
+	for (i = 0; i < count; i++) {
+		name = var_get_name(space, i);
+		value = var_get_value(space, i);
+		name_len = strlen(name) + 1;
+		value_len = strlen(value) + 1;
+		memcpy(*snapshot + pos, name, name_len);
+		memcpy(*snapshot + pos + name_len, value, value_len);
+		pos += name_len + value_len;
+	}
+
+	return true;
+}
+
+#if defined(USE_SAVE_THREAD)
+/* Queue a job, or replace the queued snapshot of the same file. */
+static bool queue_job(char *file, char *snapshot, size_t size)
+{
+	int i;
+
+	if (!is_started && !start_writer()) {
+		mem_free(file);
+		mem_free(snapshot);
+		return false;
+	}
+
+	pthread_mutex_lock(&mutex);
+
+	/* Coalesce with a queued save. The one being written is not touched. */
+	for (i = 0; i < queue_count; i++) {
+		if (strcmp(queue[i].file, file) == 0) {
+			mem_free(queue[i].snapshot);
+			queue[i].snapshot = snapshot;
+			queue[i].size = size;
+			status.coalesced++;
+			pthread_mutex_unlock(&mutex);
+			mem_free(file);
+			return true;
+		}
+	}
+
+	/* Wait for a slot. */
+	while (queue_count == JOB_MAX)
+		pthread_cond_wait(&done_cond, &mutex);
+
+	queue[queue_count].file = file;
+	queue[queue_count].snapshot = snapshot;
+	queue[queue_count].size = size;
+	queue_count++;
+	status.pending++;
+
+	pthread_cond_signal(&job_cond);
+	pthread_mutex_unlock(&mutex);
+
+	return true;
+}
+
+/* Start the writer thread and the flush at exit. */
+static bool start_writer(void)
+{
+	if (pthread_create(&thread, NULL, writer_main, NULL) != 0) {
+		api_error("Cannot start the save writer.");
+		return false;
+	}
+	pthread_detach(thread);
+	atexit(savefile_flush);
+	is_started = true;
+
+	return true;
+}
+
+/* Writer thread main. */
+static void *writer_main(void *p)
+{
+	struct job j;
+	bool ok;
+
+	UNUSED_PARAMETER(p);
+
+	for (;;) {
+		/* Take the oldest job. */
+		pthread_mutex_lock(&mutex);
+		while (queue_count == 0)
+			pthread_cond_wait(&job_cond, &mutex);
+		j = queue[0];
+		memmove(&queue[0], &queue[1], (size_t)(queue_count - 1) * sizeof(struct job));
+		queue_count--;
+		is_writing = true;
+		pthread_mutex_unlock(&mutex);
+
+		ok = write_job(&j);
+
+		pthread_mutex_lock(&mutex);
+		is_writing = false;
+		finish_job(&j, ok);
+		status.pending--;
+		pthread_cond_broadcast(&done_cond);
+		pthread_mutex_unlock(&mutex);
+	}
+
+	return NULL;
+}
+#else
+/* Write a job right away. */
+static bool queue_job(char *file, char *snapshot, size_t size)
+{
+	struct job j;
+
+	j.file = file;
+	j.snapshot = snapshot;
+	j.size = size;
+	finish_job(&j, write_job(&j));
+
+	return true;
+}
+#endif
+
+/* Count a finished job and free it. */
+static void finish_job(struct job *j, bool ok)
+{
+	if (ok)
+		status.written++;
+	else
+		status.failed++;
+
+	mem_free(j->file);
+	mem_free(j->snapshot);
+}
+
+/* Serialize a snapshot and write it. */
+static bool write_job(struct job *j)
+{
+	char *data;
+	size_t size;
+	bool ok;
+
+	data = serialize(j, &size);
+	if (data == NULL)
+		return false;
+
+	ok = write_file(j->file, data, size);
+	mem_free(data);
+
+	return ok;
+}
+
+/* Format a snapshot as text. */
+static char *serialize(const struct job *j, size_t *size)
+{
+	const char *p, *end;
+	char *data, *out;
+	bool is_name;
+
+	/* Escaping doubles a character at most. */
+	data = mem_alloc(MEM_FILE, sizeof(FILE_HEADER) + j->size * 2 + sizeof(FILE_FOOTER));
+	if (data == NULL)
+		return NULL;
+
+	out = data;
+	memcpy(out, FILE_HEADER "\n", sizeof(FILE_HEADER));
+	out += sizeof(FILE_HEADER);
+
+	is_name = true;
+	end = j->snapshot + j->size;
+	for (p = j->snapshot; p < end; p++) {
+		switch (*p) {
+		case '\0':
+			*out++ = is_name ? '\t' : '\n';
+			is_name = !is_name;
+			break;
+		case '\\':
+			*out++ = '\\';
+			*out++ = '\\';
+			break;
+		case '\t':
+			*out++ = '\\';
+			*out++ = 't';
+			break;
+		case '\n':
+			*out++ = '\\';
+			*out++ = 'n';
+			break;
+		case '\r':
+			*out++ = '\\';
+			*out++ = 'r';
+			break;
+		default:
+			*out++ = *p;
+			break;
+		}
+	}
+	memcpy(out, FILE_FOOTER "\n", sizeof(FILE_FOOTER));
+	out += sizeof(FILE_FOOTER);
+	*size = (size_t)(out - data);
+
+	return data;
+}
+
+/* Write a file through a synced temporary file. */
+static bool write_file(const char *file, const char *data, size_t size)
+{
+	char path[PATH_MAX_LEN], tmp_path[PATH_MAX_LEN];
+	FILE *fp;
+	bool ok;
+
+	snprintf(path, sizeof(path), "%s/%s", SAVE_DIR, file);
+	snprintf(tmp_path, sizeof(tmp_path), "%s/%s.tmp", SAVE_DIR, file);
+
+#if defined(TARGET_WINDOWS)
+	_mkdir(SAVE_DIR);
+#else
+	mkdir(SAVE_DIR, 0755);
+#endif
+
+	fp = fopen(tmp_path, "wb");
+	if (fp == NULL)
+		return false;
+	ok = fwrite(data, 1, size, fp) == size && fflush(fp) == 0;
+#if defined(TARGET_WINDOWS)
+	if (ok && _commit(_fileno(fp)) != 0)
+		ok = false;
+#else
+	if (ok && fsync(fileno(fp)) != 0)
+		ok = false;
+#endif
+	if (fclose(fp) != 0)
+		ok = false;
+	if (!ok) {
+		remove(tmp_path);
+		return false;
+	}
+
+	if (!replace_file(tmp_path, path)) {
+		remove(tmp_path);
+		return false;
+	}
+
+	return true;
+}
+
+/* Move a file over another file atomically. */
+static bool replace_file(const char *from, const char *to)
+{
+#if defined(TARGET_WINDOWS)
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	int fd;
+
+	if (rename(from, to) != 0)
+		return false;
+
+	/* Sync the directory entry of the rename. */
+	fd = open(SAVE_DIR, O_RDONLY);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+
+	return true;
+#endif
+}
+
+/*
+ * Load a file into a variable space.
+ */
+bool savefile_load_vars(int space, const char *file, bool *loaded)
+{
+	char path[PATH_MAX_LEN], tmp_path[PATH_MAX_LEN];
+	char *buf;
+	bool ok;
+
+	*loaded = false;
+
+	if (!check_file_name(file))
+		return false;
+
+	/* Read what was saved last. */
+	savefile_flush();
+
+	snprintf(path, sizeof(path), "%s/%s", SAVE_DIR, file);
+	snprintf(tmp_path, sizeof(tmp_path), "%s/%s.tmp", SAVE_DIR, file);
+	if (!load_file(path, &buf, loaded))
+		return false;
+	if (!*loaded && !recover_file(path, tmp_path, &buf, loaded))
+		return false;
+	if (!*loaded)
+		return true;
+
+	ok = parse_vars(space, buf, file);
+	mem_free(buf);
+	if (!ok)
+		*loaded = false;
+
+	return ok;
+}
+
+/* Recover a finished temporary file of a missing file. */
+static bool recover_file(const char *path, const char *tmp_path, char **buf, bool *exists)
+{
+	size_t len;
+
+	if (!load_file(tmp_path, buf, exists))
+		return false;
+	if (!*exists)
+		return true;
+
+	/* A crash in the middle of writing leaves no footer. */
+	len = strlen(*buf);
+	if (len < sizeof(FILE_FOOTER) ||
+	    strcmp(*buf + len - sizeof(FILE_FOOTER), FILE_FOOTER "\n") != 0 ||
+	    (len > sizeof(FILE_FOOTER) && (*buf)[len - sizeof(FILE_FOOTER) - 1] != '\n')) {
+		mem_free(*buf);
+		*buf = NULL;
+		*exists = false;
+		return true;
+	}
+
+	/* Keep the file even if the move fails; it will be read again. */
+	replace_file(tmp_path, path);
+
+	return true;
+}
+
+/* Read a whole file. */
+static bool load_file(const char *path, char **buf, bool *exists)
+{
+	char *new_buf;
+	size_t size, alloc, n;
+	FILE *fp;
+
+	*buf = NULL;
+	*exists = false;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return true;
+
+	size = 0;
+	alloc = 0;
+	do {
+		if (alloc - size < 4096) {
+			alloc = alloc == 0 ? 65536 : alloc * 2;
+			new_buf = mem_realloc(MEM_FILE, *buf, alloc + 1);
+			if (new_buf == NULL) {
+				mem_free(*buf);
+				*buf = NULL;
+				fclose(fp);
+				api_out_of_memory();
+				return false;
+			}
+			*buf = new_buf;
+		}
+		n = fread(*buf + size, 1, alloc - size, fp);
+		size += n;
+	} while (n > 0);
+	fclose(fp);
+
+	(*buf)[size] = '\0';
+	*exists = true;
+
+	return true;
+}
+
+/* Parse the lines of a file and set the variables. */
+static bool parse_vars(int space, char *buf, const char *file)
+{
+	char *line, *next, *tab;
+	int lineno;
+
+	if (strncmp(buf, FILE_HEADER "\n", sizeof(FILE_HEADER)) != 0) {
+		api_error("%s is not a save file.", file);
+		return false;
+	}
+
+	lineno = 1;
+	for (line = buf + sizeof(FILE_HEADER); *line != '\0'; line = next) {
+		lineno++;
+		next = strchr(line, '\n');
+		if (next == NULL) {
+			api_error("%s:%d: Truncated line.", file, lineno);
+			return false;
+		}
+		*next++ = '\0';
+
+		/* Files without the footer are also accepted. */
+		if (strcmp(line, FILE_FOOTER) == 0)
+			break;
+
+		tab = strchr(line, '\t');
+		if (tab == NULL) {
+			api_error("%s:%d: Broken line.", file, lineno);
+			return false;
+		}
+		*tab = '\0';
+
+		unescape(line);
+		unescape(tab + 1);
+		if (!var_add(space, line, tab + 1))
+			return false;
+	}
+
+	return true;
+}
+
+/* Unescape a string in place. */
+static void unescape(char *s)
+{
+	char *out;
+
+	for (out = s; *s != '\0'; s++) {
+		if (*s != '\\' || s[1] == '\0') {
+			*out++ = *s;
+			continue;
+		}
+		s++;
+		switch (*s) {
+		case 't':
+			*out++ = '\t';
+			break;
+		case 'n':
+			*out++ = '\n';
+			break;
+		case 'r':
+			*out++ = '\r';
+			break;
+		default:
+			*out++ = *s;
+			break;
+		}
+	}
+	*out = '\0';
+}
+
+/*
+ * Wait for the pending writes.
+ */
+void savefile_flush(void)
+{
+#if defined(USE_SAVE_THREAD)
+	pthread_mutex_lock(&mutex);
+	while (queue_count > 0 || is_writing)
+		pthread_cond_wait(&done_cond, &mutex);
+	pthread_mutex_unlock(&mutex);
+#endif
+}
+
+/*
+ * Get the writer status.
+ */
+void savefile_get_status(struct savefile_status *ret)
+{
+#if defined(USE_SAVE_THREAD)
+	pthread_mutex_lock(&mutex);
+	*ret = status;
+	pthread_mutex_unlock(&mutex);
+#else
+	*ret = status;
+#endif
+}
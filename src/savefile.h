@@ -0,0 +1,49 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * savefile.h: Save file writer.
+ *  - A save takes a snapshot of a variable space and returns. The
+ *    snapshot is serialized and written by the writer thread with
+ *    USE_SAVE_THREAD (POSIX threads), or right away without it.
+ *  - A file is written to a temporary file, synced and renamed, so a
+ *    crash leaves the old file or the new file.
+ *  - A save of a file that is still queued replaces the queued
+ *    snapshot.
+ *  - Pending writes are finished at exit.
+ */
+
+#ifndef NOVELKIT_SAVEFILE_H
+#define NOVELKIT_SAVEFILE_H
+
+#include "compat.h"
+
+/* Writer status. */
+struct savefile_status {
+	int pending;
+	uint64_t written;
+	uint64_t coalesced;
+	uint64_t failed;
+};
+
+/* Queue a snapshot of a variable space to a file in the save directory. */
+bool savefile_save_vars(int space, const char *file);
+
+/*
+ * Load a file in the save directory into a variable space.
+ *  - Waits for the pending writes first.
+ *  - Returns true with *loaded false if the file doesn't exist.
+ */
+bool savefile_load_vars(int space, const char *file, bool *loaded);
+
+/* Wait for the pending writes. */
+void savefile_flush(void);
+
+/* Get the writer status. */
+void savefile_get_status(struct savefile_status *status);
+
+#endif
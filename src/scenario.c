@@ -26,195 +26,1650 @@
 #define PROP_VALUE_MAX	4096
 #define COMMAND_MAX	65536
 
+/* Maximum number of tags run in a frame without a wait. */
+#define RUN_TAG_MAX	1000
+
+/* Initial command table size. */
+#define COMMAND_ALLOC_INIT	1024
+
+/* Label tag. */
+#define LABEL_TAG	"label"
+#define LABEL_PROP	"name"
+
+/* Macro tags. */
+#define MACRO_TAG	"macro"
+#define MACRO_PROP	"name"
+#define ENDMACRO_TAG	"endmacro"
+
+/* Macro limits. */
+#define MACRO_DEPTH_MAX		16
+#define MACRO_EXPANSION_MAX	4096
+
+/* Global variable that keeps the cached parameter dictionaries alive. */
+#define PARAM_ROOT_GLOBAL	"$param_cache"
+
+/* Number of cached parameter dictionaries. */
+#define PARAM_CACHE_SIZE	256
+
+/* Minimum length of a value kept in the text store. */
+#define PACK_MIN_LEN	32
+
+/* Properties for localization. */
+#define LOC_ID_PROP	"id"
+#define LOC_TEXT_PROP	"text"
+
+/* Argument of a native tag. */
+struct native_arg {
+	/* Property index, or -1 if not written. */
+	int prop;
+
+	/* Value converted at load time, valid without variable references. */
+	bool is_valid;
+	struct tag_value value;
+};
+
 /* Command struct. */
 struct command {
-	char *tag_name;
+	/* Tag and property names are interned. */
+	const char *tag_name;
 	int prop_count;
-	char *prop_name[PROP_MAX];
-	char *prop_value[PROP_MAX];
+	const char **prop_name;
+	char **prop_value;
+
+	/* Source line, and the line of the macro call it is expanded from. */
+	int line;
+	int call_line;
+
+	/* String table keys of properties, or NULL without an ID. */
+	uint64_t *loc_key;
+
+	/* Text store references of properties, or NULL. (prop_value is NULL for a stored value) */
+	uint32_t *text_ref;
+
+	/* Compiled property values, or NULL without variable references. */
+	struct interp **interp;
+
+	/* Compiled localized values, valid for loc_gen. (with an ID) */
+	struct interp **loc_interp;
+	uint32_t loc_gen;
+
+	/* Native tag index or -1, and the arguments. (NULL without properties) */
+	int native;
+	struct native_arg *native_args;
+
+	/* Cached parameter dictionary, valid with param_cached. (see prepare_param_dict()) */
+	struct rt_value param;
+	bool param_cached;
 };
 
-/* Current scenario file. */
-__attribute__((unused))
-static char *cur_file;
+/* Macro struct. */
+struct macro {
+	char *name;
+	int line;
+	struct command *body;
+	int body_size;
+	int body_alloc;
+};
+
+/* Parser scratch space. */
+struct parser_scratch {
+	char tag_name[TAG_NAME_MAX];
+	char prop_name[PROP_MAX][PROP_NAME_MAX];
+	char prop_val[PROP_MAX][PROP_VALUE_MAX];
+};
+
+/*
+ * Scenario instance.
+ *  - Holds everything of a running scenario except the interned names,
+ *    which are shared by all instances.
+ */
+struct scenario_context {
+	/* Current scenario file. */
+	char *cur_file;
+
+	/* Current command index. */
+	int cur_index;
+
+	/* Set when the position is changed by the running tag. */
+	bool is_moved;
+
+	/* Command table. */
+	struct command *cmd;
+
+	/* Command size. */
+	int cmd_size;
+
+	/* Allocated command table size. */
+	int cmd_alloc;
+
+	/* Long property values of the command table. */
+	struct textstore *text;
+
+	/*
+	 * Root of the cached parameter dictionaries.
+	 *  - Replaced by a new one at the first tag after the command
+	 *    table is replaced, so that the old dictionaries become
+	 *    garbage.
+	 *  - Slots are reused in a ring. param_owner is the command index
+	 *    of a slot, or -1.
+	 */
+	struct rt_value param_root;
+	bool param_root_stale;
+	int param_owner[PARAM_CACHE_SIZE];
+	int param_next;
+
+	/* Macros of the file being loaded. */
+	struct macro *macro_tbl;
+	int macro_count;
+	int macro_alloc;
+
+	/* Macro being defined. */
+	struct macro *cur_macro;
+
+	/* Number of commands made by the current top-level macro call. */
+	int expansion_count;
+
+	/* Parser scratch space. (allocated at the first parse) */
+	struct parser_scratch *scratch;
+};
+
+/* Instance of the engine. */
+static struct scenario_context main_ctx = {
+	.param_root_stale = true,
+};
+
+/* Current instance. */
+static struct scenario_context *ctx = &main_ctx;
+
+/* Prefetched command table. (see scenario_prefetch()) */
+static char *pf_file;
+static struct command *pf_cmd;
+static int pf_size;
+static int pf_alloc;
+static struct textstore *pf_text;
+
+/* Interned names. (open addressing) */
+static char **name_tbl;
+static int name_count;
+static int name_tbl_size;
+
+/* Dispatch counts. (written by the thread that runs tags, read by any) */
+static struct scenario_stats stats;
+
+#if defined(USE_DISPATCH_TIMING)
+/* Number of tags between dispatch time logs. */
+#define DISPATCH_LOG_INTERVAL	1000
+
+/* Dispatch time measurement. */
+static uint64_t native_usec;
+static uint64_t script_usec;
+#endif
+
+/* Forward declaration. */
+static void destroy_commands(void);
+static void free_command_table(struct command *tbl, int size);
+static bool load_commands(const char *file);
+static bool take_prefetched(const char *file);
+static void print_error(struct rt_env *rt);
+static void add_stat(uint64_t *counter);
+static bool parse_tag_callback(const char *name, int props, const char **prop_name, const char **prop_val, int line);
+static struct command *append_command(struct command **tbl, int *size, int *alloc);
+static bool copy_command(struct command *c, const char *name, int props, const char **prop_name, const char **prop_value, int line);
+static bool add_command(const char *name, int props, const char **prop_name, const char **prop_value, int line, int call_line);
+static bool begin_macro(int props, const char **prop_name, const char **prop_value, int line);
+static struct macro *find_macro(const char *name);
+static bool expand_macro(struct macro *m, int props, const char **prop_name, const char **prop_value, int call_line, int depth);
+static bool substitute(struct macro *m, const char *s, int props, const char **prop_name, const char **prop_value, char *out, size_t *len);
+static void free_macros(void);
+static const char *intern_name(const char *name);
+static void free_names(void);
+static bool make_loc_keys(struct command *c);
+static bool compile_props(struct command *c);
+static bool bind_native(struct command *c);
+static bool pack_props(struct command *c);
+static const char *get_raw_value(const struct command *c, int index);
+static const char *get_prop_value(struct command *c, int index);
+static bool prepare_param_dict(struct rt_env *rt, struct command *c, struct rt_value *param, bool *api_failed);
+static bool make_param_dict(struct rt_env *rt, struct command *c, struct rt_value *dict, bool *api_failed);
+static bool run_script(struct rt_env *rt, struct command *c, bool *api_failed);
+static bool run_native(struct command *c);
+static bool is_dynamic_prop(struct command *c, int index);
+static bool parse_tag_document(const char *doc, bool (*callback)(const char *, int, const char **, const char **, int), char **error_msg, int *error_line);
+#if defined(USE_HOT_RELOAD)
+static int find_label_before(int index);
+static int find_label(const char *name);
+static uint32_t hash_command(const struct command *c);
+static int find_anchor(uint32_t anchor, int begin, int end, int hint);
+#endif
+
+/*
+ * Initialize the scenario module.
+ */
+bool scenario_init(void)
+{
+	destroy_commands();
+
+	return true;
+}
+
+/*
+ * Cleanup the scenario module.
+ */
+void scenario_cleanup(void)
+{
+	ctx = &main_ctx;
+	destroy_commands();
+	take_prefetched(NULL);
+
+	mem_free(ctx->scratch);
+	ctx->scratch = NULL;
+
+	free_names();
+	interp_cleanup();
+}
+
+/*
+ * Create a scenario instance.
+ */
+struct scenario_context *scenario_create_context(void)
+{
+	struct scenario_context *c;
+
+	c = mem_calloc(MEM_SCENARIO, 1, sizeof(struct scenario_context));
+	if (c == NULL) {
+		api_out_of_memory();
+		return NULL;
+	}
+	c->param_root_stale = true;
+
+	return c;
+}
+
+/*
+ * Destroy a scenario instance.
+ */
+void scenario_destroy_context(struct scenario_context *c)
+{
+	struct scenario_context *saved;
+
+	if (c == NULL)
+		return;
+
+	assert(c != &main_ctx);
+	assert(c != ctx);
+
+	saved = ctx;
+	ctx = c;
+	destroy_commands();
+	free_macros();
+	mem_free(ctx->scratch);
+	ctx = saved;
+
+	mem_free(c);
+}
+
+/*
+ * Make a scenario instance current.
+ */
+struct scenario_context *scenario_switch_context(struct scenario_context *c)
+{
+	struct scenario_context *prev;
+
+	prev = ctx;
+	ctx = c != NULL ? c : &main_ctx;
+
+	return prev;
+}
+
+static void destroy_commands(void)
+{
+	ctx->cur_index = 0;
+
+	if (ctx->cur_file != NULL) {
+		mem_free(ctx->cur_file);
+		ctx->cur_file = NULL;
+	}
+
+	free_command_table(ctx->cmd, ctx->cmd_size);
+	ctx->cmd = NULL;
+	ctx->cmd_size = 0;
+	ctx->cmd_alloc = 0;
+	ctx->param_root_stale = true;
+
+	textstore_destroy(ctx->text);
+	ctx->text = NULL;
+}
+
+/* Free a command table. */
+static void free_command_table(struct command *tbl, int size)
+{
+	struct command *c;
+	int i, j;
+
+	if (tbl == NULL)
+		return;
+
+	for (i = 0; i < size; i++) {
+		c = &tbl[i];
+		for (j = 0; j < c->prop_count; j++)
+			mem_free(c->prop_value[j]);
+		mem_free(c->prop_name);
+		mem_free(c->prop_value);
+		mem_free(c->text_ref);
+		mem_free(c->loc_key);
+		for (j = 0; j < c->prop_count; j++) {
+			if (c->interp != NULL)
+				interp_free(c->interp[j]);
+			if (c->loc_interp != NULL)
+				interp_free(c->loc_interp[j]);
+		}
+		mem_free(c->interp);
+		mem_free(c->loc_interp);
+		mem_free(c->native_args);
+	}
+	mem_free(tbl);
+}
+
+/*
+ * Load a scenario file and move to it.
+ */
+bool scenario_move_to_file(struct rt_env *rt, const char *file)
+{
+	char *file_copy;
+
+	UNUSED_PARAMETER(rt);
+
+	file_copy = mem_strdup(MEM_SCENARIO, file);
+	if (file_copy == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+
+	destroy_commands();
+
+	/* Take the table parsed at startup, or parse the file. */
+	if (!take_prefetched(file) && !load_commands(file)) {
+		mem_free(file_copy);
+		destroy_commands();
+		return false;
+	}
+
+	ctx->cur_file = file_copy;
+	ctx->is_moved = true;
+
+#if defined(USE_HOT_RELOAD)
+	/* Watch the file for changes. (development builds only) */
+	hotreload_watch(file);
+#endif
+
+	return true;
+}
+
+/*
+ * Parse a scenario file ahead of the first move to it.
+ */
+bool scenario_prefetch(const char *file)
+{
+	assert(pf_file == NULL);
+
+	pf_file = mem_strdup(MEM_SCENARIO, file);
+	if (pf_file == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+
+	if (!load_commands(file)) {
+		destroy_commands();
+		mem_free(pf_file);
+		pf_file = NULL;
+		return false;
+	}
+
+	/* Keep the table aside until the move. */
+	pf_cmd = ctx->cmd;
+	pf_size = ctx->cmd_size;
+	pf_alloc = ctx->cmd_alloc;
+	pf_text = ctx->text;
+	ctx->cmd = NULL;
+	ctx->cmd_size = 0;
+	ctx->cmd_alloc = 0;
+	ctx->text = NULL;
+
+	return true;
+}
+
+/* Take the prefetched table if it is of the file, and drop it anyway. */
+static bool take_prefetched(const char *file)
+{
+	bool match;
+
+	if (pf_file == NULL)
+		return false;
+
+	match = file != NULL && strcmp(file, pf_file) == 0;
+	if (match) {
+		assert(ctx->cmd == NULL);
+		ctx->cmd = pf_cmd;
+		ctx->cmd_size = pf_size;
+		ctx->cmd_alloc = pf_alloc;
+		ctx->text = pf_text;
+	} else {
+		free_command_table(pf_cmd, pf_size);
+		textstore_destroy(pf_text);
+	}
+
+	mem_free(pf_file);
+	pf_file = NULL;
+	pf_cmd = NULL;
+	pf_size = 0;
+	pf_alloc = 0;
+	pf_text = NULL;
+
+	return match;
+}
+
+/* Parse a scenario file into the empty command table. */
+static bool load_commands(const char *file)
+{
+	struct command *new_cmd;
+	struct file_view view;
+	char *error_message;
+	int error_line;
+
+	assert(ctx->cmd == NULL);
+	assert(ctx->text == NULL);
+
+	ctx->text = textstore_create();
+	if (ctx->text == NULL)
+		return false;
+
+	if (!common_open_file_view(file, &view))
+		return false;
+
+	/* Macros are local to a file. */
+	free_macros();
+
+	if (!parse_tag_document(view.data, parse_tag_callback, &error_message, &error_line)) {
+		api_error("tag error: %s:%d: %s", file, error_line, error_message);
+		free(error_message);
+		free_macros();
+		common_close_file_view(&view);
+		return false;
+	}
+	if (ctx->cur_macro != NULL) {
+		api_error("tag error: %s:%d: Unterminated macro %s.", file, ctx->cur_macro->line, ctx->cur_macro->name);
+		free_macros();
+		common_close_file_view(&view);
+		return false;
+	}
+
+	/* Macros are not needed after expansion. */
+	free_macros();
+	common_close_file_view(&view);
+
+	/* Compress the last text block. */
+	if (!textstore_finish(ctx->text))
+		return false;
+
+	/* Drop the unused part of the table. */
+	if (ctx->cmd_size > 0 && ctx->cmd_size < ctx->cmd_alloc) {
+		new_cmd = mem_realloc(MEM_SCENARIO, ctx->cmd, (size_t)ctx->cmd_size * sizeof(struct command));
+		if (new_cmd != NULL) {
+			ctx->cmd = new_cmd;
+			ctx->cmd_alloc = ctx->cmd_size;
+		}
+	}
+
+	return true;
+}
+
+/* Callback for when a tag is read. */
+static bool parse_tag_callback(const char *name, int props, const char **prop_name, const char **prop_value, int line)
+{
+	struct command *c;
+	struct macro *m;
+
+	/* Start or end a macro definition. */
+	if (strcmp(name, MACRO_TAG) == 0)
+		return begin_macro(props, prop_name, prop_value, line);
+	if (strcmp(name, ENDMACRO_TAG) == 0) {
+		if (ctx->cur_macro == NULL) {
+			api_error("%s without %s.", ENDMACRO_TAG, MACRO_TAG);
+			return false;
+		}
+		ctx->cur_macro = NULL;
+		return true;
+	}
+
+	/* Record a command of a macro body as is. */
+	if (ctx->cur_macro != NULL) {
+		c = append_command(&ctx->cur_macro->body, &ctx->cur_macro->body_size, &ctx->cur_macro->body_alloc);
+		if (c == NULL)
+			return false;
+		return copy_command(c, name, props, prop_name, prop_value, line);
+	}
+
+	/* Expand a macro call. */
+	m = find_macro(name);
+	if (m != NULL) {
+		ctx->expansion_count = 0;
+		return expand_macro(m, props, prop_name, prop_value, line, 0);
+	}
+
+	return add_command(name, props, prop_name, prop_value, line, 0);
+}
+
+/* Append an empty command to a table. */
+static struct command *append_command(struct command **tbl, int *size, int *alloc)
+{
+	struct command *new_tbl;
+	int new_alloc;
+
+	/* If command table is full. */
+	if (*size >= COMMAND_MAX) {
+		api_error("Too many commands.");
+		return NULL;
+	}
+
+	/* Grow the command table. */
+	if (*size == *alloc) {
+		new_alloc = *alloc == 0 ? COMMAND_ALLOC_INIT : *alloc * 2;
+		if (new_alloc > COMMAND_MAX)
+			new_alloc = COMMAND_MAX;
+		new_tbl = mem_realloc(MEM_SCENARIO, *tbl, (size_t)new_alloc * sizeof(struct command));
+		if (new_tbl == NULL) {
+			api_out_of_memory();
+			return NULL;
+		}
+		*tbl = new_tbl;
+		*alloc = new_alloc;
+	}
+
+	memset(&(*tbl)[*size], 0, sizeof(struct command));
+
+	return &(*tbl)[(*size)++];
+}
+
+/* Copy a tag name and properties to a command. */
+static bool copy_command(struct command *c, const char *name, int props, const char **prop_name, const char **prop_value, int line)
+{
+	int i;
+
+	c->line = line;
+
+	/* Intern a tag name. */
+	c->tag_name = intern_name(name);
+	if (c->tag_name == NULL)
+		return false;
+
+	if (props == 0)
+		return true;
+
+	/* Allocate property tables. */
+	c->prop_name = mem_calloc(MEM_SCENARIO, (size_t)props, sizeof(const char *));
+	c->prop_value = mem_calloc(MEM_SCENARIO, (size_t)props, sizeof(char *));
+	if (c->prop_name == NULL || c->prop_value == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+
+	/* Copy properties. */
+	for (i = 0; i < props; i++) {
+		c->prop_name[i] = intern_name(prop_name[i]);
+		if (c->prop_name[i] == NULL)
+			return false;
+		c->prop_value[i] = mem_strdup(MEM_SCENARIO, prop_value[i]);
+		c->prop_count = i + 1;
+		if (c->prop_value[i] == NULL) {
+			api_out_of_memory();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Add a command to the command table. */
+static bool add_command(const char *name, int props, const char **prop_name, const char **prop_value, int line, int call_line)
+{
+	struct command *c;
+
+	c = append_command(&ctx->cmd, &ctx->cmd_size, &ctx->cmd_alloc);
+	if (c == NULL)
+		return false;
+
+	if (!copy_command(c, name, props, prop_name, prop_value, line))
+		return false;
+	c->call_line = call_line;
+
+	/* Precompute the string table keys. */
+	if (!make_loc_keys(c))
+		return false;
+
+	/* Compile variable references. */
+	if (!compile_props(c))
+		return false;
+
+	/* Convert the values of a native tag. */
+	if (!bind_native(c))
+		return false;
+
+	/* Move long values to the text store. */
+	if (!pack_props(c))
+		return false;
+
+	return true;
+}
+
+/*
+ * Macro
+ *  - [macro name="x"] ... [endmacro] defines a macro "x" in the file.
+ *  - A tag [x a="1"] is replaced by the body when the file is loaded,
+ *    with "%{a}" in property values replaced by "1". "%%{" is a
+ *    literal "%{".
+ *  - A macro body can call macros defined before the call.
+ */
+
+/* Start a macro definition. */
+static bool begin_macro(int props, const char **prop_name, const char **prop_value, int line)
+{
+	struct macro *new_tbl;
+	struct macro *m;
+	int new_alloc;
+
+	if (ctx->cur_macro != NULL) {
+		api_error("Nested macro definition in %s.", ctx->cur_macro->name);
+		return false;
+	}
+	if (props < 1 || strcmp(prop_name[0], MACRO_PROP) != 0) {
+		api_error("%s needs a %s property.", MACRO_TAG, MACRO_PROP);
+		return false;
+	}
+	if (find_macro(prop_value[0]) != NULL) {
+		api_error("Macro %s is already defined.", prop_value[0]);
+		return false;
+	}
+
+	/* Grow the macro table. */
+	if (ctx->macro_count == ctx->macro_alloc) {
+		new_alloc = ctx->macro_alloc == 0 ? 16 : ctx->macro_alloc * 2;
+		new_tbl = mem_realloc(MEM_SCENARIO, ctx->macro_tbl, (size_t)new_alloc * sizeof(struct macro));
+		if (new_tbl == NULL) {
+			api_out_of_memory();
+			return false;
+		}
+		ctx->macro_tbl = new_tbl;
+		ctx->macro_alloc = new_alloc;
+	}
+
+	m = &ctx->macro_tbl[ctx->macro_count];
+	memset(m, 0, sizeof(struct macro));
+	m->name = mem_strdup(MEM_SCENARIO, prop_value[0]);
+	if (m->name == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+	m->line = line;
+	ctx->macro_count++;
+
+	ctx->cur_macro = m;
+
+	return true;
+}
+
+/* Find a macro. */
+static struct macro *find_macro(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ctx->macro_count; i++) {
+		if (strcmp(ctx->macro_tbl[i].name, name) == 0)
+			return &ctx->macro_tbl[i];
+	}
+
+	return NULL;
+}
+
+/* Expand a macro call into the command table. */
+static bool expand_macro(struct macro *m, int props, const char **prop_name, const char **prop_value, int call_line, int depth)
+{
+	struct command *b;
+	struct macro *inner;
+	char *val[PROP_MAX];
+	size_t len;
+	int i, j;
+	bool ret;
+
+	if (depth >= MACRO_DEPTH_MAX) {
+		api_error("Macro %s is nested too deeply.", m->name);
+		return false;
+	}
+
+	for (i = 0; i < m->body_size; i++) {
+		b = &m->body[i];
+
+		/* Substitute the call properties. */
+		ret = true;
+		for (j = 0; j < b->prop_count; j++) {
+			val[j] = NULL;
+			if (ret && substitute(m, b->prop_value[j], props, prop_name, prop_value, NULL, &len)) {
+				val[j] = mem_alloc(MEM_SCENARIO, len + 1);
+				if (val[j] == NULL) {
+					api_out_of_memory();
+					ret = false;
+					continue;
+				}
+				substitute(m, b->prop_value[j], props, prop_name, prop_value, val[j], &len);
+			} else {
+				ret = false;
+			}
+		}
+
+		/* Inner macro calls are counted too, not to explode. */
+		if (ret && ++ctx->expansion_count > MACRO_EXPANSION_MAX) {
+			api_error("Macro %s expands to too many commands.", m->name);
+			ret = false;
+		}
+
+		if (ret) {
+			inner = find_macro(b->tag_name);
+			if (inner != NULL)
+				ret = expand_macro(inner, b->prop_count, b->prop_name, (const char **)val, call_line, depth + 1);
+			else
+				ret = add_command(b->tag_name, b->prop_count, b->prop_name, (const char **)val, b->line, call_line);
+		}
+
+		for (j = 0; j < b->prop_count; j++)
+			mem_free(val[j]);
+		if (!ret)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Substitute "%{name}" in a property value of a macro body.
+ *  - Without out, only gets the length.
+ */
+static bool substitute(struct macro *m, const char *s, int props, const char **prop_name, const char **prop_value, char *out, size_t *len)
+{
+	const char *end;
+	size_t name_len, val_len;
+	int i;
+
+	*len = 0;
+	while (*s != '\0') {
+		/* "%%{" is a literal "%{". */
+		if (s[0] == '%' && s[1] == '%' && s[2] == '{') {
+			if (out != NULL) {
+				out[(*len)++] = '%';
+				out[(*len)++] = '{';
+			} else {
+				*len += 2;
+			}
+			s += 3;
+			continue;
+		}
+
+		if (s[0] != '%' || s[1] != '{') {
+			if (out != NULL)
+				out[*len] = *s;
+			(*len)++;
+			s++;
+			continue;
+		}
+
+		end = strchr(s + 2, '}');
+		if (end == NULL) {
+			api_error("Unterminated %%{ in macro %s.", m->name);
+			return false;
+		}
+		name_len = (size_t)(end - s - 2);
+
+		/* Find the property of the call. */
+		for (i = 0; i < props; i++) {
+			if (strlen(prop_name[i]) == name_len &&
+			    strncmp(prop_name[i], s + 2, name_len) == 0)
+				break;
+		}
+		if (i == props) {
+			api_error("Macro %s needs a property %.*s.", m->name, (int)name_len, s + 2);
+			return false;
+		}
+
+		val_len = strlen(prop_value[i]);
+		if (out != NULL)
+			memcpy(out + *len, prop_value[i], val_len);
+		*len += val_len;
+		s = end + 1;
+	}
+	if (out != NULL)
+		out[*len] = '\0';
+
+	return true;
+}
+
+/* Free the macros. */
+static void free_macros(void)
+{
+	int i;
+
+	for (i = 0; i < ctx->macro_count; i++) {
+		mem_free(ctx->macro_tbl[i].name);
+		free_command_table(ctx->macro_tbl[i].body, ctx->macro_tbl[i].body_size);
+	}
+	mem_free(ctx->macro_tbl);
+
+	ctx->macro_tbl = NULL;
+	ctx->macro_count = 0;
+	ctx->macro_alloc = 0;
+	ctx->cur_macro = NULL;
+}
+
+/*
+ * Intern a name.
+ *  - Tag and property names are a small set repeated in every command,
+ *    so each name is stored once until the module is cleaned up.
+ */
+static const char *intern_name(const char *name)
+{
+	char **new_tbl;
+	uint64_t h;
+	int new_size, i, j;
+
+	/* Grow the table to keep it half empty. */
+	if ((name_count + 1) * 2 > name_tbl_size) {
+		new_size = name_tbl_size == 0 ? 256 : name_tbl_size * 2;
+		new_tbl = mem_calloc(MEM_SCENARIO, (size_t)new_size, sizeof(char *));
+		if (new_tbl == NULL) {
+			api_out_of_memory();
+			return NULL;
+		}
+		for (i = 0; i < name_tbl_size; i++) {
+			if (name_tbl[i] == NULL)
+				continue;
+			j = (int)(common_hash64(name_tbl[i], strlen(name_tbl[i])) & (uint64_t)(new_size - 1));
+			while (new_tbl[j] != NULL)
+				j = (j + 1) & (new_size - 1);
+			new_tbl[j] = name_tbl[i];
+		}
+		mem_free(name_tbl);
+		name_tbl = new_tbl;
+		name_tbl_size = new_size;
+	}
+
+	h = common_hash64(name, strlen(name));
+	for (i = (int)(h & (uint64_t)(name_tbl_size - 1));
+	     name_tbl[i] != NULL;
+	     i = (i + 1) & (name_tbl_size - 1)) {
+		if (strcmp(name_tbl[i], name) == 0)
+			return name_tbl[i];
+	}
+
+	name_tbl[i] = mem_strdup(MEM_SCENARIO, name);
+	if (name_tbl[i] == NULL) {
+		api_out_of_memory();
+		return NULL;
+	}
+	name_count++;
+
+	return name_tbl[i];
+}
+
+/* Free the interned names. */
+static void free_names(void)
+{
+	int i;
+
+	for (i = 0; i < name_tbl_size; i++)
+		mem_free(name_tbl[i]);
+	mem_free(name_tbl);
+	name_tbl = NULL;
+	name_count = 0;
+	name_tbl_size = 0;
+}
+
+/*
+ * Make the string table keys of a command.
+ *  - The key of "text" is the hash of the ID, and the key of another
+ *    property is the hash of "<ID>.<property>".
+ *  - Hashing at load time keeps the dispatch to a single lookup.
+ */
+static bool make_loc_keys(struct command *c)
+{
+	uint64_t id_hash;
+	int i;
+
+	/* Find the ID. */
+	for (i = 0; i < c->prop_count; i++) {
+		if (strcmp(c->prop_name[i], LOC_ID_PROP) == 0)
+			break;
+	}
+	if (i == c->prop_count)
+		return true;
+	id_hash = strtab_hash(STRTAB_HASH_INIT, c->prop_value[i]);
+
+	c->loc_key = mem_calloc(MEM_SCENARIO, (size_t)c->prop_count, sizeof(uint64_t));
+	c->loc_interp = mem_calloc(MEM_SCENARIO, (size_t)c->prop_count, sizeof(struct interp *));
+	if (c->loc_key == NULL || c->loc_interp == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+
+	for (i = 0; i < c->prop_count; i++) {
+		if (strcmp(c->prop_name[i], LOC_ID_PROP) == 0)
+			continue;
+		if (strcmp(c->prop_name[i], LOC_TEXT_PROP) == 0)
+			c->loc_key[i] = id_hash;
+		else
+			c->loc_key[i] = strtab_hash(strtab_hash(id_hash, "."), c->prop_name[i]);
+	}
+
+	return true;
+}
+
+/*
+ * Compile the property values that have variable references.
+ *  - Values without references are passed as is.
+ */
+static bool compile_props(struct command *c)
+{
+	int i;
+
+	for (i = 0; i < c->prop_count; i++) {
+		if (!interp_has_vars(c->prop_value[i]))
+			continue;
+
+		if (c->interp == NULL) {
+			c->interp = mem_calloc(MEM_SCENARIO, (size_t)c->prop_count, sizeof(struct interp *));
+			if (c->interp == NULL) {
+				api_out_of_memory();
+				return false;
+			}
+		}
+
+		c->interp[i] = interp_compile(c->prop_value[i]);
+		if (c->interp[i] == NULL)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Bind a command to a native tag.
+ *  - Values without variable references are converted here. A value
+ *    that doesn't convert is reported when the tag runs, because the
+ *    executive may override the tag.
+ */
+static bool bind_native(struct command *c)
+{
+	struct native_arg *a;
+	int count, i, j;
+
+	c->native = tag_find(c->tag_name);
+	if (c->native < 0)
+		return true;
+
+	count = tag_get_prop_count(c->native);
+	if (count == 0)
+		return true;
+
+	c->native_args = mem_calloc(MEM_SCENARIO, (size_t)count, sizeof(struct native_arg));
+	if (c->native_args == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+
+	for (i = 0; i < count; i++) {
+		a = &c->native_args[i];
+		a->prop = -1;
+		for (j = 0; j < c->prop_count; j++) {
+			if (strcmp(c->prop_name[j], tag_get_prop_name(c->native, i)) == 0) {
+				a->prop = j;
+				break;
+			}
+		}
+		if (a->prop < 0 || is_dynamic_prop(c, a->prop))
+			continue;
+		a->is_valid = tag_convert(c->native, i, c->prop_value[a->prop], &a->value);
+	}
+
+	return true;
+}
+
+/*
+ * Move long property values to the text store.
+ *  - Values compiled for variable references are kept because the
+ *    compiled segments point to them. IDs and labels are kept for
+ *    the lookups, and values of native tags for the typed values.
+ */
+static bool pack_props(struct command *c)
+{
+	size_t len;
+	int i;
+
+	if (strcmp(c->tag_name, LABEL_TAG) == 0 || c->native >= 0)
+		return true;
+
+	for (i = 0; i < c->prop_count; i++) {
+		if (c->interp != NULL && c->interp[i] != NULL)
+			continue;
+		if (strcmp(c->prop_name[i], LOC_ID_PROP) == 0)
+			continue;
+		len = strlen(c->prop_value[i]);
+		if (len < PACK_MIN_LEN || len >= TEXTSTORE_STRING_MAX)
+			continue;
+
+		if (c->text_ref == NULL) {
+			c->text_ref = mem_calloc(MEM_SCENARIO, (size_t)c->prop_count, sizeof(uint32_t));
+			if (c->text_ref == NULL) {
+				api_out_of_memory();
+				return false;
+			}
+		}
+
+		if (!textstore_add(ctx->text, c->prop_value[i], &c->text_ref[i]))
+			return false;
+		mem_free(c->prop_value[i]);
+		c->prop_value[i] = NULL;
+	}
+
+	return true;
+}
+
+#if defined(USE_HOT_RELOAD)
+/*
+ * Reload the current scenario file if it was modified. (development builds only)
+ *  - The position is kept by the nearest label before the current
+ *    command and the offset from it. If the command at the mapped
+ *    position is different, the same command is searched for.
+ */
+bool scenario_reload_if_modified(struct rt_env *rt)
+{
+	struct command *old_cmd;
+	struct textstore *old_text;
+	const char *label;
+	uint32_t anchor;
+	int old_size, old_alloc, old_index;
+	int label_index, offset, begin, end, hint, index, i;
 
-/* Current command index. */
-__attribute__((unused))
-static int cur_index;
+	UNUSED_PARAMETER(rt);
 
-/* Command table. */
-__attribute__((unused))
-static struct command cmd[COMMAND_MAX];
+	if (ctx->cur_file == NULL || !hotreload_is_modified(ctx->cur_file))
+		return true;
 
-/* Command size. */
-static int cmd_size;
+	/* Remember the position. */
+	label_index = find_label_before(ctx->cur_index);
+	label = label_index >= 0 ? ctx->cmd[label_index].prop_value[0] : NULL;
+	offset = ctx->cur_index - (label_index >= 0 ? label_index : 0);
+	anchor = ctx->cur_index < ctx->cmd_size ? hash_command(&ctx->cmd[ctx->cur_index]) : 0;
+	old_index = ctx->cur_index;
 
-/* Forward declaration. */
-static void destroy_commands(void);
-static void print_error(struct rt_env *rt);
-static bool parse_tag_callback(const char *name, int props, const char **prop_name, const char **prop_val);
-static bool parse_tag_document(const char *doc, bool (*callback)(const char *, int, const char **, const char **), char **error_msg, int *error_line);
+	/* Parse into a new table and keep the old one for errors. */
+	old_cmd = ctx->cmd;
+	old_size = ctx->cmd_size;
+	old_alloc = ctx->cmd_alloc;
+	old_text = ctx->text;
+	ctx->cmd = NULL;
+	ctx->cmd_size = 0;
+	ctx->cmd_alloc = 0;
+	ctx->text = NULL;
+	if (!load_commands(ctx->cur_file)) {
+		/* Keep running the old commands while the file is broken. */
+		free_command_table(ctx->cmd, ctx->cmd_size);
+		textstore_destroy(ctx->text);
+		ctx->cmd = old_cmd;
+		ctx->cmd_size = old_size;
+		ctx->cmd_alloc = old_alloc;
+		ctx->text = old_text;
+		return false;
+	}
+
+	/* Map the position through the label. */
+	begin = 0;
+	end = ctx->cmd_size;
+	hint = old_index;
+	if (label != NULL && (index = find_label(label)) >= 0) {
+		begin = index;
+		for (i = index + 1; i < ctx->cmd_size; i++) {
+			if (strcmp(ctx->cmd[i].tag_name, LABEL_TAG) == 0) {
+				end = i;
+				break;
+			}
+		}
+		hint = index + offset;
+	}
+
+	/* Find the same command near the mapped position. */
+	index = -1;
+	if (old_index < old_size) {
+		index = find_anchor(anchor, begin, end, hint);
+		if (index < 0)
+			index = find_anchor(anchor, 0, ctx->cmd_size, hint);
+	}
+	if (index < 0)
+		index = hint < end ? hint : end - 1;
+	ctx->cur_index = index > 0 ? index : 0;
+
+	free_command_table(old_cmd, old_size);
+	textstore_destroy(old_text);
+	ctx->param_root_stale = true;
+
+	return true;
+}
+
+/* Find the label at or before an index. */
+static int find_label_before(int index)
+{
+	int i;
+
+	for (i = index < ctx->cmd_size ? index : ctx->cmd_size - 1; i >= 0; i--) {
+		if (strcmp(ctx->cmd[i].tag_name, LABEL_TAG) == 0 &&
+		    ctx->cmd[i].prop_count > 0 &&
+		    strcmp(ctx->cmd[i].prop_name[0], LABEL_PROP) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Find a label by name. */
+static int find_label(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ctx->cmd_size; i++) {
+		if (strcmp(ctx->cmd[i].tag_name, LABEL_TAG) == 0 &&
+		    ctx->cmd[i].prop_count > 0 &&
+		    strcmp(ctx->cmd[i].prop_name[0], LABEL_PROP) == 0 &&
+		    strcmp(ctx->cmd[i].prop_value[0], name) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Hash a command content. (FNV-1a) */
+static uint32_t hash_command(const struct command *c)
+{
+	const char *s;
+	uint32_t h;
+	int i;
+
+	h = 2166136261U;
+	for (s = c->tag_name; *s != '\0'; s++)
+		h = (h ^ (uint8_t)*s) * 16777619U;
+	for (i = 0; i < c->prop_count; i++) {
+		for (s = c->prop_name[i]; *s != '\0'; s++)
+			h = (h ^ (uint8_t)*s) * 16777619U;
+		h = (h ^ '=') * 16777619U;
+		s = get_raw_value(c, i);
+		for (; s != NULL && *s != '\0'; s++)
+			h = (h ^ (uint8_t)*s) * 16777619U;
+	}
+
+	return h;
+}
+
+/* Find a command with a hash in a range, nearest to a hint index. */
+static int find_anchor(uint32_t anchor, int begin, int end, int hint)
+{
+	int d, i;
+
+	for (d = 0; d < end - begin; d++) {
+		i = hint - d;
+		if (i >= begin && i < end && hash_command(&ctx->cmd[i]) == anchor)
+			return i;
+		i = hint + d;
+		if (d > 0 && i >= begin && i < end && hash_command(&ctx->cmd[i]) == anchor)
+			return i;
+	}
+
+	return -1;
+}
+#endif
 
 /*
- * Initialize the scenario module.
+ * Run tags until a tag sets a wait.
  */
-bool scenario_init(void)
+bool scenario_run(struct rt_env *rt)
 {
-	destroy_commands();
+	int i;
+
+	for (i = 0; i < RUN_TAG_MAX; i++) {
+		if (wait_is_set() || ctx->cur_index >= ctx->cmd_size)
+			break;
+		if (!scenario_run_tag(rt))
+			return false;
+	}
 
 	return true;
 }
 
 /*
- * Cleanup the scenario module.
+ * Check if the scenario ran to the end.
  */
-void scenario_cleanup(void)
+bool scenario_is_end(void)
 {
-	destroy_commands();
+	return ctx->cur_index >= ctx->cmd_size;
 }
 
-static void destroy_commands(void)
+/*
+ * Get the current scenario file, or NULL.
+ */
+const char *scenario_get_file(void)
+{
+	return ctx->cur_file;
+}
+
+/*
+ * Get the current command index.
+ */
+int scenario_get_index(void)
+{
+	return ctx->cur_index;
+}
+
+/*
+ * Get the number of commands.
+ */
+int scenario_get_command_count(void)
+{
+	return ctx->cmd_size;
+}
+
+/*
+ * Get the tag name of a command.
+ */
+const char *scenario_get_tag_name(int index)
+{
+	assert(index >= 0 && index < ctx->cmd_size);
+
+	return ctx->cmd[index].tag_name;
+}
+
+/*
+ * Get the source line of a command.
+ */
+int scenario_get_line(int index)
+{
+	assert(index >= 0 && index < ctx->cmd_size);
+
+	return ctx->cmd[index].line;
+}
+
+/*
+ * Get the number of properties of a command.
+ */
+int scenario_get_prop_count(int index)
+{
+	assert(index >= 0 && index < ctx->cmd_size);
+
+	return ctx->cmd[index].prop_count;
+}
+
+/*
+ * Get a property name of a command.
+ */
+const char *scenario_get_prop_name(int index, int prop)
+{
+	assert(index >= 0 && index < ctx->cmd_size);
+	assert(prop >= 0 && prop < ctx->cmd[index].prop_count);
+
+	return ctx->cmd[index].prop_name[prop];
+}
+
+/*
+ * Get a property value of a command as written.
+ */
+const char *scenario_get_raw_value(int index, int prop)
+{
+	assert(index >= 0 && index < ctx->cmd_size);
+	assert(prop >= 0 && prop < ctx->cmd[index].prop_count);
+
+	return get_raw_value(&ctx->cmd[index], prop);
+}
+
+/*
+ * Get the dispatch statistics.
+ */
+void scenario_get_stats(struct scenario_stats *ret)
+{
+	ret->native_count = ATOMIC_LOAD(&stats.native_count);
+	ret->script_count = ATOMIC_LOAD(&stats.script_count);
+}
+
+/* Count a dispatch that the other thread may read. */
+static void add_stat(uint64_t *counter)
+{
+	ATOMIC_ADD(counter, 1);
+}
+
+/*
+ * Check if frames can run at the idle frame rate.
+ *  - Gets the time the wait ends, or 0.
+ */
+bool scenario_can_idle(uint64_t *deadline)
+{
+	if (wait_is_set())
+		return wait_is_idle(deadline);
+
+	*deadline = 0;
+	return scenario_is_end();
+}
+
+/*
+ * Run a tag.
+ *  - Moves to the next tag unless the tag changed the position.
+ */
+bool scenario_run_tag(struct rt_env *rt)
 {
 	struct command *c;
-	int i, j;
+	bool succeeded, api_failed, is_native;
+#if defined(USE_DISPATCH_TIMING)
+	uint64_t start_usec;
+#endif
+
+	/* End of the scenario. */
+	if (ctx->cur_index >= ctx->cmd_size)
+		return true;
+
+	c = &ctx->cmd[ctx->cur_index];
 
-	cur_index = 0;
+	/* A tag may change the screen. */
+	idle_notify_activity();
 
-	if (cur_file != NULL) {
-		free(cur_file);
-		cur_file = NULL;
+	/* Start a rollback entry. Variable changes by the tag go to it. */
+	if (!rollback_begin_tag(ctx->cur_file, ctx->cur_index)) {
+		sys_error("%s\n", api_get_error_message());
+		return false;
 	}
 
-	for (i = 0; i < cmd_size; i++) {
-		c = &cmd[i];
-		free(c->tag_name);
-		for (j = 0; j < PROP_MAX; j++) {
-			if (c->prop_name[i] != NULL) {
-				free(c->prop_name[i]);
-				c->prop_name[i] = NULL;
-			}
-			if (c->prop_value[i] != NULL) {
-				free(c->prop_value[i]);
-				c->prop_value[i] = NULL;
-			}
-		}
+#if defined(USE_DISPATCH_TIMING)
+	start_usec = common_get_usec();
+#endif
+
+	api_failed = false;
+	is_native = c->native >= 0 && tag_is_native(c->native);
+	if (is_native) {
+		/* Run the native handler without making runtime values. */
+		ctx->is_moved = false;
+		succeeded = run_native(c);
+		api_failed = true;
+		add_stat(&stats.native_count);
+	} else {
+		/* Call the function of the tag. A script call makes garbage. */
+		gc_notify_tag();
+		succeeded = run_script(rt, c, &api_failed);
+		add_stat(&stats.script_count);
+	}
+
+	/* If failed: */
+	if (!succeeded) {
+		if (api_failed)
+			sys_error("%s\n", api_get_error_message());
+		else
+			print_error(rt);
+		return false;
 	}
+
+#if defined(USE_DISPATCH_TIMING)
+	/* Log the average dispatch times to compare builds and paths. */
+	if (is_native)
+		native_usec += common_get_usec() - start_usec;
+	else
+		script_usec += common_get_usec() - start_usec;
+	if ((stats.native_count + stats.script_count) % DISPATCH_LOG_INTERVAL == 0) {
+		printf("dispatch: native %llu tags, %.3f us/tag, script %llu tags, %.3f us/tag\n",
+		       (unsigned long long)stats.native_count,
+		       stats.native_count > 0 ? (double)native_usec / (double)stats.native_count : 0.0,
+		       (unsigned long long)stats.script_count,
+		       stats.script_count > 0 ? (double)script_usec / (double)stats.script_count : 0.0);
+	}
+#endif
+
+	/* Go to the next tag. */
+	if (!ctx->is_moved)
+		ctx->cur_index++;
+
+	/* Ok. */
+	return true;
 }
 
 /*
- * Load a scenario file and move to it.
+ * Prepare the parameter dictionary of a command.
+ *  - A command without variable references or localized strings gets
+ *    the dictionary made at an earlier run, so that running it again
+ *    makes no garbage. Other commands get a new dictionary at every
+ *    run, so that a dictionary never changes after it is passed.
+ *  - The last PARAM_CACHE_SIZE cached dictionaries are kept alive by a
+ *    global dictionary keyed by the ring slot. The oldest one is dropped
+ *    for a new one, and made again at the next run of its command. A
+ *    handler that keeps its parameter in a variable holds an ordinary
+ *    reference, which stays valid after the cache drops it.
+ *  - Handlers must not modify their parameter.
  */
-bool scenario_move_to_file(struct rt_env *rt, const char *file)
+static bool prepare_param_dict(struct rt_env *rt, struct command *c, struct rt_value *param, bool *api_failed)
 {
-	char *buf;
-	char *error_message;
-	int error_line;
+	char key[16];
+	int owner, i;
 
-	UNUSED_PARAMETER(rt);
+	/* Make a new root for a new command table. */
+	if (ctx->param_root_stale) {
+		if (!rt_make_empty_dict(rt, &ctx->param_root))
+			return false;
+		if (!rt_set_global(rt, PARAM_ROOT_GLOBAL, &ctx->param_root))
+			return false;
+		for (i = 0; i < PARAM_CACHE_SIZE; i++)
+			ctx->param_owner[i] = -1;
+		ctx->param_next = 0;
+		ctx->param_root_stale = false;
+	}
 
-	if (!common_load_file_content(file, &buf))
-		return false;
+	/* Pass a new dictionary if a value may change. */
+	for (i = 0; i < c->prop_count; i++) {
+		if (is_dynamic_prop(c, i))
+			return make_param_dict(rt, c, param, api_failed);
+	}
 
-	destroy_commands();
+	/* Reuse the cached dictionary. */
+	if (c->param_cached) {
+		*param = c->param;
+		return true;
+	}
 
-	if (!parse_tag_document(buf, parse_tag_callback, &error_message, &error_line)) {
-		api_error("tag error: %s:%d: %s", file, error_line, error_message);
-		free(error_message);
-		free(buf);
+	if (!make_param_dict(rt, c, &c->param, api_failed))
 		return false;
-	}
 
-	free(buf);
+	/* Put it in the next slot, and drop the oldest one in the slot. */
+	owner = ctx->param_owner[ctx->param_next];
+	if (owner >= 0)
+		ctx->cmd[owner].param_cached = false;
+	snprintf(key, sizeof(key), "%d", ctx->param_next);
+	if (!rt_set_dict_elem(rt, &ctx->param_root, key, &c->param))
+		return false;
+	ctx->param_owner[ctx->param_next] = (int)(c - ctx->cmd);
+	ctx->param_next = (ctx->param_next + 1) % PARAM_CACHE_SIZE;
+	c->param_cached = true;
+
+	*param = c->param;
 
 	return true;
 }
 
-/* Callback for when a tag is read. */
-static bool parse_tag_callback(const char *name, int props, const char **prop_name, const char **prop_value)
+/* Make a dictionary of the properties of a command. */
+static bool make_param_dict(struct rt_env *rt, struct command *c, struct rt_value *dict, bool *api_failed)
 {
-	struct command *c;
+	struct rt_value str;
+	const char *value;
 	int i;
 
-	/* If command table is full. */
-	if (cmd_size >= COMMAND_MAX) {
-		api_error("Too many commands.");
+	if (!rt_make_empty_dict(rt, dict))
 		return false;
+
+	for (i = 0; i < c->prop_count; i++) {
+		value = get_prop_value(c, i);
+		if (value == NULL) {
+			*api_failed = true;
+			return false;
+		}
+		if (!rt_make_string(rt, &str, value))
+			return false;
+		if (!rt_set_dict_elem(rt, dict, c->prop_name[i], &str))
+			return false;
 	}
 
-	c = &cmd[cmd_size++];
-	c->prop_count = props;
+	return true;
+}
+
+/* Call the function of a tag with the parameter dictionary. */
+static bool run_script(struct rt_env *rt, struct command *c, bool *api_failed)
+{
+	struct rt_value param, ret;
 
-	/* Copy a tag name. */
-	c->tag_name = strdup(name);
-	if (c->tag_name == NULL) {
-		api_out_of_memory();
+	/* Get the parameter dictionary. */
+	if (!prepare_param_dict(rt, c, &param, api_failed))
 		return false;
-	}
 
-	/* Copy properties. */
-	for (i = 0; i < props; i++) {
-		c->prop_name[i] = strdup(prop_name[i]);
-		if (c->prop_name[i] == NULL) {
-			api_out_of_memory();
-			return false;
+	/* Call the corresponding function. */
+	ctx->is_moved = false;
+	if (!rt_call_with_name(rt, c->tag_name, NULL, 1, &param, &ret))
+		return false;
+
+	return true;
+}
+
+/*
+ * Run a native tag.
+ *  - Values with variable references are converted every run.
+ */
+static bool run_native(struct command *c)
+{
+	struct tag_value args[TAG_PROP_MAX];
+	struct native_arg *a;
+	const char *value;
+	int count, i;
+
+	count = tag_get_prop_count(c->native);
+	assert(count <= TAG_PROP_MAX);
+
+	for (i = 0; i < count; i++) {
+		a = &c->native_args[i];
+		if (a->prop < 0) {
+			memset(&args[i], 0, sizeof(args[i]));
+			continue;
+		}
+		if (a->is_valid && !is_dynamic_prop(c, a->prop)) {
+			args[i] = a->value;
+			continue;
 		}
 
-		c->prop_value[i] = strdup(prop_value[i]);
-		if (c->prop_value[i] == NULL) {
-			api_out_of_memory();
+		/* Convert again to get the value or the error. */
+		value = get_prop_value(c, a->prop);
+		if (value == NULL)
+			return false;
+		if (!tag_convert(c->native, i, value, &args[i]))
 			return false;
-		}
 	}
 
-	return true;
+	return tag_call(c->native, args);
+}
+
+/* Check if a property value may change between runs. */
+static bool is_dynamic_prop(struct command *c, int index)
+{
+	if (c->interp != NULL && c->interp[index] != NULL)
+		return true;
+	if (c->loc_key != NULL && c->loc_key[index] != 0)
+		return true;
+
+	return false;
 }
 
 /*
- * Run a tag.
- *  - cont ... set to true if a next tag is requied to be run continuously.
+ * Get a property value to pass.
+ *  - The localized string is used if the string table has it.
+ *  - Variable references are rendered into a shared buffer that is
+ *    valid until the next call.
  */
-bool scenario_run_tag(struct rt_env *rt)
+static const char *get_prop_value(struct command *c, int index)
 {
-	struct command *c;
-	struct rt_value dict;
-	struct rt_value str;
-	struct rt_value ret;
+	struct interp *ip;
+	const char *loc;
+	uint32_t gen;
 	int i;
-	bool succeeded;
-
-	assert(cur_index < cmd_size);
 
-	c = &cmd[cur_index];
+	ip = c->interp != NULL ? c->interp[index] : NULL;
 
-	succeeded = false;
-	do {
-		/* Make a parameter dictionary. */
-		if (!rt_make_empty_dict(rt, &dict))
-			break;
+	if (c->loc_key != NULL && c->loc_key[index] != 0 &&
+	    (loc = strtab_lookup(c->loc_key[index])) != NULL) {
+		/* Drop the strings compiled for the previous language. */
+		gen = strtab_get_generation();
+		if (c->loc_gen != gen) {
+			for (i = 0; i < c->prop_count; i++) {
+				interp_free(c->loc_interp[i]);
+				c->loc_interp[i] = NULL;
+			}
+			c->loc_gen = gen;
+		}
 
-		/* Setup properties as dictionary items. */
-		for (i = 0; i < c->prop_count; i++) {
-			if (!rt_make_string(rt, &str, c->prop_value[i]))
-				break;
-			if (!rt_set_dict_elem(rt, &dict, c->prop_name[i], &str))
-				break;
+		/* Compile at the first use in this language. */
+		if (c->loc_interp[index] == NULL) {
+			c->loc_interp[index] = interp_compile(loc);
+			if (c->loc_interp[index] == NULL)
+				return NULL;
 		}
+		ip = c->loc_interp[index];
+	}
 
-		/* Call the corresponding function. */
-		if (!rt_call_with_name(rt, c->tag_name, NULL, 1, &dict, &ret))
-			break;
+	if (ip == NULL)
+		return get_raw_value(c, index);
 
-		/* Ok. */
-		succeeded = true;
-	} while (0);
+	return interp_render(ip);
+}
 
-	/* If failed: */
-	if (!succeeded) {
-		print_error(rt);
+/*
+ * Get a property value as written.
+ *  - A stored value is valid until the next read of the text store.
+ */
+static const char *get_raw_value(const struct command *c, int index)
+{
+	if (c->prop_value[index] != NULL)
+		return c->prop_value[index];
+
+	return textstore_get(ctx->text, c->text_ref[index]);
+}
+
+/*
+ * Rewind tags.
+ *  - The count includes the running tag.
+ */
+bool scenario_rewind(struct rt_env *rt, int count)
+{
+	const char *file;
+	int index;
+
+	if (!rollback_rewind(count, &file, &index))
+		return false;
+
+	/* Load the file if the target is in another file. */
+	if (ctx->cur_file == NULL || strcmp(file, ctx->cur_file) != 0) {
+		if (!scenario_move_to_file(rt, file))
+			return false;
+	}
+
+	if (index >= ctx->cmd_size) {
+		api_error("Cannot rewind to %s:%d.", file, index);
 		return false;
 	}
+	ctx->cur_index = index;
+	ctx->is_moved = true;
+
+	/* Drop the wait of the undone tag. */
+	wait_cancel();
 
-	/* Ok. */
 	return true;
 }
 
@@ -229,6 +1684,17 @@ static void print_error(struct rt_env *rt)
 		  rt_get_error_file(rt),
 		  rt_get_error_line(rt),
 		  rt_get_error_message(rt));
+
+	/* Show the tag position. */
+	if (ctx->cur_file != NULL && ctx->cur_index < ctx->cmd_size) {
+		if (ctx->cmd[ctx->cur_index].call_line > 0) {
+			sys_error(_("%s:%d: note: in a macro called at line %d\n"),
+				  ctx->cur_file, ctx->cmd[ctx->cur_index].line, ctx->cmd[ctx->cur_index].call_line);
+		} else {
+			sys_error(_("%s:%d: note: in this tag\n"),
+				  ctx->cur_file, ctx->cmd[ctx->cur_index].line);
+		}
+	}
 }
 
 /*
@@ -248,31 +1714,45 @@ enum state {
 bool
 parse_tag_document(
 	const char *doc,
-	bool (*callback)(const char *, int, const char **, const char **),
+	bool (*callback)(const char *, int, const char **, const char **, int),
 	char **error_msg,
 	int *error_line)
 {
-	static char tag_name[TAG_NAME_MAX];
-	static char prop_name[PROP_MAX][PROP_NAME_MAX];
-	static char prop_val[PROP_MAX][PROP_VALUE_MAX];
-
+	char *tag_name;
+	char (*prop_name)[PROP_NAME_MAX];
+	char (*prop_val)[PROP_VALUE_MAX];
 	const char *top;
 	char c;
 	int state;
 	int line;
+	int tag_line;
 	int len;
 	int prop_count;
 	char *prop_name_tbl[PROP_MAX];
 	char *prop_val_tbl[PROP_MAX];
 	int i;
 
+	if (ctx->scratch == NULL) {
+		ctx->scratch = mem_alloc(MEM_PARSER, sizeof(struct parser_scratch));
+		if (ctx->scratch == NULL) {
+			*error_msg = strdup(_("Out of memory."));
+			*error_line = 0;
+			return false;
+		}
+	}
+	tag_name = ctx->scratch->tag_name;
+	prop_name = ctx->scratch->prop_name;
+	prop_val = ctx->scratch->prop_val;
+
 	for (i = 0; i < PROP_MAX; i++) {
 		prop_name_tbl[i] = &prop_name[i][0];
 		prop_val_tbl[i] = &prop_val[i][0];
 	}
 
 	top = doc;
+	state = ST_INIT;
 	line = 1;
+	tag_line = 1;
 	len = 0;
 	prop_count = 0;
 	while (*top != '\0') {
@@ -281,7 +1761,9 @@ parse_tag_document(
 		case ST_INIT:
 			if (c == '[') {
 				state = ST_TAGNAME;
+				tag_line = line;
 				len = 0;
+				prop_count = 0;
 				continue;
 			}
 			if (c == '\n') {
@@ -308,9 +1790,9 @@ parse_tag_document(
 			}
 			if (c == ']') {
 				tag_name[len] = '\0';
-				if (!callback(tag_name, 0, NULL, NULL)) {
-					*error_msg = strdup(_("Too many properties."));
-					*error_line = line;
+				if (!callback(tag_name, 0, NULL, NULL, tag_line)) {
+					*error_msg = strdup(api_get_error_message());
+					*error_line = tag_line;
 					return false;
 				}
 				state = ST_INIT;
@@ -332,9 +1814,9 @@ parse_tag_document(
 			if (len == 0 && c == ' ')
 				continue;
 			if (len == 0 && c == ']') {
-				if (!callback(tag_name, prop_count, (const char **)prop_name_tbl, (const char **)prop_val_tbl)) {
-					*error_msg = strdup(_("Internal error."));
-					*error_line = line;
+				if (!callback(tag_name, prop_count, (const char **)prop_name_tbl, (const char **)prop_val_tbl, tag_line)) {
+					*error_msg = strdup(api_get_error_message());
+					*error_line = tag_line;
 					return false;
 				}
 				state = ST_INIT;
@@ -418,6 +1900,8 @@ parse_tag_document(
 				*error_line = line;
 				return false;
 			}
+			if (c == '\n')
+				line++;
 			prop_val[prop_count][len++] = c;
 			continue;
 		default:
@@ -14,9 +14,68 @@
 
 #include "compat.h"
 
+/*
+ * Scenario instance.
+ *  - An instance has a file, a position and a command table. The
+ *    engine runs the main instance. Tools can make parse-only instances
+ *    to load files and read their command tables.
+ *  - The functions below act on the current instance, which is shared
+ *    by all threads. The module is used by one thread at a time.
+ */
+struct scenario_context;
+
+/* Dispatch statistics. */
+struct scenario_stats {
+	uint64_t native_count;
+	uint64_t script_count;
+};
+
 bool scenario_init(void);
 void scenario_cleanup(void);
+
+/* Create an instance. */
+struct scenario_context *scenario_create_context(void);
+
+/* Destroy an instance that is not current. */
+void scenario_destroy_context(struct scenario_context *c);
+
+/* Make an instance current, or the main one with NULL. Returns the previous one. */
+struct scenario_context *scenario_switch_context(struct scenario_context *c);
+
 bool scenario_move_to_file(struct rt_env *rt, const char *file);
+
+/*
+ * Parse a scenario file ahead of the first move to it. (startup only)
+ *  - May run on a worker while the main thread doesn't use this module.
+ */
+bool scenario_prefetch(const char *file);
+
+bool scenario_run(struct rt_env *rt);
+bool scenario_is_end(void);
+bool scenario_can_idle(uint64_t *deadline);
+const char *scenario_get_file(void);
+int scenario_get_index(void);
+
+/*
+ * Read the command table. (for tools)
+ *  - A raw value is valid until the next call.
+ */
+int scenario_get_command_count(void);
+const char *scenario_get_tag_name(int index);
+int scenario_get_line(int index);
+int scenario_get_prop_count(int index);
+const char *scenario_get_prop_name(int index, int prop);
+const char *scenario_get_raw_value(int index, int prop);
+
 bool scenario_run_tag(struct rt_env *rt);
+bool scenario_rewind(struct rt_env *rt, int count);
+
+/* Get the dispatch statistics. (any thread) */
+void scenario_get_stats(struct scenario_stats *stats);
+
+#if defined(USE_HOT_RELOAD)
+/* Reload the current scenario file if it was modified. (development builds only) */
+bool scenario_reload_if_modified(struct rt_env *rt);
+#endif
 
 #endif
@@ -0,0 +1,236 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * scriptcache.c: Compiled script cache.
+ *  - A cache file is the header below followed by the Linguine bytecode
+ *    of a source file. It is keyed by the hash of the source text, so
+ *    an edited script is compiled again.
+ *  - The header also has the hash of the runtime version, because the
+ *    bytecode format may change between Linguine versions. The build
+ *    defines SCRIPT_CACHE_RUNTIME as the version of the Linguine it
+ *    links. (build/linux uses the Linguine commit and the checksum of
+ *    the library)
+ *  - Cache loads and compilations are timed for the startup log.
+ *  - Cache files are searched in the package too, so that a release can
+ *    ship the caches made on a development machine.
+ *  - The bytecode is taken from and given to Linguine through
+ *    rt_get_bytecode() and rt_register_bytecode().
+ */
+
+#include "novelkit.h"
+
+#if defined(USE_SCRIPT_CACHE)
+#if defined(TARGET_WINDOWS)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#endif
+
+/* Header values. */
+#define CACHE_MAGIC	"NKSC"
+#define CACHE_VERSION	2
+
+/* Runtime version that made the bytecode. */
+#if defined(USE_SCRIPT_CACHE) && !defined(SCRIPT_CACHE_RUNTIME)
+#error "Define SCRIPT_CACHE_RUNTIME as the Linguine version."
+#endif
+
+/* Cache file header. (32 bytes) */
+struct cache_header {
+	char magic[4];
+	uint32_t version;
+	uint64_t source_hash;
+	uint64_t runtime_hash;
+	uint32_t size;
+	uint32_t reserved;
+};
+
+/* Statistics. */
+static struct scriptcache_stats stats;
+
+#if defined(USE_SCRIPT_CACHE)
+/* Forward declarations. */
+static bool load_cache(struct rt_env *rt, const char *path, uint64_t hash, bool *loaded);
+static void save_cache(struct rt_env *rt, const char *file, const char *path, uint64_t hash);
+static uint64_t runtime_hash(void);
+#endif
+
+/*
+ * Register a script to a runtime.
+ */
+bool scriptcache_register(struct rt_env *rt, const char *file, const char *source)
+{
+#if defined(USE_SCRIPT_CACHE)
+	char path[1024];
+	uint64_t hash, start;
+	bool loaded;
+
+	start = common_get_usec();
+
+	snprintf(path, sizeof(path), "%s/%sc", SCRIPT_CACHE_DIR, file);
+	hash = common_hash64(source, strlen(source));
+
+	/* Use the cache if it is up to date. */
+	if (!load_cache(rt, path, hash, &loaded))
+		return false;
+	if (loaded) {
+		stats.hits++;
+		stats.load_usec += common_get_usec() - start;
+		return true;
+	}
+
+	/* Compile the source. */
+	if (!rt_register_source(rt, file, source))
+		return false;
+
+	/* Update the cache. Failures are not fatal. (e.g., read-only storage) */
+	save_cache(rt, file, path, hash);
+
+	stats.misses++;
+	stats.compile_usec += common_get_usec() - start;
+
+	return true;
+#else
+	uint64_t start;
+
+	start = common_get_usec();
+	if (!rt_register_source(rt, file, source))
+		return false;
+	stats.misses++;
+	stats.compile_usec += common_get_usec() - start;
+
+	return true;
+#endif
+}
+
+/*
+ * Get the statistics.
+ */
+void scriptcache_get_stats(struct scriptcache_stats *ret)
+{
+	*ret = stats;
+}
+
+#if defined(USE_SCRIPT_CACHE)
+/* Load a cache file if it matches the source hash. */
+static bool load_cache(struct rt_env *rt, const char *path, uint64_t hash, bool *loaded)
+{
+	const struct package_entry *e;
+	struct file_view view;
+	struct cache_header h;
+	uint8_t *bytecode;
+	uint32_t size;
+	FILE *fp;
+
+	*loaded = false;
+
+	/* A missing cache file is normal. Don't let MediaKit report it. */
+	e = package_find(path);
+	if (e == NULL) {
+		fp = fopen(path, "rb");
+		if (fp == NULL)
+			return true;
+		fclose(fp);
+	}
+
+	if (!common_open_file_view(path, &view))
+		return true;
+
+	/* Check the header. */
+	if (view.size < sizeof(h)) {
+		common_close_file_view(&view);
+		return true;
+	}
+	memcpy(&h, view.data, sizeof(h));
+	size = LETOHOST32(h.size);
+	if (memcmp(h.magic, CACHE_MAGIC, 4) != 0 ||
+	    LETOHOST32(h.version) != CACHE_VERSION ||
+	    LETOHOST64(h.source_hash) != hash ||
+	    LETOHOST64(h.runtime_hash) != runtime_hash() ||
+	    size != view.size - sizeof(h)) {
+		common_close_file_view(&view);
+		return true;
+	}
+
+	/* Pass a private copy since the view may be a read-only mapping. */
+	bytecode = mem_alloc(MEM_FILE, size);
+	if (bytecode == NULL) {
+		sys_out_of_memory();
+		common_close_file_view(&view);
+		return false;
+	}
+	memcpy(bytecode, view.data + sizeof(h), size);
+	common_close_file_view(&view);
+
+	if (!rt_register_bytecode(rt, size, bytecode)) {
+		mem_free(bytecode);
+		return false;
+	}
+	mem_free(bytecode);
+
+	*loaded = true;
+	return true;
+}
+
+/* Save the bytecode of a registered source. */
+static void save_cache(struct rt_env *rt, const char *file, const char *path, uint64_t hash)
+{
+	struct cache_header h;
+	char tmp_path[1100];
+	uint8_t *bytecode;
+	uint32_t size;
+	FILE *fp;
+	bool ok;
+
+	if (!rt_get_bytecode(rt, file, &bytecode, &size))
+		return;
+
+#if defined(TARGET_WINDOWS)
+	_mkdir(SCRIPT_CACHE_DIR);
+#else
+	mkdir(SCRIPT_CACHE_DIR, 0755);
+#endif
+
+	memcpy(h.magic, CACHE_MAGIC, 4);
+	h.version = HOSTTOLE32(CACHE_VERSION);
+	h.source_hash = HOSTTOLE64(hash);
+	h.runtime_hash = HOSTTOLE64(runtime_hash());
+	h.size = HOSTTOLE32(size);
+	h.reserved = 0;
+
+	/* Write to a temporary file and rename it not to leave a broken cache. */
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	fp = fopen(tmp_path, "wb");
+	if (fp == NULL) {
+		free(bytecode);
+		return;
+	}
+	ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+	     (size == 0 || fwrite(bytecode, size, 1, fp) == 1);
+	if (fclose(fp) != 0)
+		ok = false;
+	free(bytecode);
+
+	if (!ok) {
+		remove(tmp_path);
+		return;
+	}
+#if defined(TARGET_WINDOWS)
+	remove(path);
+#endif
+	if (rename(tmp_path, path) != 0)
+		remove(tmp_path);
+}
+
+/* Get the hash of the runtime build. */
+static uint64_t runtime_hash(void)
+{
+	return common_hash64(SCRIPT_CACHE_RUNTIME, strlen(SCRIPT_CACHE_RUNTIME));
+}
+#endif
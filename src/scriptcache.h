@@ -0,0 +1,41 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * scriptcache.h: Compiled script cache.
+ *  - Enabled by USE_SCRIPT_CACHE. Without it, sources are always compiled.
+ *  - USE_SCRIPT_CACHE needs SCRIPT_CACHE_RUNTIME, the Linguine version.
+ */
+
+#ifndef NOVELKIT_SCRIPTCACHE_H
+#define NOVELKIT_SCRIPTCACHE_H
+
+#include "compat.h"
+#include "linguine/linguine.h"
+
+/* Cache directory. */
+#define SCRIPT_CACHE_DIR	"cache"
+
+/* Statistics. */
+struct scriptcache_stats {
+	int hits;
+	int misses;
+	uint64_t load_usec;	/* time to load cached scripts */
+	uint64_t compile_usec;	/* time to compile and save missed scripts */
+};
+
+/*
+ * Register a script to a runtime.
+ *  - If the cached bytecode was made from the same source, it is used.
+ *  - Otherwise, the source is compiled and the cache is updated.
+ */
+bool scriptcache_register(struct rt_env *rt, const char *file, const char *source);
+
+/* Get the statistics. */
+void scriptcache_get_stats(struct scriptcache_stats *stats);
+
+#endif
@@ -0,0 +1,193 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * startup.c: Startup prefetch. (USE_STARTUP_PREFETCH)
+ *  - The parsed scenario is kept aside by scenario_prefetch(), and
+ *    taken by the first move to the same file. A parse error is not
+ *    reported here, because the move parses the file again and reports
+ *    it.
+ *  - Images and sounds are HAL objects made on the main thread, so
+ *    the preload worker only reads the files to bring them into the
+ *    page cache. Packed files are touched in the mapped package.
+ */
+
+#include "novelkit.h"
+
+#if defined(USE_STARTUP_PREFETCH)
+
+#include <pthread.h>
+
+/* Read size of a loose file. */
+#define READ_CHUNK	65536
+
+/* Stride to touch a mapped file. */
+#define TOUCH_STRIDE	4096
+
+/* Workers. */
+static pthread_t parse_thread;
+static pthread_t preload_thread;
+static bool is_parse_started;
+static bool is_preload_started;
+
+/* Jobs. (owned by the workers until startup_end()) */
+static char *scenario_file;
+static char *preload_list;
+
+/* Statistics. */
+static struct startup_stats stats;
+
+/* Forward declarations. */
+static void *parse_main(void *p);
+static void *preload_main(void *p);
+static void read_file(const char *file, char *buf);
+
+#endif
+
+/*
+ * Start the workers.
+ */
+void startup_begin(const char *scenario, const char *preload)
+{
+#if defined(USE_STARTUP_PREFETCH)
+	if (scenario != NULL) {
+		scenario_file = mem_strdup(MEM_SCENARIO, scenario);
+		if (scenario_file != NULL &&
+		    pthread_create(&parse_thread, NULL, parse_main, NULL) == 0)
+			is_parse_started = true;
+	}
+
+	if (preload != NULL) {
+		preload_list = mem_strdup(MEM_FILE, preload);
+		if (preload_list != NULL &&
+		    pthread_create(&preload_thread, NULL, preload_main, NULL) == 0)
+			is_preload_started = true;
+	}
+#else
+	UNUSED_PARAMETER(scenario);
+	UNUSED_PARAMETER(preload);
+#endif
+}
+
+#if defined(USE_STARTUP_PREFETCH)
+/* Parse worker main. */
+static void *parse_main(void *p)
+{
+	uint64_t start;
+
+	UNUSED_PARAMETER(p);
+
+	start = common_get_usec();
+	stats.is_parsed = scenario_prefetch(scenario_file);
+	stats.parse_usec = common_get_usec() - start;
+
+	return NULL;
+}
+
+/* Preload worker main. */
+static void *preload_main(void *p)
+{
+	char *buf, *file, *next;
+	uint64_t start;
+
+	UNUSED_PARAMETER(p);
+
+	start = common_get_usec();
+
+	buf = mem_alloc(MEM_FILE, READ_CHUNK);
+	if (buf == NULL)
+		return NULL;
+
+	/* Split the list at commas and skip spaces. */
+	for (file = preload_list; file != NULL; file = next) {
+		next = strchr(file, ',');
+		if (next != NULL)
+			*next++ = '\0';
+		while (*file == ' ')
+			file++;
+		if (*file != '\0')
+			read_file(file, buf);
+	}
+
+	mem_free(buf);
+	stats.preload_usec = common_get_usec() - start;
+
+	return NULL;
+}
+
+/* Read a file and throw the content away. */
+static void read_file(const char *file, char *buf)
+{
+	const struct package_entry *e;
+	const volatile char *data;
+	struct file *f;
+	size_t size, i, read_size;
+	char sum;
+
+	/* Touch the pages of a packed file. */
+	e = package_find(file);
+	if (e != NULL) {
+		data = package_get_data(e);
+		size = (size_t)LETOHOST64(e->stored_size);
+		sum = 0;
+		for (i = 0; i < size; i += TOUCH_STRIDE)
+			sum = (char)(sum + data[i]);
+		UNUSED_PARAMETER(sum);
+		stats.preload_files++;
+		stats.preload_bytes += size;
+		return;
+	}
+
+	/* Read a loose file. Missing files are left to the loader. */
+	if (!file_open(file, &f))
+		return;
+	do {
+		if (!file_read(f, buf, READ_CHUNK, &read_size))
+			break;
+		stats.preload_bytes += read_size;
+	} while (read_size == READ_CHUNK);
+	file_close(f);
+	stats.preload_files++;
+}
+#endif
+
+/*
+ * Wait for the workers.
+ */
+void startup_end(void)
+{
+#if defined(USE_STARTUP_PREFETCH)
+	uint64_t start;
+
+	start = common_get_usec();
+	if (is_parse_started)
+		pthread_join(parse_thread, NULL);
+	if (is_preload_started)
+		pthread_join(preload_thread, NULL);
+	stats.wait_usec = common_get_usec() - start;
+
+	is_parse_started = false;
+	is_preload_started = false;
+
+	mem_free(scenario_file);
+	mem_free(preload_list);
+	scenario_file = NULL;
+	preload_list = NULL;
+#endif
+}
+
+/*
+ * Get the prefetch statistics.
+ */
+void startup_get_stats(struct startup_stats *ret)
+{
+#if defined(USE_STARTUP_PREFETCH)
+	*ret = stats;
+#else
+	memset(ret, 0, sizeof(*ret));
+#endif
+}
@@ -0,0 +1,47 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * startup.h: Startup prefetch. (USE_STARTUP_PREFETCH)
+ *  - After setup(), worker threads parse the first scenario and read
+ *    the preload files while the HAL creates the window and the GL
+ *    context. on_hal_ready() waits for them before first().
+ *  - The parse worker owns the scenario module until startup_end().
+ *  - Without USE_STARTUP_PREFETCH, the functions do nothing and
+ *    first() loads everything itself.
+ */
+
+#ifndef NOVELKIT_STARTUP_H
+#define NOVELKIT_STARTUP_H
+
+#include "compat.h"
+
+/* Prefetch statistics. */
+struct startup_stats {
+	bool is_parsed;
+	uint64_t parse_usec;
+	int preload_files;
+	uint64_t preload_bytes;
+	uint64_t preload_usec;
+	uint64_t wait_usec;
+};
+
+/*
+ * Start the workers. (main thread)
+ *  - scenario ... first scenario file, or NULL.
+ *  - preload  ... comma-separated files to read, or NULL.
+ *  - A failure to start is not an error.
+ */
+void startup_begin(const char *scenario, const char *preload);
+
+/* Wait for the workers. (main thread) */
+void startup_end(void);
+
+/* Get the prefetch statistics. */
+void startup_get_stats(struct startup_stats *stats);
+
+#endif
@@ -0,0 +1,215 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * strtab.c: Localized string tables.
+ *  - A table is opened as a file view. When it is stored in the
+ *    package without compression, the view is the mapped archive, and
+ *    a loose table is memory-mapped too where the platform allows it,
+ *    so only the pages of the looked-up entries and strings are read.
+ *  - Only the header is checked when a table is opened, not to touch
+ *    the whole file. Each lookup checks its own entry.
+ *  - IDs are not stored. nkstrtab rejects a table that has two IDs of
+ *    the same hash.
+ */
+
+#include "novelkit.h"
+
+#if defined(TARGET_LINUX) || defined(TARGET_MACOS) || defined(TARGET_IOS)
+#define USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* Current table. */
+static struct file_view view;
+static bool is_active;
+static bool is_mapped;
+static const struct strtab_entry *entries;
+static uint32_t entry_count;
+static size_t str_offset;
+
+/* Incremented when the language is changed. */
+static uint32_t generation = 1;
+
+/* Forward declarations. */
+static bool open_table(const char *path, struct file_view *v, bool *mapped);
+static void close_table(struct file_view *v, bool mapped);
+#if defined(USE_MMAP)
+static bool map_loose_file(const char *path, struct file_view *v);
+#endif
+
+/*
+ * Select a language.
+ */
+bool strtab_set_language(const char *lang)
+{
+	const struct strtab_header *h;
+	struct file_view new_view;
+	char path[256];
+	uint32_t count;
+	bool mapped;
+
+	/* Disable the tables. */
+	if (lang[0] == '\0') {
+		strtab_cleanup();
+		generation++;
+		return true;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s%s", STRTAB_DIR, lang, STRTAB_EXT);
+	if (!open_table(path, &new_view, &mapped)) {
+		api_error("Cannot open string table %s.", path);
+		return false;
+	}
+
+	/* Check the header. */
+	h = (const struct strtab_header *)new_view.data;
+	count = new_view.size >= sizeof(*h) ? LETOHOST32(h->count) : 0;
+	if (new_view.size < sizeof(*h) ||
+	    memcmp(h->magic, STRTAB_MAGIC, 4) != 0 ||
+	    LETOHOST32(h->version) != STRTAB_VERSION ||
+	    (new_view.size - sizeof(*h)) / sizeof(struct strtab_entry) < count ||
+	    ((uintptr_t)new_view.data & 7) != 0) {
+		api_error("Broken string table %s.", path);
+		close_table(&new_view, mapped);
+		return false;
+	}
+
+	/* Replace the current table. */
+	strtab_cleanup();
+	view = new_view;
+	is_mapped = mapped;
+	entries = (const struct strtab_entry *)(view.data + sizeof(*h));
+	entry_count = count;
+	str_offset = sizeof(*h) + (size_t)count * sizeof(struct strtab_entry);
+	is_active = true;
+	generation++;
+
+	return true;
+}
+
+/* Open a table file. */
+static bool open_table(const char *path, struct file_view *v, bool *mapped)
+{
+	*mapped = false;
+
+#if defined(USE_MMAP)
+	/* Map a loose file. The package is mapped as a whole. */
+	if (package_find(path) == NULL && map_loose_file(path, v)) {
+		*mapped = true;
+		return true;
+	}
+#endif
+
+	return common_open_file_view(path, v);
+}
+
+#if defined(USE_MMAP)
+/* Map a loose file. Returns false to fall back to reading. */
+static bool map_loose_file(const char *path, struct file_view *v)
+{
+	struct stat st;
+	void *p;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	if (fstat(fd, &st) == -1 || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+
+	v->data = p;
+	v->size = (size_t)st.st_size;
+	v->owned = NULL;
+
+	return true;
+}
+#endif
+
+/* Close a table file. */
+static void close_table(struct file_view *v, bool mapped)
+{
+#if defined(USE_MMAP)
+	if (mapped) {
+		munmap((void *)v->data, v->size);
+		v->data = NULL;
+		v->size = 0;
+		return;
+	}
+#else
+	UNUSED_PARAMETER(mapped);
+#endif
+	common_close_file_view(v);
+}
+
+/*
+ * Get a number that changes when the language is changed.
+ */
+uint32_t strtab_get_generation(void)
+{
+	return generation;
+}
+
+/*
+ * Lookup a string by an ID hash.
+ */
+const char *strtab_lookup(uint64_t hash)
+{
+	uint32_t lo, hi, mid;
+	uint64_t h;
+	size_t ofs, len;
+
+	if (!is_active)
+		return NULL;
+
+	/* Binary search on the sorted entries. */
+	lo = 0;
+	hi = entry_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		h = LETOHOST64(entries[mid].hash);
+		if (h == hash) {
+			ofs = str_offset + LETOHOST32(entries[mid].offset);
+			len = LETOHOST32(entries[mid].length);
+			if (ofs >= view.size || len >= view.size - ofs || view.data[ofs + len] != '\0')
+				return NULL;
+			return view.data + ofs;
+		}
+		if (hash < h)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+/*
+ * Cleanup the string table module.
+ */
+void strtab_cleanup(void)
+{
+	if (is_active)
+		close_table(&view, is_mapped);
+
+	is_active = false;
+	is_mapped = false;
+	entries = NULL;
+	entry_count = 0;
+	str_offset = 0;
+}
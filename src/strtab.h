@@ -0,0 +1,77 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * strtab.h: Localized string tables.
+ *
+ * A string table "lang/<language>.nkl" maps string IDs to strings.
+ * The ID of the "text" property of a command with id="x" is "x", and
+ * the ID of another property "p" is "x.p".
+ *
+ * Layout (all integers are little endian):
+ *
+ * +----------------------------+ 0
+ * |struct strtab_header        |
+ * +----------------------------+ 16
+ * |struct strtab_entry[count]  | (sorted by hash)
+ * +----------------------------+
+ * |NUL-terminated strings      |
+ * +----------------------------+
+ */
+
+#ifndef NOVELKIT_STRTAB_H
+#define NOVELKIT_STRTAB_H
+
+#include "compat.h"
+
+/* Header values. */
+#define STRTAB_MAGIC		"NKST"
+#define STRTAB_VERSION		1
+
+/* Directory and extension of table files. */
+#define STRTAB_DIR		"lang"
+#define STRTAB_EXT		".nkl"
+
+/* Initial value of an ID hash. */
+#define STRTAB_HASH_INIT	14695981039346656037ULL
+
+/* File header. (16 bytes) */
+struct strtab_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+/* String entry. (16 bytes) */
+struct strtab_entry {
+	uint64_t hash;
+	uint32_t offset;
+	uint32_t length;
+};
+
+/* Hash an ID string. (64-bit FNV-1a, can be continued) */
+static INLINE uint64_t strtab_hash(uint64_t hash, const char *s)
+{
+	while (*s != '\0')
+		hash = (hash ^ (uint8_t)*s++) * 1099511628211ULL;
+	return hash;
+}
+
+/* Select a language. ("" to use the strings in scenario files) */
+bool strtab_set_language(const char *lang);
+
+/* Get a number that changes when the language is changed. */
+uint32_t strtab_get_generation(void);
+
+/* Lookup a string by an ID hash. Returns NULL if not found. */
+const char *strtab_lookup(uint64_t hash);
+
+/* Cleanup the string table module. */
+void strtab_cleanup(void);
+
+#endif
@@ -0,0 +1,270 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * tag.c: Native tag handlers.
+ *  - Add a tag by writing a handler and an entry of tag_tbl[], in the
+ *    same way as funcs[] of install_api().
+ *  - The scenario module converts the values without variable
+ *    references at load time, so a native dispatch makes no runtime
+ *    value.
+ */
+
+#include "novelkit.h"
+
+/* Property. */
+struct tag_prop {
+	const char *name;
+	int type;
+	bool is_required;
+};
+
+/* Native tag. */
+struct native_tag {
+	const char *name;
+	const struct tag_prop *props;
+	int prop_count;
+	bool (*handler)(const struct tag_value *args);
+	bool is_overridden;
+};
+
+/* Forward declarations. */
+static bool tag_click(const struct tag_value *args);
+static bool tag_label(const struct tag_value *args);
+static bool tag_time(const struct tag_value *args);
+#if !defined(USE_LOGIC_THREAD)
+static bool tag_volume(const struct tag_value *args);
+#endif
+
+/* [label name="x"] */
+static const struct tag_prop label_props[] = {
+	{"name", TAG_PROP_STRING, true},
+};
+
+/* [time seconds="1.5"] */
+static const struct tag_prop time_props[] = {
+	{"seconds", TAG_PROP_FLOAT, true},
+};
+
+#if !defined(USE_LOGIC_THREAD)
+/* [volume track="0" vol="0.5"] */
+static const struct tag_prop volume_props[] = {
+	{"track", TAG_PROP_INT, true},
+	{"vol", TAG_PROP_FLOAT, true},
+};
+#endif
+
+#define PROPS(p)	p, (int)(sizeof(p) / sizeof(p[0]))
+
+/* Native tags. */
+static struct native_tag tag_tbl[] = {
+	{"click", NULL, 0, tag_click, false},
+	{"label", PROPS(label_props), tag_label, false},
+	{"time", PROPS(time_props), tag_time, false},
+#if !defined(USE_LOGIC_THREAD)
+	/* The HAL is called on the main thread only. */
+	{"volume", PROPS(volume_props), tag_volume, false},
+#endif
+};
+
+#define TAG_COUNT	((int)(sizeof(tag_tbl) / sizeof(tag_tbl[0])))
+
+/*
+ * Find a native tag.
+ */
+int tag_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < TAG_COUNT; i++) {
+		if (strcmp(tag_tbl[i].name, name) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Get the number of properties of a native tag.
+ */
+int tag_get_prop_count(int tag)
+{
+	assert(tag >= 0 && tag < TAG_COUNT);
+
+	return tag_tbl[tag].prop_count;
+}
+
+/*
+ * Get the name of a property of a native tag.
+ */
+const char *tag_get_prop_name(int tag, int prop)
+{
+	assert(tag >= 0 && tag < TAG_COUNT);
+	assert(prop >= 0 && prop < tag_tbl[tag].prop_count);
+
+	return tag_tbl[tag].props[prop].name;
+}
+
+/*
+ * Convert a property value.
+ */
+bool tag_convert(int tag, int prop, const char *s, struct tag_value *v)
+{
+	const struct tag_prop *p;
+	char *end;
+	long l;
+
+	assert(tag >= 0 && tag < TAG_COUNT);
+	assert(prop >= 0 && prop < tag_tbl[tag].prop_count);
+
+	p = &tag_tbl[tag].props[prop];
+
+	memset(v, 0, sizeof(*v));
+	switch (p->type) {
+	case TAG_PROP_INT:
+		l = strtol(s, &end, 10);
+		if (end == s || *end != '\0' || l < INT32_MIN || l > INT32_MAX) {
+			api_error("Invalid integer \"%s\" for %s.", s, p->name);
+			return false;
+		}
+		v->i = (int)l;
+		break;
+	case TAG_PROP_FLOAT:
+		v->f = strtof(s, &end);
+		if (end == s || *end != '\0') {
+			api_error("Invalid number \"%s\" for %s.", s, p->name);
+			return false;
+		}
+		break;
+	default:
+		v->s = s;
+		break;
+	}
+	v->is_set = true;
+
+	return true;
+}
+
+/*
+ * Check if a native tag is not overridden.
+ */
+bool tag_is_native(int tag)
+{
+	assert(tag >= 0 && tag < TAG_COUNT);
+
+	return !tag_tbl[tag].is_overridden;
+}
+
+/*
+ * Let the executive run a tag.
+ */
+bool tag_override(const char *name)
+{
+	int tag;
+
+	tag = tag_find(name);
+	if (tag < 0) {
+		api_error("%s is not a native tag.", name);
+		return false;
+	}
+
+	tag_tbl[tag].is_overridden = true;
+
+	return true;
+}
+
+/*
+ * Let the executive run the tags it defines functions for.
+ *  - A function of a tag name takes the tag even without
+ *    overrideTag(), so a script written before the tag became native
+ *    keeps working.
+ */
+void tag_bind_scripts(struct rt_env *rt)
+{
+	struct rt_value func;
+	int i;
+
+	for (i = 0; i < TAG_COUNT; i++) {
+		if (tag_tbl[i].is_overridden)
+			continue;
+		if (!rt_get_global(rt, tag_tbl[i].name, &func))
+			continue;
+		if (func.type != RT_VALUE_FUNC)
+			continue;
+
+		tag_tbl[i].is_overridden = true;
+		printf("tag: [%s] runs the script function %s().\n", tag_tbl[i].name, tag_tbl[i].name);
+	}
+}
+
+/*
+ * Run a native tag.
+ */
+bool tag_call(int tag, const struct tag_value *args)
+{
+	const struct native_tag *t;
+	int i;
+
+	assert(tag >= 0 && tag < TAG_COUNT);
+
+	t = &tag_tbl[tag];
+	for (i = 0; i < t->prop_count; i++) {
+		if (t->props[i].is_required && !args[i].is_set) {
+			api_error("Missing property %s of %s.", t->props[i].name, t->name);
+			return false;
+		}
+	}
+
+	return t->handler(args);
+}
+
+/*
+ * Handlers
+ */
+
+/* Wait for a click. */
+static bool tag_click(const struct tag_value *args)
+{
+	UNUSED_PARAMETER(args);
+
+	return wait_click(NULL);
+}
+
+/* Define a jump target. Nothing to do when passed. */
+static bool tag_label(const struct tag_value *args)
+{
+	UNUSED_PARAMETER(args);
+
+	return true;
+}
+
+/* Wait for seconds. */
+static bool tag_time(const struct tag_value *args)
+{
+	return wait_time(args[0].f, NULL);
+}
+
+#if !defined(USE_LOGIC_THREAD)
+/* Change a sound volume. */
+static bool tag_volume(const struct tag_value *args)
+{
+	float vol;
+
+	vol = args[1].f;
+	if (vol < 0.0f)
+		vol = 0.0f;
+	if (vol > 1.0f)
+		vol = 1.0f;
+
+	if (!set_sound_volume(args[0].i, vol)) {
+		api_error("Cannot set the volume of track %d.", args[0].i);
+		return false;
+	}
+
+	return true;
+}
+#endif
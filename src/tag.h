@@ -0,0 +1,72 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * tag.h: Native tag handlers.
+ *  - Simple built-in tags run in C without calling the executive, and
+ *    get their properties as typed values in the order of the
+ *    property table of the tag.
+ *  - The executive takes a tag back by defining a function of the tag
+ *    name, or by NovelKit.overrideTag(), then the tag calls the
+ *    function as other tags do.
+ */
+
+#ifndef NOVELKIT_TAG_H
+#define NOVELKIT_TAG_H
+
+#include "compat.h"
+
+/* Maximum number of properties of a native tag. */
+#define TAG_PROP_MAX	4
+
+/* Property types. */
+enum tag_prop_type {
+	TAG_PROP_INT,
+	TAG_PROP_FLOAT,
+	TAG_PROP_STRING,
+};
+
+/* Typed property value. */
+struct tag_value {
+	bool is_set;
+	int i;
+	float f;
+	const char *s;
+};
+
+/* Find a native tag. Returns the index, or -1. */
+int tag_find(const char *name);
+
+/* Get the number of properties of a native tag. */
+int tag_get_prop_count(int tag);
+
+/* Get the name of a property of a native tag. */
+const char *tag_get_prop_name(int tag, int prop);
+
+/*
+ * Convert a property value to the type of the property.
+ *  - The string of a string property is not copied.
+ */
+bool tag_convert(int tag, int prop, const char *s, struct tag_value *v);
+
+/* Check if a native tag is not overridden. */
+bool tag_is_native(int tag);
+
+/* Let the executive run a tag. */
+bool tag_override(const char *name);
+
+/* Let the executive run the tags it defines functions for. (after load) */
+void tag_bind_scripts(struct rt_env *rt);
+
+/*
+ * Run a native tag.
+ *  - args has the values in the order of the properties, and is_set
+ *    is false for a property not written.
+ */
+bool tag_call(int tag, const struct tag_value *args);
+
+#endif
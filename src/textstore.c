@@ -0,0 +1,264 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * textstore.c: Compressed text store.
+ *  - A reference is a block index and an offset in the block. Strings
+ *    don't cross blocks.
+ *  - The block being filled stays uncompressed, so that strings can be
+ *    read while a file is loaded.
+ *  - Reads in a scenario are local, so a few cached blocks serve the
+ *    current tag and its neighbors. A jump to a far tag decompresses
+ *    one block.
+ */
+
+#include "novelkit.h"
+#include "lz.h"
+
+/* Block size. (the LZ4 window) */
+#define BLOCK_SHIFT	16
+#define BLOCK_SIZE	(1 << BLOCK_SHIFT)
+
+/* Number of cached blocks. */
+#define CACHE_SLOTS	4
+
+/* Compressed block. */
+struct block {
+	char *data;
+	uint32_t size;
+	uint32_t stored_size;	/* Same as size if stored raw. */
+};
+
+/* Cached block. */
+struct slot {
+	int block;
+	uint32_t last_use;
+	char *buf;
+};
+
+/* Store. */
+struct textstore {
+	/* Compressed blocks. */
+	struct block *blocks;
+	int block_count;
+	int block_alloc;
+
+	/* Block being filled, and the compression buffer. */
+	char *fill;
+	uint32_t fill_size;
+	char *zbuf;
+	size_t zbuf_size;
+
+	/* Decompressed blocks. */
+	struct slot cache[CACHE_SLOTS];
+	uint32_t use_count;
+};
+
+/* Forward declarations. */
+static bool flush_block(struct textstore *ts);
+static struct slot *get_slot(struct textstore *ts, int block);
+
+/*
+ * Create a store.
+ */
+struct textstore *textstore_create(void)
+{
+	struct textstore *ts;
+	int i;
+
+	ts = mem_calloc(MEM_SCENARIO, 1, sizeof(struct textstore));
+	if (ts == NULL) {
+		api_out_of_memory();
+		return NULL;
+	}
+	for (i = 0; i < CACHE_SLOTS; i++)
+		ts->cache[i].block = -1;
+
+	return ts;
+}
+
+/*
+ * Destroy a store.
+ */
+void textstore_destroy(struct textstore *ts)
+{
+	int i;
+
+	if (ts == NULL)
+		return;
+
+	for (i = 0; i < ts->block_count; i++)
+		mem_free(ts->blocks[i].data);
+	mem_free(ts->blocks);
+	mem_free(ts->fill);
+	mem_free(ts->zbuf);
+	for (i = 0; i < CACHE_SLOTS; i++)
+		mem_free(ts->cache[i].buf);
+	mem_free(ts);
+}
+
+/*
+ * Append a string.
+ */
+bool textstore_add(struct textstore *ts, const char *s, uint32_t *ref)
+{
+	size_t len;
+
+	len = strlen(s) + 1;
+	assert(len <= TEXTSTORE_STRING_MAX);
+
+	/* Start a new block if the string doesn't fit. */
+	if (ts->fill_size + len > BLOCK_SIZE) {
+		if (!flush_block(ts))
+			return false;
+	}
+
+	if (ts->fill == NULL) {
+		ts->zbuf_size = lz_compress_bound(BLOCK_SIZE);
+		ts->fill = mem_alloc(MEM_SCENARIO, BLOCK_SIZE);
+		ts->zbuf = mem_alloc(MEM_SCENARIO, ts->zbuf_size);
+		if (ts->fill == NULL || ts->zbuf == NULL) {
+			api_out_of_memory();
+			return false;
+		}
+	}
+
+	memcpy(ts->fill + ts->fill_size, s, len);
+	*ref = ((uint32_t)ts->block_count << BLOCK_SHIFT) | ts->fill_size;
+	ts->fill_size += (uint32_t)len;
+
+	return true;
+}
+
+/*
+ * Compress the last block.
+ */
+bool textstore_finish(struct textstore *ts)
+{
+	if (!flush_block(ts))
+		return false;
+
+	/* Loading is done. */
+	mem_free(ts->fill);
+	mem_free(ts->zbuf);
+	ts->fill = NULL;
+	ts->zbuf = NULL;
+
+	return true;
+}
+
+/* Compress the block being filled and start a new one. */
+static bool flush_block(struct textstore *ts)
+{
+	struct block *new_blocks, *b;
+	size_t stored;
+	int new_alloc;
+
+	if (ts->fill_size == 0)
+		return true;
+
+	if (ts->block_count == ts->block_alloc) {
+		new_alloc = ts->block_alloc == 0 ? 64 : ts->block_alloc * 2;
+		new_blocks = mem_realloc(MEM_SCENARIO, ts->blocks, (size_t)new_alloc * sizeof(struct block));
+		if (new_blocks == NULL) {
+			api_out_of_memory();
+			return false;
+		}
+		ts->blocks = new_blocks;
+		ts->block_alloc = new_alloc;
+	}
+
+	/* Store raw if compression doesn't help. */
+	stored = lz_compress(ts->fill, ts->fill_size, ts->zbuf, ts->zbuf_size);
+	if (stored == 0 || stored >= ts->fill_size)
+		stored = ts->fill_size;
+
+	b = &ts->blocks[ts->block_count];
+	b->data = mem_alloc(MEM_SCENARIO, stored);
+	if (b->data == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+	memcpy(b->data, stored == ts->fill_size ? ts->fill : ts->zbuf, stored);
+	b->size = ts->fill_size;
+	b->stored_size = (uint32_t)stored;
+
+	ts->block_count++;
+	ts->fill_size = 0;
+
+	return true;
+}
+
+/*
+ * Get a string.
+ */
+const char *textstore_get(struct textstore *ts, uint32_t ref)
+{
+	struct slot *slot;
+	int block;
+	uint32_t ofs;
+
+	block = (int)(ref >> BLOCK_SHIFT);
+	ofs = ref & (BLOCK_SIZE - 1);
+
+	/* In the block being filled. */
+	if (block == ts->block_count) {
+		assert(ofs < ts->fill_size);
+		return ts->fill + ofs;
+	}
+
+	assert(block < ts->block_count);
+	assert(ofs < ts->blocks[block].size);
+
+	/* Uncompressed block. */
+	if (ts->blocks[block].stored_size == ts->blocks[block].size)
+		return ts->blocks[block].data + ofs;
+
+	slot = get_slot(ts, block);
+	if (slot == NULL)
+		return NULL;
+
+	return slot->buf + ofs;
+}
+
+/* Get a cached block, or decompress it into the least recently used slot. */
+static struct slot *get_slot(struct textstore *ts, int block)
+{
+	struct slot *slot;
+	struct block *b;
+	int i;
+
+	slot = &ts->cache[0];
+	for (i = 0; i < CACHE_SLOTS; i++) {
+		if (ts->cache[i].block == block) {
+			slot = &ts->cache[i];
+			slot->last_use = ++ts->use_count;
+			return slot;
+		}
+		if (ts->cache[i].last_use < slot->last_use)
+			slot = &ts->cache[i];
+	}
+
+	if (slot->buf == NULL) {
+		slot->buf = mem_alloc(MEM_SCENARIO, BLOCK_SIZE);
+		if (slot->buf == NULL) {
+			api_out_of_memory();
+			return NULL;
+		}
+	}
+
+	b = &ts->blocks[block];
+	if (!lz_decompress(b->data, b->stored_size, slot->buf, b->size)) {
+		slot->block = -1;
+		api_error("Broken text block.");
+		return NULL;
+	}
+	slot->block = block;
+	slot->last_use = ++ts->use_count;
+
+	return slot;
+}
@@ -0,0 +1,43 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * textstore.h: Compressed text store.
+ *  - Strings are appended to blocks, and a full block is compressed.
+ *  - A string is read through a small cache of decompressed blocks.
+ */
+
+#ifndef NOVELKIT_TEXTSTORE_H
+#define NOVELKIT_TEXTSTORE_H
+
+#include "compat.h"
+
+/* Maximum string length including the NUL. */
+#define TEXTSTORE_STRING_MAX	65536
+
+struct textstore;
+
+/* Create a store. */
+struct textstore *textstore_create(void);
+
+/* Destroy a store. */
+void textstore_destroy(struct textstore *ts);
+
+/* Append a string and get a reference to it. */
+bool textstore_add(struct textstore *ts, const char *s, uint32_t *ref);
+
+/* Compress the last block. (strings can be added after this) */
+bool textstore_finish(struct textstore *ts);
+
+/*
+ * Get a string.
+ *  - The pointer is valid until the next call for the store.
+ *  - Returns NULL if a block is broken or memory is short.
+ */
+const char *textstore_get(struct textstore *ts, uint32_t ref);
+
+#endif
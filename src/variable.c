@@ -0,0 +1,202 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * variable.c: Named string variables.
+ *  - Variables are never removed while the game runs, so an index is
+ *    a stable handle that can be kept in precompiled data.
+ */
+
+#include "novelkit.h"
+
+/* Initial table size. */
+#define VAR_ALLOC_INIT	64
+
+/* Variable. */
+struct variable {
+	char *name;
+	char *value;
+};
+
+/* Variable tables. */
+static struct variable *tbl[VAR_SPACE_COUNT];
+static int tbl_size[VAR_SPACE_COUNT];
+static int tbl_alloc[VAR_SPACE_COUNT];
+
+/* Change counters. */
+static uint32_t generation[VAR_SPACE_COUNT];
+
+/* Forward declaration. */
+static bool replace_value(int space, int index, const char *value);
+
+/*
+ * Add a variable. A new variable is recorded as an empty one for
+ * rewinding, so that a rewind before the addition clears it.
+ */
+bool var_add(int space, const char *name, const char *value)
+{
+	struct variable *new_tbl;
+	int new_alloc, index;
+
+	assert(space >= 0 && space < VAR_SPACE_COUNT);
+
+	index = var_find(space, name);
+	if (index >= 0)
+		return var_set(space, index, value);
+
+	/* Grow the table. */
+	if (tbl_size[space] == tbl_alloc[space]) {
+		new_alloc = tbl_alloc[space] == 0 ? VAR_ALLOC_INIT : tbl_alloc[space] * 2;
+		new_tbl = mem_realloc(MEM_SCENARIO, tbl[space], (size_t)new_alloc * sizeof(struct variable));
+		if (new_tbl == NULL) {
+			api_out_of_memory();
+			return false;
+		}
+		tbl[space] = new_tbl;
+		tbl_alloc[space] = new_alloc;
+	}
+
+	index = tbl_size[space];
+	tbl[space][index].name = mem_strdup(MEM_SCENARIO, name);
+	tbl[space][index].value = mem_strdup(MEM_SCENARIO, value);
+	if (tbl[space][index].name == NULL || tbl[space][index].value == NULL) {
+		mem_free(tbl[space][index].name);
+		mem_free(tbl[space][index].value);
+		api_out_of_memory();
+		return false;
+	}
+	tbl_size[space]++;
+	generation[space]++;
+
+	if (value[0] != '\0' && !rollback_record(space, index, ""))
+		return false;
+
+	return true;
+}
+
+/*
+ * Find a variable.
+ */
+int var_find(int space, const char *name)
+{
+	int i;
+
+	assert(space >= 0 && space < VAR_SPACE_COUNT);
+
+	for (i = 0; i < tbl_size[space]; i++) {
+		if (strcmp(tbl[space][i].name, name) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Get the number of variables.
+ */
+int var_get_count(int space)
+{
+	assert(space >= 0 && space < VAR_SPACE_COUNT);
+
+	return tbl_size[space];
+}
+
+/*
+ * Get a variable name.
+ */
+const char *var_get_name(int space, int index)
+{
+	assert(space >= 0 && space < VAR_SPACE_COUNT);
+	assert(index >= 0 && index < tbl_size[space]);
+
+	return tbl[space][index].name;
+}
+
+/*
+ * Get a variable value.
+ */
+const char *var_get_value(int space, int index)
+{
+	assert(space >= 0 && space < VAR_SPACE_COUNT);
+	assert(index >= 0 && index < tbl_size[space]);
+
+	return tbl[space][index].value;
+}
+
+/*
+ * Set a variable value. The old value is recorded for rewinding.
+ */
+bool var_set(int space, int index, const char *value)
+{
+	assert(space >= 0 && space < VAR_SPACE_COUNT);
+	assert(index >= 0 && index < tbl_size[space]);
+
+	if (strcmp(tbl[space][index].value, value) == 0)
+		return true;
+
+	if (!rollback_record(space, index, tbl[space][index].value))
+		return false;
+
+	return replace_value(space, index, value);
+}
+
+/*
+ * Set a variable value without recording.
+ */
+bool var_restore(int space, int index, const char *value)
+{
+	assert(space >= 0 && space < VAR_SPACE_COUNT);
+	assert(index >= 0 && index < tbl_size[space]);
+
+	return replace_value(space, index, value);
+}
+
+/* Replace a value string. */
+static bool replace_value(int space, int index, const char *value)
+{
+	char *s;
+
+	s = mem_strdup(MEM_SCENARIO, value);
+	if (s == NULL) {
+		api_out_of_memory();
+		return false;
+	}
+	mem_free(tbl[space][index].value);
+	tbl[space][index].value = s;
+	generation[space]++;
+
+	return true;
+}
+
+/*
+ * Get a number that changes when a variable is added or changed.
+ */
+uint32_t var_get_generation(int space)
+{
+	assert(space >= 0 && space < VAR_SPACE_COUNT);
+
+	return generation[space];
+}
+
+/*
+ * Remove all variables.
+ */
+void var_cleanup(void)
+{
+	int space, i;
+
+	for (space = 0; space < VAR_SPACE_COUNT; space++) {
+		for (i = 0; i < tbl_size[space]; i++) {
+			mem_free(tbl[space][i].name);
+			mem_free(tbl[space][i].value);
+		}
+		mem_free(tbl[space]);
+		tbl[space] = NULL;
+		tbl_size[space] = 0;
+		tbl_alloc[space] = 0;
+	}
+}
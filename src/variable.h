@@ -0,0 +1,55 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * variable.h: Named string variables.
+ *  - Flags are game variables saved to flag files.
+ *  - Stage variables describe what is on the stage (background,
+ *    characters, music, text, ...) so that the executive can redraw
+ *    the stage after a rewind.
+ */
+
+#ifndef NOVELKIT_VARIABLE_H
+#define NOVELKIT_VARIABLE_H
+
+#include "compat.h"
+
+/* Variable spaces. */
+enum var_space {
+	VAR_FLAG,
+	VAR_STAGE,
+	VAR_SPACE_COUNT
+};
+
+/* Add a variable. (the value is updated if it already exists) */
+bool var_add(int space, const char *name, const char *value);
+
+/* Find a variable. Returns -1 if not found. */
+int var_find(int space, const char *name);
+
+/* Get the number of variables. */
+int var_get_count(int space);
+
+/* Get a variable name. */
+const char *var_get_name(int space, int index);
+
+/* Get a variable value. */
+const char *var_get_value(int space, int index);
+
+/* Set a variable value. The old value is recorded for rewinding. */
+bool var_set(int space, int index, const char *value);
+
+/* Set a variable value without recording. (used by rewinding) */
+bool var_restore(int space, int index, const char *value);
+
+/* Get a number that changes when a variable is added or changed. */
+uint32_t var_get_generation(int space);
+
+/* Remove all variables. */
+void var_cleanup(void);
+
+#endif
@@ -0,0 +1,188 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * wait.c: Wait conditions of blocking tags.
+ */
+
+#include "novelkit.h"
+
+/* Maximum length of a resume function name. */
+#define RESUME_MAX	128
+
+/* Wait types. */
+enum wait_type {
+	WAIT_NONE,
+	WAIT_CLICK,
+	WAIT_TIME,
+	WAIT_SOUND,
+	WAIT_MOVIE,
+};
+
+/* Current wait. */
+static int wait_type;
+static uint64_t end_usec;
+static int sound_track;
+static bool is_clicked;
+
+/* Function to call when the wait ends. */
+static char resume_func[RESUME_MAX];
+static char resume_ret[RESUME_MAX];
+
+/* Forward declarations. */
+static bool set_wait(int type, const char *resume);
+
+/*
+ * Wait for a click.
+ */
+bool wait_click(const char *resume)
+{
+	/* Ignore clicks before the wait. */
+	is_clicked = false;
+
+	return set_wait(WAIT_CLICK, resume);
+}
+
+/*
+ * Wait for a duration.
+ */
+bool wait_time(float seconds, const char *resume)
+{
+	if (seconds < 0)
+		seconds = 0;
+	end_usec = replay_get_usec() + (uint64_t)(seconds * 1000000.0f);
+
+	return set_wait(WAIT_TIME, resume);
+}
+
+/*
+ * Wait for a sound track to finish.
+ */
+bool wait_sound(int track, const char *resume)
+{
+	sound_track = track;
+
+	return set_wait(WAIT_SOUND, resume);
+}
+
+/*
+ * Wait for the movie to finish.
+ */
+bool wait_movie(const char *resume)
+{
+	return set_wait(WAIT_MOVIE, resume);
+}
+
+/* Set a wait type and a resume function. */
+static bool set_wait(int type, const char *resume)
+{
+	if (resume != NULL && strlen(resume) >= RESUME_MAX) {
+		api_error("Too long function name %s.", resume);
+		return false;
+	}
+
+	wait_type = type;
+	if (resume != NULL)
+		strcpy(resume_func, resume);
+	else
+		resume_func[0] = '\0';
+
+	return true;
+}
+
+/*
+ * Cancel the wait.
+ */
+void wait_cancel(void)
+{
+	wait_type = WAIT_NONE;
+	resume_func[0] = '\0';
+}
+
+/*
+ * Check if a wait is set.
+ */
+bool wait_is_set(void)
+{
+	return wait_type != WAIT_NONE;
+}
+
+/*
+ * Check if the wait can run at the idle frame rate.
+ *  - A movie needs every frame.
+ */
+bool wait_is_idle(uint64_t *deadline)
+{
+	*deadline = wait_type == WAIT_TIME ? end_usec : 0;
+
+	return wait_type == WAIT_CLICK ||
+	       wait_type == WAIT_TIME ||
+	       wait_type == WAIT_SOUND;
+}
+
+/*
+ * Check the wait condition.
+ */
+bool wait_update(const char **resume)
+{
+	bool done;
+
+	*resume = NULL;
+
+	switch (wait_type) {
+	case WAIT_NONE:
+		return false;
+	case WAIT_CLICK:
+		done = is_clicked;
+		break;
+	case WAIT_TIME:
+		done = replay_get_usec() >= end_usec;
+		break;
+#if defined(USE_LOGIC_THREAD)
+	/* The HAL is owned by the main thread. */
+	case WAIT_SOUND:
+		done = logic_is_sound_finished(sound_track);
+		break;
+	case WAIT_MOVIE:
+		done = !logic_is_video_playing();
+		break;
+#else
+	case WAIT_SOUND:
+		done = replay_filter_wait(is_sound_finished(sound_track));
+		break;
+	case WAIT_MOVIE:
+		done = replay_filter_wait(!is_video_playing());
+		break;
+#endif
+	default:
+		assert(0);
+		done = true;
+		break;
+	}
+	if (!done)
+		return true;
+
+	/* Hand over the resume function. */
+	if (resume_func[0] != '\0') {
+		strcpy(resume_ret, resume_func);
+		*resume = resume_ret;
+	}
+
+	wait_type = WAIT_NONE;
+	resume_func[0] = '\0';
+
+	return false;
+}
+
+/*
+ * Notify a click.
+ *  - With USE_LOGIC_THREAD, called on the logic thread.
+ */
+void wait_notify_click(void)
+{
+	is_clicked = true;
+}
@@ -0,0 +1,56 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * wait.h: Wait conditions of blocking tags.
+ *  - A tag handler sets a wait condition and returns. The next tag
+ *    runs when the condition is met.
+ *  - Conditions are checked in C every frame, so that a waiting frame
+ *    does not enter the executive.
+ */
+
+#ifndef NOVELKIT_WAIT_H
+#define NOVELKIT_WAIT_H
+
+#include "compat.h"
+
+/* Wait for a click. */
+bool wait_click(const char *resume);
+
+/* Wait for a duration. */
+bool wait_time(float seconds, const char *resume);
+
+/* Wait for a sound track to finish. */
+bool wait_sound(int track, const char *resume);
+
+/* Wait for the movie to finish. */
+bool wait_movie(const char *resume);
+
+/* Cancel the wait. */
+void wait_cancel(void);
+
+/* Check if a wait is set. */
+bool wait_is_set(void);
+
+/*
+ * Check if the wait can run at the idle frame rate.
+ *  - Gets the time the wait ends, or 0 if it is not timed.
+ */
+bool wait_is_idle(uint64_t *deadline);
+
+/*
+ * Check the wait condition.
+ *  - Returns true while waiting.
+ *  - When the condition is met, the wait is cleared and the resume
+ *    function name (or NULL) is stored to resume.
+ */
+bool wait_update(const char **resume);
+
+/* Notify a click. */
+void wait_notify_click(void);
+
+#endif
@@ -0,0 +1,46 @@
+#
+# aot_table.awk: Make the function table of ahead-of-time translated scripts.
+#
+# Usage:
+#  awk -f aot_table.awk game.ls main.ls > aot_table.h
+#
+# Each "func name(a, b)" at the top level (column 0) becomes a table entry that
+# refers to the translated C function "L_name".
+#
+
+BEGIN {
+	count = 0;
+	print "/* Generated by aot_table.awk. Do not edit. */";
+	print "";
+}
+
+/^func[ \t]+[A-Za-z_][A-Za-z0-9_]*[ \t]*\(/ {
+	line = $0;
+	sub(/^func[ \t]+/, "", line);
+	name = line;
+	sub(/[ \t]*\(.*$/, "", name);
+	params = line;
+	sub(/^[^(]*\(/, "", params);
+	sub(/\).*$/, "", params);
+	gsub(/[ \t]/, "", params);
+
+	n = (params == "") ? 0 : split(params, p, ",");
+	printf("bool L_%s(struct rt_env *rt);\n", name);
+	printf("static const char *L_%s_params[] = {", name);
+	for (i = 1; i <= n; i++)
+		printf("\"%s\", ", p[i]);
+	printf("NULL};\n");
+
+	names[count] = name;
+	nparams[count] = n;
+	count++;
+}
+
+END {
+	print "";
+	print "static const struct aot_func aot_funcs[] = {";
+	for (i = 0; i < count; i++)
+		printf("\t{\"%s\", %d, L_%s_params, L_%s},\n", names[i], nparams[i], names[i], names[i]);
+	print "\t{NULL, 0, NULL, NULL}";
+	print "};";
+}
@@ -0,0 +1,293 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * nkcompose: The compositor benchmark.
+ *
+ * Usage:
+ *  nkcompose [frames]
+ *    For each kernel path compiled in and supported by the CPU (scalar,
+ *    SSE2, AVX2, NEON), composes 1280x720 frames offscreen and prints
+ *    the time per frame. (default 300 frames) Before that, compares the
+ *    output of each SIMD path with the scalar output for edge
+ *    opacities, odd widths and clipped positions, and fails if any
+ *    pixel differs.
+ */
+
+#include "../src/compat.h"
+#include "../src/compose.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Frame size. */
+#define FRAME_WIDTH	1280
+#define FRAME_HEIGHT	720
+
+/* Character layer size. */
+#define CHARA_WIDTH	501
+#define CHARA_HEIGHT	700
+
+/* Test images. */
+static struct compose_image bg1, bg2, chara, frame, expect;
+static struct compose_rule rule;
+static uint8_t *rule_pixels;
+
+/* Random state. */
+static uint32_t seed = 2463534242u;
+
+/* Forward declarations. */
+static bool make_images(void);
+static bool alloc_image(struct compose_image *img, int width, int height);
+static uint32_t next_random(void);
+static uint32_t make_pixel(uint32_t alpha);
+static void compose_frame(int i);
+static bool verify(int path);
+static bool verify_one(int path, const char *name, int arg);
+static void run_op(const char *name, int arg);
+static double benchmark(int path, int frames);
+static double now(void);
+
+int main(int argc, char *argv[])
+{
+	double scalar, t;
+	const char *name;
+	int frames, path;
+
+	frames = argc > 1 ? atoi(argv[1]) : 300;
+	if (argc > 2 || frames <= 0) {
+		fprintf(stderr, "Usage: nkcompose [frames]\n");
+		return 1;
+	}
+
+	if (!make_images())
+		return 1;
+
+	/* Check every SIMD path against the scalar path. */
+	for (path = COMPOSE_SCALAR + 1; path < COMPOSE_PATH_COUNT; path++) {
+		name = compose_get_path_name(path);
+		if (!compose_select(path)) {
+			printf("%s: not available\n", name);
+			continue;
+		}
+		if (!verify(path))
+			return 1;
+		printf("%s: pixel-exact with scalar\n", name);
+	}
+
+	scalar = benchmark(COMPOSE_SCALAR, frames);
+	printf("%-8s %8.3f ms/frame\n", "scalar", scalar * 1000.0 / frames);
+	for (path = COMPOSE_SCALAR + 1; path < COMPOSE_PATH_COUNT; path++) {
+		if (!compose_select(path))
+			continue;
+		t = benchmark(path, frames);
+		printf("%-8s %8.3f ms/frame (x%.2f)\n", compose_get_path_name(path),
+		       t * 1000.0 / frames, scalar / t);
+	}
+
+	compose_select(COMPOSE_AUTO);
+	printf("auto selects %s\n", compose_get_path_name(compose_get_path()));
+
+	return 0;
+}
+
+/* Make the test images. */
+static bool make_images(void)
+{
+	int x, y, cx, cy;
+	uint32_t a;
+
+	if (!alloc_image(&bg1, FRAME_WIDTH, FRAME_HEIGHT) ||
+	    !alloc_image(&bg2, FRAME_WIDTH, FRAME_HEIGHT) ||
+	    !alloc_image(&frame, FRAME_WIDTH, FRAME_HEIGHT) ||
+	    !alloc_image(&expect, FRAME_WIDTH, FRAME_HEIGHT) ||
+	    !alloc_image(&chara, CHARA_WIDTH, CHARA_HEIGHT))
+		return false;
+
+	rule_pixels = malloc((size_t)FRAME_WIDTH * FRAME_HEIGHT);
+	if (rule_pixels == NULL) {
+		fprintf(stderr, "nkcompose: out of memory.\n");
+		return false;
+	}
+	rule.pixels = rule_pixels;
+	rule.width = FRAME_WIDTH;
+	rule.height = FRAME_HEIGHT;
+	rule.pitch = FRAME_WIDTH;
+
+	/* Opaque backgrounds and a noisy diagonal rule. */
+	for (y = 0; y < FRAME_HEIGHT; y++) {
+		for (x = 0; x < FRAME_WIDTH; x++) {
+			bg1.pixels[y * bg1.pitch + x] = make_pixel(255);
+			bg2.pixels[y * bg2.pitch + x] = make_pixel(255);
+			rule_pixels[y * FRAME_WIDTH + x] =
+				(uint8_t)(((x + y) * 255 / (FRAME_WIDTH + FRAME_HEIGHT) + (int)(next_random() % 16)) & 0xff);
+		}
+	}
+
+	/* A character with transparent corners, an opaque body and soft edges. */
+	cx = CHARA_WIDTH / 2;
+	cy = CHARA_HEIGHT / 2;
+	for (y = 0; y < CHARA_HEIGHT; y++) {
+		for (x = 0; x < CHARA_WIDTH; x++) {
+			if (abs(x - cx) * 4 > CHARA_WIDTH * 2 - abs(y - cy))
+				a = 0;
+			else if (abs(x - cx) * 4 > CHARA_WIDTH * 3 / 2)
+				a = next_random() & 0xff;
+			else
+				a = 255;
+			chara.pixels[y * chara.pitch + x] = make_pixel(a);
+		}
+	}
+
+	return true;
+}
+
+/* Allocate an image with a padded pitch. */
+static bool alloc_image(struct compose_image *img, int width, int height)
+{
+	img->pitch = width + 3;
+	img->width = width;
+	img->height = height;
+	img->pixels = calloc((size_t)img->pitch * (size_t)height, sizeof(uint32_t));
+	if (img->pixels == NULL) {
+		fprintf(stderr, "nkcompose: out of memory.\n");
+		return false;
+	}
+	return true;
+}
+
+/* Get a random number. (xorshift32) */
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/* Make a random premultiplied pixel. */
+static uint32_t make_pixel(uint32_t alpha)
+{
+	uint32_t r, g, b;
+
+	r = (next_random() & 0xff) * alpha / 255;
+	g = (next_random() & 0xff) * alpha / 255;
+	b = (next_random() & 0xff) * alpha / 255;
+
+	return (alpha << 24) | (r << 16) | (g << 8) | b;
+}
+
+/* Compose a frame of a typical scene change. */
+static void compose_frame(int i)
+{
+	compose_fade(&frame, &bg1, &bg2, i & 0xff);
+	compose_blend(&frame, &chara, 100 + (i & 0x3f), 20, 255);
+	compose_blend(&frame, &chara, 700, 20, (i * 3) & 0xff);
+	compose_wipe(&frame, &frame, &bg1, &rule, i & 0xff, 64);
+}
+
+/* Compare the output of a path with the scalar output. */
+static bool verify(int path)
+{
+	static const int values[] = {0, 1, 2, 127, 128, 254, 255};
+	size_t i;
+
+	for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		if (!verify_one(path, "fade", values[i]))
+			return false;
+		if (!verify_one(path, "blend", values[i]))
+			return false;
+		if (!verify_one(path, "wipe", values[i]))
+			return false;
+	}
+
+	/* Clipped and odd-sized blends. */
+	for (i = 0; i < 16; i++) {
+		if (!verify_one(path, "clip", (int)i))
+			return false;
+	}
+
+	/* Whole frames. */
+	for (i = 0; i < 8; i++) {
+		if (!verify_one(path, "frame", (int)i * 37))
+			return false;
+	}
+
+	return true;
+}
+
+/* Run an operation with a path and the scalar path, and compare. */
+static bool verify_one(int path, const char *name, int arg)
+{
+	int x, y;
+
+	compose_select(COMPOSE_SCALAR);
+	run_op(name, arg);
+	memcpy(expect.pixels, frame.pixels, (size_t)frame.pitch * (size_t)frame.height * sizeof(uint32_t));
+
+	compose_select(path);
+	run_op(name, arg);
+
+	for (y = 0; y < frame.height; y++) {
+		for (x = 0; x < frame.width; x++) {
+			if (frame.pixels[y * frame.pitch + x] != expect.pixels[y * expect.pitch + x]) {
+				fprintf(stderr, "nkcompose: %s: %s(%d) differs at (%d, %d): %08x, expected %08x\n",
+					compose_get_path_name(path), name, arg, x, y,
+					frame.pixels[y * frame.pitch + x],
+					expect.pixels[y * expect.pitch + x]);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/* Run an operation on the frame from the same start. */
+static void run_op(const char *name, int arg)
+{
+	memcpy(frame.pixels, bg2.pixels, (size_t)frame.pitch * (size_t)frame.height * sizeof(uint32_t));
+
+	if (strcmp(name, "fade") == 0) {
+		compose_fade(&frame, &bg1, &bg2, arg);
+	} else if (strcmp(name, "blend") == 0) {
+		compose_blend(&frame, &chara, 3, 5, arg);
+	} else if (strcmp(name, "wipe") == 0) {
+		compose_wipe(&frame, &bg1, &bg2, &rule, arg, 1 + arg / 2);
+	} else if (strcmp(name, "clip") == 0) {
+		compose_blend(&frame, &chara, -arg * 7 - 1, -arg * 3, 200);
+		compose_blend(&frame, &chara, FRAME_WIDTH - arg * 13 - 5, FRAME_HEIGHT - 600, 255);
+	} else {
+		compose_frame(arg);
+	}
+}
+
+/* Compose frames with a path and return the time. */
+static double benchmark(int path, int frames)
+{
+	double t;
+	int i;
+
+	compose_select(path);
+
+	t = now();
+	for (i = 0; i < frames; i++)
+		compose_frame(i);
+
+	return now() - t;
+}
+
+/* Get the current time in seconds. */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
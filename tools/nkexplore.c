@@ -0,0 +1,1141 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * nkexplore: The route explorer.
+ *
+ * Usage:
+ *  nkexplore [-j threads] [-n states] file.txt [label]
+ *    Plays every option of every select from the start of file.txt
+ *    (or the label) without a window, and reports the coverage of the
+ *    scenario files and the errors found on the routes.
+ *    -j ... Number of threads. (default: the number of CPUs)
+ *    -n ... Maximum number of states. (default 1000000)
+ *
+ * Branch tags:
+ *  [label name="x"]
+ *  [jump label="x"], [jump file="a.txt"], [jump file="a.txt" label="x"]
+ *  [jump call="x"] ... Calls x, then [return] comes back after the jump.
+ *  [select label1="x" file2="a.txt" label2="y" ...]
+ *  [setvar name="x" value="1"]
+ *    "${name}" in these properties is replaced by the flag. Other tags
+ *    are passed, because they need the executive and the window.
+ *
+ * How it works:
+ *  - Each scenario file is parsed once, under a lock, into a parse-only
+ *    scenario instance, and reduced to a read-only table of the branch
+ *    tags. The workers run these tables, not the scenario module, and
+ *    never run the executive.
+ *  - A state is a position, flags and a call stack. A state runs until
+ *    a select, and is forked to one state for each option.
+ *  - A state at a select or at a jump target is dropped if the same
+ *    (file, index, flags, calls) was visited before.
+ *  - States are run by a pool of workers. A worker runs the states it
+ *    forked first, and takes the oldest state of another worker when
+ *    it has none.
+ */
+
+#include "../src/novelkit.h"
+
+#include <stdarg.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+/* Default maximum number of states. */
+#define STATE_MAX_DEFAULT	1000000
+
+/* Maximum number of tags run without a branch. */
+#define RUN_MAX			1000000
+
+/* Maximum call depth. */
+#define CALL_MAX		64
+
+/* Maximum number of options of a select. */
+#define OPTION_MAX		64
+
+/* Maximum number of workers. */
+#define WORKER_MAX		256
+
+/* Number of shards of the visited set. */
+#define SHARD_COUNT		64
+
+/* Size of an expanded property value. */
+#define VALUE_MAX		4096
+
+/* Maximum length of a route shown with an error. */
+#define ROUTE_MAX		1024
+
+/* Maximum number of errors shown. */
+#define ERROR_MAX		100
+
+/* Branch tags. */
+#define LABEL_TAG		"label"
+#define JUMP_TAG		"jump"
+#define RETURN_TAG		"return"
+#define SELECT_TAG		"select"
+#define SETVAR_TAG		"setvar"
+
+/* Kinds of steps. */
+enum step_kind {
+	STEP_PASS,
+	STEP_LABEL,
+	STEP_JUMP,
+	STEP_CALL,
+	STEP_RETURN,
+	STEP_SELECT,
+	STEP_SETVAR,
+};
+
+/* Target of a jump or an option. */
+struct target {
+	char *file;	/* NULL for the same file */
+	char *label;	/* NULL for the top */
+};
+
+/* Step: a command reduced to what changes the route. */
+struct step {
+	int kind;
+	int line;
+	char *name;		/* label and setvar */
+	char *value;		/* setvar */
+	struct target *target;	/* jump, call and select */
+	int target_count;
+};
+
+/* Label index entry. */
+struct label {
+	const char *name;
+	int index;
+};
+
+/* Scenario file. (read-only after loading except visited) */
+struct script {
+	char *file;
+	char *error;
+	struct step *step;
+	int step_count;
+	struct label *label;
+	int label_count;
+	unsigned char *visited;
+	struct script *next;
+};
+
+/* Flag variable. */
+struct flag {
+	char *name;
+	char *value;
+};
+
+/* Return address. */
+struct frame {
+	struct script *script;
+	int index;
+};
+
+/* Exploration state. */
+struct state {
+	struct script *script;
+	int index;
+	struct flag *flag;
+	int flag_count;
+	struct frame *stack;
+	int depth;
+	char *route;
+};
+
+/* Work queue of a worker. The owner uses the tail, and thieves the head. */
+struct deque {
+	pthread_mutex_t mutex;
+	struct state **item;
+	int head;
+	int tail;
+	int cap;
+};
+
+/* Worker. */
+struct worker {
+	pthread_t thread;
+	struct deque queue;
+	uint32_t seed;
+	char *key;
+	size_t key_cap;
+	uint64_t run_count;
+	uint64_t choice_count;
+	uint64_t end_count;
+	uint64_t merge_count;
+	uint64_t steal_count;
+};
+
+/* Visited set shard. (open addressing) */
+struct shard {
+	pthread_mutex_t mutex;
+	struct visit {
+		uint64_t hash;
+		char *key;
+		size_t len;
+	} *tbl;
+	int count;
+	int size;
+};
+
+/* Error found on a route. */
+struct error {
+	char *message;
+	char *route;
+	struct error *next;
+};
+
+/* Scenario files. */
+static struct script *scripts;
+static pthread_mutex_t load_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Workers. */
+static struct worker *workers;
+static int worker_count;
+
+/* Number of states queued or running. */
+static int64_t pending;
+
+/* Number of states made, and the limit. */
+static int64_t state_count;
+static int64_t state_max;
+static bool is_truncated;
+
+/* Visited states. */
+static struct shard shards[SHARD_COUNT];
+
+/* Errors. */
+static struct error *errors;
+static struct error **error_tail = &errors;
+static int error_count;
+static pthread_mutex_t error_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Forward declarations. */
+static struct script *get_script(const char *file);
+static struct script *load_script(const char *file);
+static bool load_steps(struct script *s);
+static void make_step(struct step *st, int index);
+static char *get_prop(int index, const char *name);
+static int compare_label(const void *a, const void *b);
+static int find_label(const struct script *s, const char *name);
+static void *worker_main(void *p);
+static struct state *take_state(struct worker *w);
+static void push_state(struct worker *w, struct state *st);
+static void run_state(struct worker *w, struct state *st);
+static void fork_state(struct worker *w, struct state *st, const struct step *step);
+static bool go_to(struct state *st, const struct target *t, int line);
+static bool is_new_state(struct worker *w, const struct state *st);
+static void append_key(struct worker *w, size_t *len, const char *s);
+static bool expand(struct state *st, const char *s, char *buf, int line);
+static const char *get_flag(const struct state *st, const char *name);
+static void set_flag(struct state *st, const char *name, const char *value);
+static struct state *copy_state(const struct state *st);
+static void free_state(struct state *st);
+static void add_route(struct state *st, int line, int option);
+static void report_error(const struct state *st, int line, const char *format, ...);
+static int compare_script(const void *a, const void *b);
+static void print_report(double sec);
+static void *xmalloc(size_t size);
+static void *xrealloc(void *p, size_t size);
+static char *xstrdup(const char *s);
+static void usage(void);
+
+int main(int argc, char *argv[])
+{
+	struct script *s;
+	struct state *st;
+	uint64_t start;
+	long cpus;
+	int opt, i;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	worker_count = cpus > 0 ? (int)(cpus < WORKER_MAX ? cpus : WORKER_MAX) : 1;
+	state_max = STATE_MAX_DEFAULT;
+	while ((opt = getopt(argc, argv, "j:n:")) != -1) {
+		switch (opt) {
+		case 'j':
+			worker_count = atoi(optarg);
+			if (worker_count < 1 || worker_count > WORKER_MAX) {
+				fprintf(stderr, "nkexplore: threads must be 1 to %d.\n", WORKER_MAX);
+				return 1;
+			}
+			break;
+		case 'n':
+			state_max = atoll(optarg);
+			if (state_max < 1) {
+				fprintf(stderr, "nkexplore: invalid number of states.\n");
+				return 1;
+			}
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (argc - optind < 1 || argc - optind > 2) {
+		usage();
+		return 1;
+	}
+
+	/* Read the scenario files from the package if exists. */
+	if (!package_init())
+		return 1;
+
+	s = get_script(argv[optind]);
+	if (s->error != NULL) {
+		fprintf(stderr, "nkexplore: %s\n", s->error);
+		return 1;
+	}
+
+	/* Make the first state. */
+	st = xmalloc(sizeof(struct state));
+	memset(st, 0, sizeof(struct state));
+	st->script = s;
+	st->route = xstrdup(s->file);
+	if (argc - optind == 2) {
+		st->index = find_label(s, argv[optind + 1]);
+		if (st->index < 0) {
+			fprintf(stderr, "nkexplore: no label %s in %s.\n", argv[optind + 1], s->file);
+			free_state(st);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < SHARD_COUNT; i++)
+		pthread_mutex_init(&shards[i].mutex, NULL);
+
+	workers = xmalloc((size_t)worker_count * sizeof(struct worker));
+	memset(workers, 0, (size_t)worker_count * sizeof(struct worker));
+	for (i = 0; i < worker_count; i++) {
+		pthread_mutex_init(&workers[i].queue.mutex, NULL);
+		workers[i].seed = (uint32_t)i * 2654435761U + 1;
+	}
+
+	start = common_get_usec();
+
+	pending = 1;
+	state_count = 1;
+	push_state(&workers[0], st);
+	for (i = 0; i < worker_count; i++) {
+		if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+			fprintf(stderr, "nkexplore: cannot start a thread.\n");
+			return 1;
+		}
+	}
+	for (i = 0; i < worker_count; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	print_report((double)(common_get_usec() - start) / 1000000.0);
+
+	return error_count > 0 || is_truncated ? 1 : 0;
+}
+
+/*
+ * Scenario Files
+ */
+
+/* Get a scenario file, and load it at the first use. */
+static struct script *get_script(const char *file)
+{
+	struct script *s;
+
+	pthread_mutex_lock(&load_mutex);
+	for (s = scripts; s != NULL; s = s->next) {
+		if (strcmp(s->file, file) == 0)
+			break;
+	}
+	if (s == NULL) {
+		s = load_script(file);
+		s->next = scripts;
+		scripts = s;
+	}
+	pthread_mutex_unlock(&load_mutex);
+
+	return s;
+}
+
+/*
+ * Load a scenario file.
+ *  - The scenario module is used by one thread at a time, under
+ *    load_mutex. A file that fails keeps the error to report it at
+ *    each jump to it.
+ */
+static struct script *load_script(const char *file)
+{
+	struct scenario_context *ctx, *prev;
+	struct script *s;
+
+	s = xmalloc(sizeof(struct script));
+	memset(s, 0, sizeof(struct script));
+	s->file = xstrdup(file);
+
+	ctx = scenario_create_context();
+	if (ctx == NULL) {
+		s->error = xstrdup(api_get_error_message());
+		return s;
+	}
+	prev = scenario_switch_context(ctx);
+
+	/* A file that cannot be read leaves no API error. */
+	api_error("Cannot read %s.", file);
+
+	if (!scenario_move_to_file(NULL, file) || !load_steps(s))
+		s->error = xstrdup(api_get_error_message());
+	scenario_switch_context(prev);
+	scenario_destroy_context(ctx);
+
+	return s;
+}
+
+/* Reduce the command table of the current instance to steps. */
+static bool load_steps(struct script *s)
+{
+	int i, j;
+
+	s->step_count = scenario_get_command_count();
+	s->step = xmalloc((size_t)s->step_count * sizeof(struct step) + 1);
+	s->visited = xmalloc((size_t)s->step_count + 1);
+	memset(s->visited, 0, (size_t)s->step_count + 1);
+
+	for (i = 0; i < s->step_count; i++) {
+		make_step(&s->step[i], i);
+		if (s->step[i].kind == STEP_LABEL)
+			s->label_count++;
+	}
+
+	/* Index the labels. */
+	s->label = xmalloc((size_t)s->label_count * sizeof(struct label) + 1);
+	for (i = 0, j = 0; i < s->step_count; i++) {
+		if (s->step[i].kind != STEP_LABEL)
+			continue;
+		s->label[j].name = s->step[i].name;
+		s->label[j].index = i;
+		j++;
+	}
+	qsort(s->label, (size_t)s->label_count, sizeof(struct label), compare_label);
+
+	for (i = 1; i < s->label_count; i++) {
+		if (strcmp(s->label[i].name, s->label[i - 1].name) == 0) {
+			api_error("%s:%d: Duplicated label %s.", s->file,
+				  s->step[s->label[i].index].line, s->label[i].name);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Make a step of a command. */
+static void make_step(struct step *st, int index)
+{
+	struct target opt[OPTION_MAX];
+	const char *tag;
+	char name[32];
+	char *label, *file;
+	int i;
+
+	memset(st, 0, sizeof(struct step));
+	st->line = scenario_get_line(index);
+
+	tag = scenario_get_tag_name(index);
+	if (strcmp(tag, LABEL_TAG) == 0) {
+		st->name = get_prop(index, "name");
+		if (st->name != NULL)
+			st->kind = STEP_LABEL;
+	} else if (strcmp(tag, JUMP_TAG) == 0) {
+		label = get_prop(index, "call");
+		st->kind = label != NULL ? STEP_CALL : STEP_JUMP;
+		if (label == NULL)
+			label = get_prop(index, "label");
+		st->target = xmalloc(sizeof(struct target));
+		st->target->file = get_prop(index, "file");
+		st->target->label = label;
+		st->target_count = 1;
+	} else if (strcmp(tag, RETURN_TAG) == 0) {
+		st->kind = STEP_RETURN;
+	} else if (strcmp(tag, SELECT_TAG) == 0) {
+		/* Options are numbered from 1 without a gap. */
+		st->kind = STEP_SELECT;
+		for (i = 0; i < OPTION_MAX; i++) {
+			snprintf(name, sizeof(name), "label%d", i + 1);
+			label = get_prop(index, name);
+			snprintf(name, sizeof(name), "file%d", i + 1);
+			file = get_prop(index, name);
+			if (label == NULL && file == NULL)
+				break;
+			opt[i].label = label;
+			opt[i].file = file;
+		}
+		st->target = xmalloc((size_t)i * sizeof(struct target) + 1);
+		memcpy(st->target, opt, (size_t)i * sizeof(struct target));
+		st->target_count = i;
+	} else if (strcmp(tag, SETVAR_TAG) == 0) {
+		st->name = get_prop(index, "name");
+		st->value = get_prop(index, "value");
+		if (st->name != NULL)
+			st->kind = STEP_SETVAR;
+	}
+}
+
+/* Get a copy of a property value, or NULL. */
+static char *get_prop(int index, const char *name)
+{
+	const char *value;
+	int i;
+
+	for (i = 0; i < scenario_get_prop_count(index); i++) {
+		if (strcmp(scenario_get_prop_name(index, i), name) == 0) {
+			value = scenario_get_raw_value(index, i);
+			return value != NULL ? xstrdup(value) : NULL;
+		}
+	}
+
+	return NULL;
+}
+
+/* Compare labels by name. */
+static int compare_label(const void *a, const void *b)
+{
+	const struct label *x = a, *y = b;
+
+	return strcmp(x->name, y->name);
+}
+
+/* Find a label. Returns the index, or -1. */
+static int find_label(const struct script *s, const char *name)
+{
+	struct label key, *l;
+
+	key.name = name;
+	l = bsearch(&key, s->label, (size_t)s->label_count, sizeof(struct label), compare_label);
+
+	return l != NULL ? l->index : -1;
+}
+
+/*
+ * Workers
+ */
+
+/* Worker main. */
+static void *worker_main(void *p)
+{
+	struct worker *w;
+	struct state *st;
+
+	w = p;
+	while (ATOMIC_LOAD(&pending) > 0) {
+		st = take_state(w);
+		if (st == NULL) {
+			sched_yield();
+			continue;
+		}
+
+		w->run_count++;
+		run_state(w, st);
+		free_state(st);
+
+		/* Children were counted before the parent ends. */
+		ATOMIC_SUB(&pending, 1);
+	}
+
+	free(w->key);
+
+	return NULL;
+}
+
+/* Take the newest state of the worker, or steal the oldest one of another. */
+static struct state *take_state(struct worker *w)
+{
+	struct deque *q;
+	struct state *st;
+	int start, i;
+
+	q = &w->queue;
+	pthread_mutex_lock(&q->mutex);
+	st = q->tail > q->head ? q->item[--q->tail] : NULL;
+	pthread_mutex_unlock(&q->mutex);
+	if (st != NULL)
+		return st;
+
+	/* Start at a random victim not to crowd the same one. (xorshift) */
+	w->seed ^= w->seed << 13;
+	w->seed ^= w->seed >> 17;
+	w->seed ^= w->seed << 5;
+	start = (int)(w->seed % (uint32_t)worker_count);
+	for (i = 0; i < worker_count; i++) {
+		q = &workers[(start + i) % worker_count].queue;
+		if (q == &w->queue)
+			continue;
+		pthread_mutex_lock(&q->mutex);
+		st = q->tail > q->head ? q->item[q->head++] : NULL;
+		pthread_mutex_unlock(&q->mutex);
+		if (st != NULL) {
+			w->steal_count++;
+			return st;
+		}
+	}
+
+	return NULL;
+}
+
+/* Push a state to the queue of a worker. */
+static void push_state(struct worker *w, struct state *st)
+{
+	struct deque *q;
+
+	q = &w->queue;
+	pthread_mutex_lock(&q->mutex);
+	if (q->tail == q->cap) {
+		if (q->head > 0) {
+			/* Reuse the space of the stolen states. */
+			memmove(q->item, q->item + q->head, (size_t)(q->tail - q->head) * sizeof(struct state *));
+			q->tail -= q->head;
+			q->head = 0;
+		} else {
+			q->cap = q->cap == 0 ? 256 : q->cap * 2;
+			q->item = xrealloc(q->item, (size_t)q->cap * sizeof(struct state *));
+		}
+	}
+	q->item[q->tail++] = st;
+	pthread_mutex_unlock(&q->mutex);
+}
+
+/* Run a state until it ends or forks. */
+static void run_state(struct worker *w, struct state *st)
+{
+	const struct step *step;
+	struct script *s;
+	char name[VALUE_MAX], value[VALUE_MAX];
+	int line, n;
+
+	line = 0;
+	for (n = 0; n < RUN_MAX; n++) {
+		s = st->script;
+		if (st->index >= s->step_count) {
+			w->end_count++;
+			return;
+		}
+
+		ATOMIC_STORE(&s->visited[st->index], 1);
+		step = &s->step[st->index];
+		line = step->line;
+
+		switch (step->kind) {
+		case STEP_JUMP:
+		case STEP_CALL:
+			if (step->kind == STEP_CALL) {
+				if (st->depth == CALL_MAX) {
+					report_error(st, step->line, "Calls are nested too deeply.");
+					return;
+				}
+				if (st->stack == NULL)
+					st->stack = xmalloc(CALL_MAX * sizeof(struct frame));
+				st->stack[st->depth].script = s;
+				st->stack[st->depth].index = st->index + 1;
+				st->depth++;
+			}
+			if (!go_to(st, &step->target[0], step->line))
+				return;
+			if (!is_new_state(w, st)) {
+				w->merge_count++;
+				return;
+			}
+			break;
+		case STEP_RETURN:
+			if (st->depth == 0) {
+				report_error(st, step->line, "Return without a call.");
+				return;
+			}
+			st->depth--;
+			st->script = st->stack[st->depth].script;
+			st->index = st->stack[st->depth].index;
+			break;
+		case STEP_SELECT:
+			if (step->target_count == 0) {
+				report_error(st, step->line, "Select without options.");
+				return;
+			}
+			if (!is_new_state(w, st)) {
+				w->merge_count++;
+				return;
+			}
+			w->choice_count++;
+			fork_state(w, st, step);
+			return;
+		case STEP_SETVAR:
+			if (!expand(st, step->name, name, step->line))
+				return;
+			if (!expand(st, step->value != NULL ? step->value : "", value, step->line))
+				return;
+			set_flag(st, name, value);
+			st->index++;
+			break;
+		default:
+			st->index++;
+			break;
+		}
+	}
+
+	report_error(st, line, "Too many tags without a select.");
+}
+
+/* Make a state for each option of a select. */
+static void fork_state(struct worker *w, struct state *st, const struct step *step)
+{
+	struct state *child;
+	int i;
+
+	for (i = 0; i < step->target_count; i++) {
+		if (ATOMIC_ADD(&state_count, 1) > state_max) {
+			ATOMIC_STORE(&is_truncated, true);
+			return;
+		}
+
+		child = copy_state(st);
+		add_route(child, step->line, i + 1);
+		if (!go_to(child, &step->target[i], step->line)) {
+			free_state(child);
+			continue;
+		}
+
+		ATOMIC_ADD(&pending, 1);
+		push_state(w, child);
+	}
+}
+
+/* Move a state to a target. */
+static bool go_to(struct state *st, const struct target *t, int line)
+{
+	char file[VALUE_MAX], label[VALUE_MAX];
+	struct script *s;
+	int index;
+
+	s = st->script;
+	if (t->file != NULL) {
+		if (!expand(st, t->file, file, line))
+			return false;
+		s = get_script(file);
+		if (s->error != NULL) {
+			report_error(st, line, "%s", s->error);
+			return false;
+		}
+	}
+
+	index = 0;
+	if (t->label != NULL) {
+		if (!expand(st, t->label, label, line))
+			return false;
+		index = find_label(s, label);
+		if (index < 0) {
+			report_error(st, line, "No label %s in %s.", label, s->file);
+			return false;
+		}
+	}
+
+	st->script = s;
+	st->index = index;
+
+	return true;
+}
+
+/*
+ * Visited States
+ */
+
+/* Check if a state is not visited, and mark it visited. */
+static bool is_new_state(struct worker *w, const struct state *st)
+{
+	struct shard *sh;
+	struct visit *new_tbl, *v;
+	char num[32];
+	uint64_t h;
+	size_t len;
+	int new_size, i, j;
+
+	/* Make the key of the file, the index, the calls and the flags. */
+	len = 0;
+	append_key(w, &len, st->script->file);
+	snprintf(num, sizeof(num), "%d", st->index);
+	append_key(w, &len, num);
+	for (i = 0; i < st->depth; i++) {
+		append_key(w, &len, st->stack[i].script->file);
+		snprintf(num, sizeof(num), "%d", st->stack[i].index);
+		append_key(w, &len, num);
+	}
+	for (i = 0; i < st->flag_count; i++) {
+		append_key(w, &len, st->flag[i].name);
+		append_key(w, &len, st->flag[i].value);
+	}
+	h = common_hash64(w->key, len);
+
+	sh = &shards[h % SHARD_COUNT];
+	pthread_mutex_lock(&sh->mutex);
+
+	/* Grow the table to keep it half empty. */
+	if ((sh->count + 1) * 2 > sh->size) {
+		new_size = sh->size == 0 ? 1024 : sh->size * 2;
+		new_tbl = xmalloc((size_t)new_size * sizeof(struct visit));
+		memset(new_tbl, 0, (size_t)new_size * sizeof(struct visit));
+		for (i = 0; i < sh->size; i++) {
+			if (sh->tbl[i].key == NULL)
+				continue;
+			j = (int)((sh->tbl[i].hash / SHARD_COUNT) & (uint64_t)(new_size - 1));
+			while (new_tbl[j].key != NULL)
+				j = (j + 1) & (new_size - 1);
+			new_tbl[j] = sh->tbl[i];
+		}
+		free(sh->tbl);
+		sh->tbl = new_tbl;
+		sh->size = new_size;
+	}
+
+	for (i = (int)((h / SHARD_COUNT) & (uint64_t)(sh->size - 1));
+	     sh->tbl[i].key != NULL;
+	     i = (i + 1) & (sh->size - 1)) {
+		v = &sh->tbl[i];
+		if (v->hash == h && v->len == len && memcmp(v->key, w->key, len) == 0) {
+			pthread_mutex_unlock(&sh->mutex);
+			return false;
+		}
+	}
+
+	v = &sh->tbl[i];
+	v->hash = h;
+	v->len = len;
+	v->key = xmalloc(len);
+	memcpy(v->key, w->key, len);
+	sh->count++;
+
+	pthread_mutex_unlock(&sh->mutex);
+
+	return true;
+}
+
+/* Append a string with the terminator to the key buffer of a worker. */
+static void append_key(struct worker *w, size_t *len, const char *s)
+{
+	size_t n;
+
+	n = strlen(s) + 1;
+	if (*len + n > w->key_cap) {
+		w->key_cap = (*len + n) * 2;
+		w->key = xrealloc(w->key, w->key_cap);
+	}
+	memcpy(w->key + *len, s, n);
+	*len += n;
+}
+
+/*
+ * State
+ */
+
+/* Replace "${name}" with the flag. "$${" is a literal "${". */
+static bool expand(struct state *st, const char *s, char *buf, int line)
+{
+	const char *end, *value;
+	char name[VALUE_MAX];
+	size_t len, n;
+
+	len = 0;
+	while (*s != '\0') {
+		if (s[0] == '$' && s[1] == '$' && s[2] == '{') {
+			value = "${";
+			n = 2;
+			s += 3;
+		} else if (s[0] == '$' && s[1] == '{' && (end = strchr(s + 2, '}')) != NULL) {
+			n = (size_t)(end - s - 2);
+			if (n >= sizeof(name))
+				n = sizeof(name) - 1;
+			memcpy(name, s + 2, n);
+			name[n] = '\0';
+			value = get_flag(st, name);
+			if (value == NULL) {
+				report_error(st, line, "Undefined flag %s.", name);
+				return false;
+			}
+			n = strlen(value);
+			s = end + 1;
+		} else {
+			value = s;
+			n = 1;
+			s++;
+		}
+		if (len + n >= VALUE_MAX) {
+			report_error(st, line, "Too long value.");
+			return false;
+		}
+		memcpy(buf + len, value, n);
+		len += n;
+	}
+	buf[len] = '\0';
+
+	return true;
+}
+
+/* Get a flag value, or NULL. */
+static const char *get_flag(const struct state *st, const char *name)
+{
+	int lo, hi, mid, cmp;
+
+	lo = 0;
+	hi = st->flag_count - 1;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		cmp = strcmp(name, st->flag[mid].name);
+		if (cmp == 0)
+			return st->flag[mid].value;
+		if (cmp < 0)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+/* Set a flag value. Flags are kept sorted to make the same key. */
+static void set_flag(struct state *st, const char *name, const char *value)
+{
+	int i;
+
+	for (i = 0; i < st->flag_count; i++) {
+		if (strcmp(name, st->flag[i].name) <= 0)
+			break;
+	}
+	if (i < st->flag_count && strcmp(name, st->flag[i].name) == 0) {
+		free(st->flag[i].value);
+		st->flag[i].value = xstrdup(value);
+		return;
+	}
+
+	st->flag = xrealloc(st->flag, (size_t)(st->flag_count + 1) * sizeof(struct flag));
+	memmove(&st->flag[i + 1], &st->flag[i], (size_t)(st->flag_count - i) * sizeof(struct flag));
+	st->flag[i].name = xstrdup(name);
+	st->flag[i].value = xstrdup(value);
+	st->flag_count++;
+}
+
+/* Copy a state. */
+static struct state *copy_state(const struct state *st)
+{
+	struct state *c;
+	int i;
+
+	c = xmalloc(sizeof(struct state));
+	*c = *st;
+	c->route = xstrdup(st->route);
+
+	c->flag = NULL;
+	if (st->flag_count > 0) {
+		c->flag = xmalloc((size_t)st->flag_count * sizeof(struct flag));
+		for (i = 0; i < st->flag_count; i++) {
+			c->flag[i].name = xstrdup(st->flag[i].name);
+			c->flag[i].value = xstrdup(st->flag[i].value);
+		}
+	}
+
+	c->stack = NULL;
+	if (st->depth > 0) {
+		c->stack = xmalloc(CALL_MAX * sizeof(struct frame));
+		memcpy(c->stack, st->stack, (size_t)st->depth * sizeof(struct frame));
+	}
+
+	return c;
+}
+
+/* Free a state. */
+static void free_state(struct state *st)
+{
+	int i;
+
+	for (i = 0; i < st->flag_count; i++) {
+		free(st->flag[i].name);
+		free(st->flag[i].value);
+	}
+	free(st->flag);
+	free(st->stack);
+	free(st->route);
+	free(st);
+}
+
+/* Add a choice to the route of a state. */
+static void add_route(struct state *st, int line, int option)
+{
+	char buf[ROUTE_MAX];
+	size_t len;
+
+	len = strlen(st->route);
+	if (len >= ROUTE_MAX - 4)
+		return;
+	if (len + strlen(st->script->file) + 32 >= ROUTE_MAX) {
+		snprintf(buf, sizeof(buf), "%s > ...", st->route);
+	} else {
+		snprintf(buf, sizeof(buf), "%s > %s:%d#%d", st->route,
+			 st->script->file, line, option);
+	}
+	free(st->route);
+	st->route = xstrdup(buf);
+}
+
+/* Record an error with the route. The same message is recorded once. */
+static void report_error(const struct state *st, int line, const char *format, ...)
+{
+	struct error *e;
+	char msg[VALUE_MAX + 256];
+	va_list ap;
+	int len;
+
+	len = snprintf(msg, sizeof(msg), "%s:%d: ", st->script->file, line);
+	va_start(ap, format);
+	vsnprintf(msg + len, sizeof(msg) - (size_t)len, format, ap);
+	va_end(ap);
+
+	pthread_mutex_lock(&error_mutex);
+	for (e = errors; e != NULL; e = e->next) {
+		if (strcmp(e->message, msg) == 0)
+			break;
+	}
+	if (e == NULL) {
+		e = xmalloc(sizeof(struct error));
+		e->message = xstrdup(msg);
+		e->route = xstrdup(st->route);
+		e->next = NULL;
+		*error_tail = e;
+		error_tail = &e->next;
+		error_count++;
+	}
+	pthread_mutex_unlock(&error_mutex);
+}
+
+/*
+ * Report
+ */
+
+/* Compare scenario files by name. */
+static int compare_script(const void *a, const void *b)
+{
+	const struct script *x = *(struct script * const *)a;
+	const struct script *y = *(struct script * const *)b;
+
+	return strcmp(x->file, y->file);
+}
+
+/* Print the coverage, the errors and the statistics. */
+static void print_report(double sec)
+{
+	struct script **tbl, *s;
+	struct error *e;
+	uint64_t run, choice, end, merge, steal;
+	int count, tags, labels, label_hit, i, j;
+
+	/* Sort the files. */
+	count = 0;
+	for (s = scripts; s != NULL; s = s->next)
+		count++;
+	tbl = xmalloc((size_t)count * sizeof(struct script *) + 1);
+	for (s = scripts, i = 0; s != NULL; s = s->next)
+		tbl[i++] = s;
+	qsort(tbl, (size_t)count, sizeof(struct script *), compare_script);
+
+	/* Coverage of each file. */
+	for (i = 0; i < count; i++) {
+		s = tbl[i];
+		if (s->error != NULL)
+			continue;
+		tags = 0;
+		labels = 0;
+		label_hit = 0;
+		for (j = 0; j < s->step_count; j++) {
+			if (ATOMIC_LOAD(&s->visited[j]))
+				tags++;
+			if (s->step[j].kind == STEP_LABEL) {
+				labels++;
+				if (ATOMIC_LOAD(&s->visited[j]))
+					label_hit++;
+			}
+		}
+		printf("%s: %d/%d tags (%.1f%%), %d/%d labels\n", s->file,
+		       tags, s->step_count,
+		       s->step_count > 0 ? 100.0 * tags / s->step_count : 100.0,
+		       label_hit, labels);
+		for (j = 0; j < s->step_count; j++) {
+			if (s->step[j].kind == STEP_LABEL && !ATOMIC_LOAD(&s->visited[j]))
+				printf("  unreached label %s (line %d)\n", s->step[j].name, s->step[j].line);
+		}
+	}
+	free(tbl);
+
+	/* Errors. */
+	for (e = errors, i = 0; e != NULL && i < ERROR_MAX; e = e->next, i++)
+		printf("error: %s\n  route: %s\n", e->message, e->route);
+	if (error_count > ERROR_MAX)
+		printf("... %d more errors\n", error_count - ERROR_MAX);
+	if (is_truncated)
+		printf("warning: stopped at %lld states (-n)\n", (long long)state_max);
+
+	/* Statistics. */
+	run = choice = end = merge = steal = 0;
+	for (i = 0; i < worker_count; i++) {
+		run += workers[i].run_count;
+		choice += workers[i].choice_count;
+		end += workers[i].end_count;
+		merge += workers[i].merge_count;
+		steal += workers[i].steal_count;
+	}
+	printf("%llu states, %llu selects, %llu ends, %llu merged, %d errors\n",
+	       (unsigned long long)run, (unsigned long long)choice,
+	       (unsigned long long)end, (unsigned long long)merge, error_count);
+	printf("%d threads, %llu steals, %.3f sec\n",
+	       worker_count, (unsigned long long)steal, sec);
+}
+
+/*
+ * Helper
+ */
+
+static void *xmalloc(size_t size)
+{
+	void *p;
+
+	p = malloc(size);
+	if (p == NULL) {
+		fprintf(stderr, "nkexplore: out of memory.\n");
+		exit(1);
+	}
+
+	return p;
+}
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (p == NULL) {
+		fprintf(stderr, "nkexplore: out of memory.\n");
+		exit(1);
+	}
+
+	return p;
+}
+
+static char *xstrdup(const char *s)
+{
+	char *p;
+
+	p = strdup(s);
+	if (p == NULL) {
+		fprintf(stderr, "nkexplore: out of memory.\n");
+		exit(1);
+	}
+
+	return p;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: nkexplore [-j threads] [-n states] file.txt [label]\n");
+}
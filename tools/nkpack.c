@@ -0,0 +1,504 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * nkpack: The package file builder.
+ *
+ * Usage:
+ *  nkpack [-c] [-a align] output.pak dir
+ *    Packs all files under dir. Names are relative to dir.
+ *    -c ... Compress entries that get smaller enough.
+ *           String tables (*.nkl) are always stored uncompressed.
+ *    -a ... Data alignment. (default 16)
+ *
+ *  nkpack -b output.pak dir
+ *    Compares cold and warm read times of loose files and the package.
+ *    Each package entry is extracted to a buffer as the engine does, so
+ *    both passes end with the file contents in memory.
+ */
+
+#include "../src/compat.h"
+#include "../src/package.h"
+#include "../src/lz.h"
+#include "../src/strtab.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Keep a compressed entry only if it saves 1/8 or more. */
+#define COMPRESS_RATIO_NUM	7
+#define COMPRESS_RATIO_DEN	8
+
+/* Input file. */
+struct input {
+	char *name;
+	char *path;
+};
+
+/* Input files. */
+static struct input *inputs;
+static int input_count;
+static int input_cap;
+
+/* Forward declarations. */
+static bool collect_files(const char *root, const char *rel);
+static bool add_input(const char *name, const char *path);
+static int compare_input(const void *a, const void *b);
+static bool write_package(const char *out, bool compress, uint32_t align);
+static bool read_file(const char *path, char **buf, size_t *size);
+static bool is_mapped_type(const char *name);
+static bool write_padding(FILE *fp, uint64_t *pos, uint32_t align);
+static bool benchmark(const char *pak);
+static double now(void);
+static void drop_cache(const char *path);
+static void usage(void);
+
+int main(int argc, char *argv[])
+{
+	bool compress, bench;
+	uint32_t align;
+	int opt;
+
+	compress = false;
+	bench = false;
+	align = PACKAGE_DEFAULT_ALIGN;
+	while ((opt = getopt(argc, argv, "ca:b")) != -1) {
+		switch (opt) {
+		case 'c':
+			compress = true;
+			break;
+		case 'a':
+			align = (uint32_t)atoi(optarg);
+			if (align < 8 || (align & (align - 1)) != 0) {
+				fprintf(stderr, "nkpack: alignment must be a power of two >= 8.\n");
+				return 1;
+			}
+			break;
+		case 'b':
+			bench = true;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (argc - optind != 2) {
+		usage();
+		return 1;
+	}
+
+	if (!collect_files(argv[optind + 1], ""))
+		return 1;
+	qsort(inputs, (size_t)input_count, sizeof(struct input), compare_input);
+
+	if (bench)
+		return benchmark(argv[optind]) ? 0 : 1;
+
+	if (!write_package(argv[optind], compress, align))
+		return 1;
+
+	return 0;
+}
+
+/* Collect files recursively. */
+static bool collect_files(const char *root, const char *rel)
+{
+	char path[4096], name[4096];
+	struct dirent *ent;
+	struct stat st;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), "%s%s%s", root, rel[0] != '\0' ? "/" : "", rel);
+	dir = opendir(path);
+	if (dir == NULL) {
+		fprintf(stderr, "nkpack: cannot open directory %s\n", path);
+		return false;
+	}
+
+	while ((ent = readdir(dir)) != NULL) {
+		if (ent->d_name[0] == '.')
+			continue;
+
+		if (snprintf(name, sizeof(name), "%s%s%s", rel, rel[0] != '\0' ? "/" : "", ent->d_name) >= (int)sizeof(name) ||
+		    snprintf(path, sizeof(path), "%s/%s", root, name) >= (int)sizeof(path)) {
+			fprintf(stderr, "nkpack: path too long: %s\n", ent->d_name);
+			closedir(dir);
+			return false;
+		}
+		if (stat(path, &st) == -1)
+			continue;
+
+		if (S_ISDIR(st.st_mode)) {
+			if (!collect_files(root, name)) {
+				closedir(dir);
+				return false;
+			}
+		} else if (S_ISREG(st.st_mode)) {
+			if (!add_input(name, path)) {
+				closedir(dir);
+				return false;
+			}
+		}
+	}
+
+	closedir(dir);
+
+	return true;
+}
+
+/* Add an input file. */
+static bool add_input(const char *name, const char *path)
+{
+	struct input *p;
+
+	if (input_count == input_cap) {
+		input_cap = input_cap == 0 ? 256 : input_cap * 2;
+		p = realloc(inputs, (size_t)input_cap * sizeof(struct input));
+		if (p == NULL) {
+			fprintf(stderr, "nkpack: out of memory.\n");
+			return false;
+		}
+		inputs = p;
+	}
+
+	inputs[input_count].name = strdup(name);
+	inputs[input_count].path = strdup(path);
+	if (inputs[input_count].name == NULL || inputs[input_count].path == NULL) {
+		fprintf(stderr, "nkpack: out of memory.\n");
+		return false;
+	}
+	input_count++;
+
+	return true;
+}
+
+/* Sort by name in byte order, which the runtime binary-searches. */
+static int compare_input(const void *a, const void *b)
+{
+	return strcmp(((const struct input *)a)->name, ((const struct input *)b)->name);
+}
+
+/* Write a package file. */
+static bool write_package(const char *out, bool compress, uint32_t align)
+{
+	struct package_header h;
+	struct package_entry *dir;
+	uint64_t pos, names_size;
+	uint32_t name_ofs;
+	size_t size, csize;
+	char *buf, *cbuf;
+	FILE *fp;
+	int i;
+
+	dir = calloc((size_t)input_count + 1, sizeof(struct package_entry));
+	if (dir == NULL) {
+		fprintf(stderr, "nkpack: out of memory.\n");
+		return false;
+	}
+
+	fp = fopen(out, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "nkpack: cannot open %s\n", out);
+		free(dir);
+		return false;
+	}
+
+	/* Reserve the header, the directory and the names. */
+	names_size = 0;
+	for (i = 0; i < input_count; i++)
+		names_size += strlen(inputs[i].name) + 1;
+	pos = sizeof(struct package_header) +
+	      (uint64_t)input_count * sizeof(struct package_entry) +
+	      names_size;
+	if (fseek(fp, (long)pos, SEEK_SET) != 0)
+		goto error;
+
+	/* Write the entry data. */
+	for (i = 0; i < input_count; i++) {
+		if (!write_padding(fp, &pos, align))
+			goto error;
+		if (!read_file(inputs[i].path, &buf, &size))
+			goto error;
+
+		dir[i].offset = HOSTTOLE64(pos);
+		dir[i].size = HOSTTOLE64((uint64_t)size);
+		dir[i].stored_size = dir[i].size;
+		dir[i].flags = 0;
+
+		cbuf = NULL;
+		csize = 0;
+		if (compress && size > 0 && !is_mapped_type(inputs[i].name)) {
+			cbuf = malloc(lz_compress_bound(size));
+			if (cbuf != NULL)
+				csize = lz_compress(buf, size, cbuf, lz_compress_bound(size));
+		}
+		if (csize > 0 && csize < size / COMPRESS_RATIO_DEN * COMPRESS_RATIO_NUM) {
+			dir[i].stored_size = HOSTTOLE64((uint64_t)csize);
+			dir[i].flags = HOSTTOLE32(PACKAGE_FLAG_LZ);
+			if (fwrite(cbuf, 1, csize, fp) != csize) {
+				free(cbuf);
+				free(buf);
+				goto error;
+			}
+			pos += csize;
+		} else {
+			if (size > 0 && fwrite(buf, 1, size, fp) != size) {
+				free(cbuf);
+				free(buf);
+				goto error;
+			}
+			pos += size;
+		}
+		free(cbuf);
+		free(buf);
+
+		/* Terminate the data so that the runtime can use it as a string. */
+		if (fputc('\0', fp) == EOF)
+			goto error;
+		pos++;
+
+		printf("%s%s\n", inputs[i].name, dir[i].flags != 0 ? " (compressed)" : "");
+	}
+
+	/* Write the header. */
+	memcpy(h.magic, PACKAGE_MAGIC, 4);
+	h.version = HOSTTOLE32(PACKAGE_VERSION);
+	h.entry_count = HOSTTOLE32((uint32_t)input_count);
+	h.align = HOSTTOLE32(align);
+	h.dir_offset = HOSTTOLE64((uint64_t)sizeof(struct package_header));
+	h.name_offset = HOSTTOLE64((uint64_t)sizeof(struct package_header) +
+				   (uint64_t)input_count * sizeof(struct package_entry));
+	if (fseek(fp, 0, SEEK_SET) != 0)
+		goto error;
+	if (fwrite(&h, sizeof(h), 1, fp) != 1)
+		goto error;
+
+	/* Write the directory. */
+	name_ofs = 0;
+	for (i = 0; i < input_count; i++) {
+		dir[i].name_offset = HOSTTOLE32(name_ofs);
+		name_ofs += (uint32_t)strlen(inputs[i].name) + 1;
+	}
+	if (input_count > 0 &&
+	    fwrite(dir, sizeof(struct package_entry), (size_t)input_count, fp) != (size_t)input_count)
+		goto error;
+
+	/* Write the names. */
+	for (i = 0; i < input_count; i++) {
+		if (fwrite(inputs[i].name, strlen(inputs[i].name) + 1, 1, fp) != 1)
+			goto error;
+	}
+
+	free(dir);
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "nkpack: cannot write %s\n", out);
+		return false;
+	}
+
+	return true;
+
+error:
+	fprintf(stderr, "nkpack: cannot write %s\n", out);
+	free(dir);
+	fclose(fp);
+	remove(out);
+	return false;
+}
+
+/* Read a whole file. */
+static bool read_file(const char *path, char **buf, size_t *size)
+{
+	FILE *fp;
+	long len;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "nkpack: cannot open %s\n", path);
+		return false;
+	}
+
+	if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+		fprintf(stderr, "nkpack: cannot read %s\n", path);
+		fclose(fp);
+		return false;
+	}
+
+	*size = (size_t)len;
+	*buf = malloc(*size + 1);
+	if (*buf == NULL) {
+		fprintf(stderr, "nkpack: out of memory.\n");
+		fclose(fp);
+		return false;
+	}
+
+	if (*size > 0 && fread(*buf, 1, *size, fp) != *size) {
+		fprintf(stderr, "nkpack: cannot read %s\n", path);
+		free(*buf);
+		fclose(fp);
+		return false;
+	}
+
+	fclose(fp);
+
+	return true;
+}
+
+/* Check if a file is used in place and must not be compressed. */
+static bool is_mapped_type(const char *name)
+{
+	size_t len, ext_len;
+
+	/* String tables are looked up in the mapped archive. */
+	len = strlen(name);
+	ext_len = strlen(STRTAB_EXT);
+	return len >= ext_len && strcmp(name + len - ext_len, STRTAB_EXT) == 0;
+}
+
+/* Write zeros up to the alignment. */
+static bool write_padding(FILE *fp, uint64_t *pos, uint32_t align)
+{
+	while (*pos % align != 0) {
+		if (fputc('\0', fp) == EOF)
+			return false;
+		(*pos)++;
+	}
+
+	return true;
+}
+
+/*
+ * Benchmark
+ */
+
+/* Compare read times of loose files and the package. */
+static bool benchmark(const char *pak)
+{
+	const struct package_header *h;
+	const struct package_entry *dir;
+	double t, loose_cold, loose_warm, pak_cold, pak_warm;
+	volatile uint32_t sum;
+	struct stat st;
+	uint64_t ofs;
+	size_t size, stored_size;
+	char *buf, *mem;
+	void *p;
+	int pass, fd, i;
+
+	sum = 0;
+	loose_cold = loose_warm = pak_cold = pak_warm = 0;
+	for (pass = 0; pass < 2; pass++) {
+		/* Loose files: open and read every file. */
+		if (pass == 0) {
+			for (i = 0; i < input_count; i++)
+				drop_cache(inputs[i].path);
+		}
+		t = now();
+		for (i = 0; i < input_count; i++) {
+			if (!read_file(inputs[i].path, &buf, &size))
+				return false;
+			if (size > 0)
+				sum += (uint8_t)buf[size - 1];
+			free(buf);
+		}
+		if (pass == 0)
+			loose_cold = now() - t;
+		else
+			loose_warm = now() - t;
+
+		/* Package: map once and extract every entry. */
+		if (pass == 0)
+			drop_cache(pak);
+		t = now();
+		fd = open(pak, O_RDONLY);
+		if (fd == -1 || fstat(fd, &st) == -1) {
+			fprintf(stderr, "nkpack: cannot open %s\n", pak);
+			return false;
+		}
+		p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) {
+			fprintf(stderr, "nkpack: cannot map %s\n", pak);
+			return false;
+		}
+		mem = p;
+		h = p;
+		dir = (const struct package_entry *)(mem + LETOHOST64(h->dir_offset));
+		for (i = 0; i < (int)LETOHOST32(h->entry_count); i++) {
+			ofs = LETOHOST64(dir[i].offset);
+			size = (size_t)LETOHOST64(dir[i].size);
+			stored_size = (size_t)LETOHOST64(dir[i].stored_size);
+			buf = malloc(size + 1);
+			if (buf == NULL) {
+				fprintf(stderr, "nkpack: out of memory.\n");
+				munmap(p, (size_t)st.st_size);
+				return false;
+			}
+			if (LETOHOST32(dir[i].flags) & PACKAGE_FLAG_LZ) {
+				if (!lz_decompress(mem + ofs, stored_size, buf, size)) {
+					fprintf(stderr, "nkpack: broken entry %d in %s\n", i, pak);
+					free(buf);
+					munmap(p, (size_t)st.st_size);
+					return false;
+				}
+			} else {
+				memcpy(buf, mem + ofs, size);
+			}
+			if (size > 0)
+				sum += (uint8_t)buf[size - 1];
+			free(buf);
+		}
+		munmap(p, (size_t)st.st_size);
+		if (pass == 0)
+			pak_cold = now() - t;
+		else
+			pak_warm = now() - t;
+	}
+
+	printf("files: %d\n", input_count);
+	printf("loose cold: %10.3f ms\n", loose_cold * 1000.0);
+	printf("loose warm: %10.3f ms\n", loose_warm * 1000.0);
+	printf("pack cold:  %10.3f ms\n", pak_cold * 1000.0);
+	printf("pack warm:  %10.3f ms\n", pak_warm * 1000.0);
+
+	return true;
+}
+
+/* Get a monotonic time in seconds. */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Evict a file from the page cache to measure a cold read. */
+static void drop_cache(const char *path)
+{
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+/* Show the usage. */
+static void usage(void)
+{
+	fprintf(stderr, "Usage: nkpack [-c] [-a align] output.pak dir\n");
+	fprintf(stderr, "       nkpack -b output.pak dir\n");
+}
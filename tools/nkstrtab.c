@@ -0,0 +1,281 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * NovelKit
+ * Copyright (c) 2025, Tamako Mori. All rights reserved.
+ */
+
+/*
+ * nkstrtab: The string table builder.
+ *
+ * Usage:
+ *  nkstrtab input.tsv output.nkl
+ *    Each line of the input is "<ID><TAB><string>".
+ *    Empty lines and lines starting with '#' are skipped.
+ *    Escapes "\n", "\t" and "\\" are available in strings.
+ */
+
+#include "../src/compat.h"
+#include "../src/strtab.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Maximum line length. */
+#define LINE_MAX_LEN	65536
+
+/* Input string. */
+struct item {
+	uint64_t hash;
+	char *id;
+	char *str;
+	int line;
+};
+
+/* Input strings. */
+static struct item *items;
+static int item_count;
+static int item_cap;
+
+/* Forward declarations. */
+static bool read_tsv(const char *file);
+static bool add_item(const char *id, const char *str, int line);
+static void unescape(char *s);
+static int compare_item(const void *a, const void *b);
+static bool check_duplicates(const char *file);
+static bool write_table(const char *out);
+
+int main(int argc, char *argv[])
+{
+	if (argc != 3) {
+		fprintf(stderr, "Usage: nkstrtab input.tsv output.nkl\n");
+		return 1;
+	}
+
+	if (!read_tsv(argv[1]))
+		return 1;
+
+	qsort(items, (size_t)item_count, sizeof(struct item), compare_item);
+
+	if (!check_duplicates(argv[1]))
+		return 1;
+
+	if (!write_table(argv[2]))
+		return 1;
+
+	printf("%d strings\n", item_count);
+
+	return 0;
+}
+
+/* Read a TSV file. */
+static bool read_tsv(const char *file)
+{
+	FILE *fp;
+	char *buf, *tab;
+	size_t len;
+	int line;
+
+	fp = fopen(file, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "nkstrtab: cannot open %s\n", file);
+		return false;
+	}
+
+	buf = malloc(LINE_MAX_LEN);
+	if (buf == NULL) {
+		fprintf(stderr, "nkstrtab: out of memory.\n");
+		fclose(fp);
+		return false;
+	}
+
+	line = 0;
+	while (fgets(buf, LINE_MAX_LEN, fp) != NULL) {
+		line++;
+
+		/* Remove the line end. */
+		len = strlen(buf);
+		if (len == LINE_MAX_LEN - 1 && buf[len - 1] != '\n') {
+			fprintf(stderr, "nkstrtab: %s:%d: line too long\n", file, line);
+			goto error;
+		}
+		while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+			buf[--len] = '\0';
+
+		/* Skip empty lines and comments. */
+		if (len == 0 || buf[0] == '#')
+			continue;
+
+		tab = strchr(buf, '\t');
+		if (tab == NULL || tab == buf) {
+			fprintf(stderr, "nkstrtab: %s:%d: expected <ID><TAB><string>\n", file, line);
+			goto error;
+		}
+		*tab = '\0';
+		unescape(tab + 1);
+
+		if (!add_item(buf, tab + 1, line))
+			goto error;
+	}
+
+	free(buf);
+	fclose(fp);
+	return true;
+
+error:
+	free(buf);
+	fclose(fp);
+	return false;
+}
+
+/* Add a string. */
+static bool add_item(const char *id, const char *str, int line)
+{
+	struct item *new_items;
+	int new_cap;
+
+	if (item_count == item_cap) {
+		new_cap = item_cap == 0 ? 256 : item_cap * 2;
+		new_items = realloc(items, (size_t)new_cap * sizeof(struct item));
+		if (new_items == NULL) {
+			fprintf(stderr, "nkstrtab: out of memory.\n");
+			return false;
+		}
+		items = new_items;
+		item_cap = new_cap;
+	}
+
+	items[item_count].hash = strtab_hash(STRTAB_HASH_INIT, id);
+	items[item_count].id = strdup(id);
+	items[item_count].str = strdup(str);
+	items[item_count].line = line;
+	if (items[item_count].id == NULL || items[item_count].str == NULL) {
+		fprintf(stderr, "nkstrtab: out of memory.\n");
+		return false;
+	}
+	item_count++;
+
+	return true;
+}
+
+/* Unescape a string in place. */
+static void unescape(char *s)
+{
+	char *d;
+
+	for (d = s; *s != '\0'; s++) {
+		if (*s == '\\' && s[1] != '\0') {
+			s++;
+			switch (*s) {
+			case 'n':
+				*d++ = '\n';
+				break;
+			case 't':
+				*d++ = '\t';
+				break;
+			default:
+				*d++ = *s;
+				break;
+			}
+		} else {
+			*d++ = *s;
+		}
+	}
+	*d = '\0';
+}
+
+/* Compare strings by hash. */
+static int compare_item(const void *a, const void *b)
+{
+	const struct item *x = a, *y = b;
+
+	if (x->hash < y->hash)
+		return -1;
+	if (x->hash > y->hash)
+		return 1;
+	return x->line - y->line;
+}
+
+/* Reject duplicated IDs and hash collisions. */
+static bool check_duplicates(const char *file)
+{
+	int i;
+
+	for (i = 1; i < item_count; i++) {
+		if (items[i].hash != items[i - 1].hash)
+			continue;
+		if (strcmp(items[i].id, items[i - 1].id) == 0) {
+			fprintf(stderr, "nkstrtab: %s:%d: duplicated ID %s (line %d)\n",
+				file, items[i].line, items[i].id, items[i - 1].line);
+		} else {
+			fprintf(stderr, "nkstrtab: %s:%d: hash collision of %s and %s, rename one\n",
+				file, items[i].line, items[i].id, items[i - 1].id);
+		}
+		return false;
+	}
+
+	return true;
+}
+
+/* Write a table file. */
+static bool write_table(const char *out)
+{
+	struct strtab_header h;
+	struct strtab_entry e;
+	FILE *fp;
+	uint64_t ofs;
+	size_t len;
+	int i;
+
+	fp = fopen(out, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "nkstrtab: cannot open %s\n", out);
+		return false;
+	}
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, STRTAB_MAGIC, 4);
+	h.version = HOSTTOLE32(STRTAB_VERSION);
+	h.count = HOSTTOLE32((uint32_t)item_count);
+	if (fwrite(&h, sizeof(h), 1, fp) != 1)
+		goto error;
+
+	/* Write the entries. */
+	ofs = 0;
+	for (i = 0; i < item_count; i++) {
+		len = strlen(items[i].str);
+		if (ofs + len + 1 > UINT32_MAX) {
+			fprintf(stderr, "nkstrtab: too large table.\n");
+			fclose(fp);
+			remove(out);
+			return false;
+		}
+		e.hash = HOSTTOLE64(items[i].hash);
+		e.offset = HOSTTOLE32((uint32_t)ofs);
+		e.length = HOSTTOLE32((uint32_t)len);
+		if (fwrite(&e, sizeof(e), 1, fp) != 1)
+			goto error;
+		ofs += len + 1;
+	}
+
+	/* Write the strings. */
+	for (i = 0; i < item_count; i++) {
+		if (fwrite(items[i].str, strlen(items[i].str) + 1, 1, fp) != 1)
+			goto error;
+	}
+
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "nkstrtab: cannot write %s\n", out);
+		remove(out);
+		return false;
+	}
+
+	return true;
+
+error:
+	fprintf(stderr, "nkstrtab: cannot write %s\n", out);
+	fclose(fp);
+	remove(out);
+	return false;
+}